@@ -0,0 +1,336 @@
+#ifndef BIGCOUNT_MAP_HH
+#define BIGCOUNT_MAP_HH
+
+#include <assert.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "khmer.hh"
+#include "ktable.hh"
+
+// the initial number of slots; always a power of two.
+#define BIGCOUNT_MAP_MIN_SLOTS 1024
+
+// the key of an empty slot.
+#define BIGCOUNT_MAP_EMPTY_KEY (~(khmer::HashIntoType) 0)
+
+// the size of a saved (k-mer, count) record.
+#define BIGCOUNT_RECORD_SIZE \
+  (sizeof(khmer::HashIntoType) + sizeof(khmer::BoundedCounterType))
+
+namespace khmer {
+
+  //
+  // BigCountMap: the counts of k-mers whose counters have saturated,
+  // in an open-addressing hash table with linear probing.
+  //
+  // Keys are claimed, and counts bumped, with compare-and-swap, so
+  // threads count concurrently instead of taking turns. A slot whose
+  // key has been claimed but whose count is still 0 reads as absent.
+  // The table doubles when half full; a resize waits for the threads
+  // inside the table to leave, and holds off new ones until it is done.
+  // The empty-slot key, ~0, is counted on its own, outside the table.
+  //
+  // Records are saved as (HashIntoType k-mer, BoundedCounterType count)
+  // pairs in k-mer order, written and read in one piece.
+  //
+
+  class BigCountMap {
+  protected:
+    HashIntoType *		_keys;
+    BoundedCounterType *	_counts;
+    HashIntoType		_n_slots;
+    HashIntoType		_n_keys;
+    BoundedCounterType		_empty_key_count;
+
+    // threads inside the table, and whether it is being resized.
+    mutable unsigned int	_n_users;
+    unsigned int		_resizing;
+
+    void _allocate(HashIntoType n_slots) {
+      _n_slots = n_slots;
+      _keys = new HashIntoType[_n_slots];
+      _counts = new BoundedCounterType[_n_slots];
+      memset(_keys, 0xff, _n_slots * sizeof(HashIntoType));
+      memset(_counts, 0, _n_slots * sizeof(BoundedCounterType));
+    }
+
+    void _free() {
+      delete[] _keys;
+      delete[] _counts;
+      _keys = NULL;
+      _counts = NULL;
+    }
+
+    HashIntoType _first_slot(HashIntoType key) const {
+      return _seeded_hash(key, 0) & (_n_slots - 1);
+    }
+
+    // the slot holding the given key, or -1.
+    long long _find(HashIntoType key) const {
+      HashIntoType slot = _first_slot(key);
+      while (_keys[slot] != BIGCOUNT_MAP_EMPTY_KEY) {
+	if (_keys[slot] == key) {
+	  return slot;
+	}
+	slot = (slot + 1) & (_n_slots - 1);
+      }
+      return -1;
+    }
+
+    // the slot holding the given key, claiming an empty one if need be.
+    HashIntoType _find_or_claim(HashIntoType key) {
+      HashIntoType slot = _first_slot(key);
+      for (;;) {
+	HashIntoType seen = _keys[slot];
+	if (seen == BIGCOUNT_MAP_EMPTY_KEY) {
+#ifdef KHMER_THREADED
+	  seen = __sync_val_compare_and_swap(_keys + slot,
+					     BIGCOUNT_MAP_EMPTY_KEY, key);
+	  if (seen == BIGCOUNT_MAP_EMPTY_KEY) {
+	    __sync_add_and_fetch(&_n_keys, 1);
+	    return slot;
+	  }
+#else
+	  _keys[slot] = key;
+	  _n_keys++;
+	  return slot;
+#endif
+	}
+	if (seen == key) {
+	  return slot;
+	}
+	slot = (slot + 1) & (_n_slots - 1);
+      }
+    }
+
+    void _rehash(HashIntoType n_slots) {
+      HashIntoType * old_keys = _keys;
+      BoundedCounterType * old_counts = _counts;
+      HashIntoType old_n_slots = _n_slots;
+
+      _allocate(n_slots);
+      _n_keys = 0;
+      for (HashIntoType i = 0; i < old_n_slots; i++) {
+	if (old_keys[i] != BIGCOUNT_MAP_EMPTY_KEY && old_counts[i]) {
+	  HashIntoType slot = _find_or_claim(old_keys[i]);
+	  _counts[slot] = old_counts[i];
+	}
+      }
+
+      delete[] old_keys;
+      delete[] old_counts;
+    }
+
+#ifdef KHMER_THREADED
+    void _enter() const {
+      for (;;) {
+	__sync_add_and_fetch(&_n_users, 1);
+	if (!*(volatile unsigned int *) &_resizing) {
+	  return;
+	}
+	__sync_sub_and_fetch(&_n_users, 1);
+	while (*(volatile unsigned int *) &_resizing) ;
+      }
+    }
+
+    void _leave() const {
+      __sync_sub_and_fetch(&_n_users, 1);
+    }
+
+    // called from inside the table; returns from inside the table.
+    void _grow() {
+      if (__sync_bool_compare_and_swap(&_resizing, 0, 1)) {
+	_leave();
+	while (*(volatile unsigned int *) &_n_users) ;
+
+	if (_n_keys * 2 >= _n_slots) {
+	  _rehash(_n_slots * 2);
+	}
+	__sync_synchronize();
+	_resizing = 0;
+      } else {
+	_leave();
+      }
+      _enter();
+    }
+#else
+    void _enter() const { }
+    void _leave() const { }
+
+    void _grow() {
+      _rehash(_n_slots * 2);
+    }
+#endif
+
+    // bump a count: to first, if it was 0, otherwise by one, up to max.
+    static BoundedCounterType _bump(BoundedCounterType * count,
+				    BoundedCounterType first,
+				    BoundedCounterType max) {
+#ifdef KHMER_THREADED
+      BoundedCounterType old = *count;
+      for (;;) {
+	BoundedCounterType updated = old == 0 ? first :
+	  (old < max ? old + 1 : old);
+	if (updated == old) {
+	  return old;
+	}
+	BoundedCounterType seen =
+	  __sync_val_compare_and_swap(count, old, updated);
+	if (seen == old) {
+	  return updated;
+	}
+	old = seen;
+      }
+#else
+      if (*count == 0) {
+	*count = first;
+      } else if (*count < max) {
+	*count += 1;
+      }
+      return *count;
+#endif
+    }
+
+  private:
+    BigCountMap(const BigCountMap &);
+    BigCountMap& operator=(const BigCountMap &);
+
+  public:
+    BigCountMap() : _n_keys(0), _empty_key_count(0),
+		    _n_users(0), _resizing(0) {
+      _allocate(BIGCOUNT_MAP_MIN_SLOTS);
+    }
+
+    ~BigCountMap() {
+      _free();
+    }
+
+    // the number of k-mers with a count.
+    HashIntoType size() const {
+      HashIntoType n = _empty_key_count ? 1 : 0;
+      for (HashIntoType i = 0; i < _n_slots; i++) {
+	if (_keys[i] != BIGCOUNT_MAP_EMPTY_KEY && _counts[i]) {
+	  n++;
+	}
+      }
+      return n;
+    }
+
+    // not thread-safe.
+    void clear() {
+      _free();
+      _allocate(BIGCOUNT_MAP_MIN_SLOTS);
+      _n_keys = 0;
+      _empty_key_count = 0;
+    }
+
+    // make room for n k-mers without resizing; not thread-safe.
+    void reserve(HashIntoType n) {
+      HashIntoType n_slots = _n_slots;
+      while (n_slots < 2 * (_n_keys + n)) {
+	n_slots *= 2;
+      }
+      if (n_slots != _n_slots) {
+	_rehash(n_slots);
+      }
+    }
+
+    // the count for the given k-mer, or 0 if it has none.
+    BoundedCounterType get(HashIntoType key) const {
+      if (key == BIGCOUNT_MAP_EMPTY_KEY) {
+	return _empty_key_count;
+      }
+
+      _enter();
+      long long slot = _find(key);
+      BoundedCounterType count = slot < 0 ? 0 : _counts[slot];
+      _leave();
+
+      return count;
+    }
+
+    // set the count of a k-mer with none to first; otherwise increment
+    // it, saturating at max. Returns the new count.
+    BoundedCounterType increment(HashIntoType key,
+				 BoundedCounterType first,
+				 BoundedCounterType max) {
+      if (key == BIGCOUNT_MAP_EMPTY_KEY) {
+	return _bump(&_empty_key_count, first, max);
+      }
+
+      _enter();
+      long long found = _find(key);
+      if (found < 0 && _n_keys * 2 >= _n_slots) {
+	_grow();
+      }
+      BoundedCounterType count = _bump(_counts + _find_or_claim(key),
+				       first, max);
+      _leave();
+
+      return count;
+    }
+
+    // set the count for the given k-mer; not thread-safe.
+    void set(HashIntoType key, BoundedCounterType count) {
+      if (key == BIGCOUNT_MAP_EMPTY_KEY) {
+	_empty_key_count = count;
+	return;
+      }
+      if (_find(key) < 0 && _n_keys * 2 >= _n_slots) {
+	_rehash(_n_slots * 2);
+      }
+      _counts[_find_or_claim(key)] = count;
+    }
+
+    // all of the (k-mer, count) pairs, in k-mer order.
+    void get_entries(std::vector<std::pair<HashIntoType,
+					   BoundedCounterType> > &entries)
+      const {
+      entries.clear();
+      for (HashIntoType i = 0; i < _n_slots; i++) {
+	if (_keys[i] != BIGCOUNT_MAP_EMPTY_KEY && _counts[i]) {
+	  entries.push_back(std::make_pair(_keys[i], _counts[i]));
+	}
+      }
+      if (_empty_key_count) {
+	entries.push_back(std::make_pair(BIGCOUNT_MAP_EMPTY_KEY,
+					 _empty_key_count));
+      }
+      std::sort(entries.begin(), entries.end());
+    }
+
+    // append the saved records to buf, in k-mer order; returns how many.
+    HashIntoType get_records(std::vector<char> &buf) const {
+      std::vector<std::pair<HashIntoType, BoundedCounterType> > entries;
+      get_entries(entries);
+
+      size_t pos = buf.size();
+      buf.resize(pos + entries.size() * BIGCOUNT_RECORD_SIZE);
+      for (size_t i = 0; i < entries.size(); i++) {
+	memcpy(&buf[pos], &entries[i].first, sizeof(HashIntoType));
+	memcpy(&buf[pos + sizeof(HashIntoType)], &entries[i].second,
+	       sizeof(BoundedCounterType));
+	pos += BIGCOUNT_RECORD_SIZE;
+      }
+      return entries.size();
+    }
+
+    // add n saved records; not thread-safe.
+    void set_records(const char * buf, HashIntoType n) {
+      reserve(n);
+      for (HashIntoType i = 0; i < n; i++, buf += BIGCOUNT_RECORD_SIZE) {
+	HashIntoType key;
+	BoundedCounterType count;
+
+	memcpy(&key, buf, sizeof(key));
+	memcpy(&count, buf + sizeof(key), sizeof(count));
+	set(key, count);
+      }
+    }
+  };
+};
+
+#endif // BIGCOUNT_MAP_HH
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,330 @@
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include "block_gzip.hh"
+#include "khmer_config.hh"
+#include "khmer_exception.hh"
+#include "zlib/zlib.h"
+
+using namespace std;
+using namespace khmer;
+
+// the header of a block, up to and including its "BC" extra field; the
+// last two bytes take the block size, less one.
+static const unsigned char _block_header[] = {
+  0x1f, 0x8b, 8, 4,		// gzip, deflate, FEXTRA
+  0, 0, 0, 0, 0, 0xff,		// no mtime, no flags, unknown OS
+  6, 0,				// XLEN
+  'B', 'C', 2, 0, 0, 0		// the block size subfield
+};
+
+#define BLOCK_HEADER_SIZE sizeof(_block_header)
+#define BLOCK_FOOTER_SIZE 8	// CRC32, ISIZE
+
+static void _put_le(unsigned char * p, unsigned long value, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; i++, value >>= 8) {
+    p[i] = value & 0xff;
+  }
+}
+
+static unsigned long _get_le(const unsigned char * p, unsigned int n)
+{
+  unsigned long value = 0;
+  for (unsigned int i = n; i > 0; i--) {
+    value = (value << 8) | p[i - 1];
+  }
+  return value;
+}
+
+// deflate n bytes (at most BLOCK_GZIP_MAX_INPUT) into a block.
+static void _compress_block(const char * in, size_t n, std::vector<char> &out)
+{
+  out.resize(BLOCK_GZIP_MAX_BLOCK);
+  unsigned char * block = (unsigned char *) &out[0];
+  memcpy(block, _block_header, BLOCK_HEADER_SIZE);
+
+  size_t compressed = 0;
+  bool deflated = false;
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+		   Z_DEFAULT_STRATEGY) == Z_OK) {
+    zs.next_in = (Bytef *) in;
+    zs.avail_in = n;
+    zs.next_out = block + BLOCK_HEADER_SIZE;
+    zs.avail_out = BLOCK_GZIP_MAX_BLOCK - BLOCK_HEADER_SIZE -
+      BLOCK_FOOTER_SIZE;
+
+    deflated = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+    compressed = zs.total_out;
+    deflateEnd(&zs);
+  }
+
+  // if zlib could not be set up, or the data will not fit compressed,
+  // store it, in a single stored deflate block; that always fits.
+  if (!deflated) {
+    unsigned char * stored = block + BLOCK_HEADER_SIZE;
+    stored[0] = 1;				// final, stored
+    _put_le(stored + 1, n, 2);
+    _put_le(stored + 3, ~n & 0xffff, 2);
+    if (n) {
+      memcpy(stored + 5, in, n);
+    }
+    compressed = n + 5;
+  }
+
+  size_t size = BLOCK_HEADER_SIZE + compressed + BLOCK_FOOTER_SIZE;
+  unsigned char * footer = block + BLOCK_HEADER_SIZE + compressed;
+
+  _put_le(block + BLOCK_HEADER_SIZE - 2, size - 1, 2);
+  _put_le(footer, crc32(crc32(0L, Z_NULL, 0), (const Bytef *) in, n), 4);
+  _put_le(footer + 4, n, 4);
+  out.resize(size);
+}
+
+// inflate the data of a block, whose gzip header is header_size bytes;
+// returns false if it does not inflate to n bytes with the right CRC.
+static bool _decompress_block(const std::vector<char> &in,
+			      size_t header_size, char * out, size_t n)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, -15) != Z_OK) {
+    return false;
+  }
+
+  zs.next_in = (Bytef *) &in[header_size];
+  zs.avail_in = in.size() - header_size - BLOCK_FOOTER_SIZE;
+  zs.next_out = (Bytef *) out;
+  zs.avail_out = n;
+
+  int err = inflate(&zs, Z_FINISH);
+  bool inflated = err == Z_STREAM_END && zs.total_out == n;
+  inflateEnd(&zs);
+
+  const unsigned char * footer =
+    (const unsigned char *) &in[in.size() - BLOCK_FOOTER_SIZE];
+  return inflated &&
+    _get_le(footer, 4) == crc32(crc32(0L, Z_NULL, 0), (const Bytef *) out, n);
+}
+
+// read the gzip header of a block, through its extra fields, into header;
+// returns the size of the whole block, or 0 at the end of the file.
+static size_t _read_block_header(std::istream &infile,
+				 std::vector<char> &header)
+{
+  header.resize(12);
+  infile.read(&header[0], 12);
+  if (infile.gcount() == 0) {
+    return 0;
+  }
+
+  const unsigned char * h = (const unsigned char *) &header[0];
+  if (infile.gcount() != 12 || h[0] != 0x1f || h[1] != 0x8b ||
+      !(h[3] & 4)) {
+    return 0;
+  }
+
+  size_t xlen = _get_le(h + 10, 2);
+  header.resize(12 + xlen);
+  infile.read(&header[12], xlen);
+  if ((size_t) infile.gcount() != xlen) {
+    return 0;
+  }
+
+  // find the "BC" subfield, among any others.
+  h = (const unsigned char *) &header[0];
+  for (size_t i = 12; i + 4 <= 12 + xlen; ) {
+    size_t slen = _get_le(h + i + 2, 2);
+    if (h[i] == 'B' && h[i + 1] == 'C' && slen == 2) {
+      return _get_le(h + i + 4, 2) + 1;
+    }
+    i += 4 + slen;
+  }
+  return 0;
+}
+
+//
+// BlockGzipWriter
+//
+
+BlockGzipWriter::BlockGzipWriter(const std::string &outfilename)
+{
+  _outfile.open(outfilename.c_str(), ios::binary);
+  assert(_outfile.is_open());
+  _pending.reserve(BLOCK_GZIP_BATCH_BLOCKS * BLOCK_GZIP_MAX_INPUT);
+}
+
+void BlockGzipWriter::write(const void * data, unsigned long long n)
+{
+  const char * p = (const char *) data;
+  size_t batch_bytes = BLOCK_GZIP_BATCH_BLOCKS * BLOCK_GZIP_MAX_INPUT;
+
+  while (n) {
+    size_t chunk = std::min((unsigned long long) (batch_bytes -
+						  _pending.size()), n);
+    _pending.insert(_pending.end(), p, p + chunk);
+    p += chunk;
+    n -= chunk;
+
+    if (_pending.size() == batch_bytes) {
+      _flush(_pending.size());
+    }
+  }
+}
+
+// compress and write out the first n_bytes of the pending data, a block
+// to a thread at a time.
+void BlockGzipWriter::_flush(size_t n_bytes)
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+  long long n_blocks =
+    (n_bytes + BLOCK_GZIP_MAX_INPUT - 1) / BLOCK_GZIP_MAX_INPUT;
+  std::vector< std::vector<char> > blocks(n_blocks);
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic )
+  for (long long i = 0; i < n_blocks; i++) {
+    size_t start = i * BLOCK_GZIP_MAX_INPUT;
+    size_t n = std::min((size_t) BLOCK_GZIP_MAX_INPUT, n_bytes - start);
+    _compress_block(&_pending[start], n, blocks[i]);
+  }
+
+  for (long long i = 0; i < n_blocks; i++) {
+    _outfile.write(&blocks[i][0], blocks[i].size());
+  }
+  _pending.erase(_pending.begin(), _pending.begin() + n_bytes);
+}
+
+void BlockGzipWriter::close()
+{
+  if (_outfile.is_open()) {
+    _flush(_pending.size());
+
+    // the end-of-file marker: an empty block.
+    std::vector<char> eof;
+    _compress_block(NULL, 0, eof);
+    _outfile.write(&eof[0], eof.size());
+
+    _outfile.close();
+  }
+}
+
+//
+// BlockGzipReader
+//
+
+BlockGzipReader::BlockGzipReader(const std::string &infilename) :
+  _pos(0), _at_end(false)
+{
+  _infile.open(infilename.c_str(), ios::binary);
+  if (!_infile.is_open()) {
+    throw InvalidTableFile();
+  }
+}
+
+// decompress the next batch of blocks, a block to a thread at a time;
+// returns false at the end of the file, and throws InvalidTableFile if
+// a block is cut short or corrupt.
+bool BlockGzipReader::_fill()
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+  std::vector< std::vector<char> > blocks;
+  std::vector<size_t> header_sizes;
+  std::vector<size_t> offsets;
+
+  _data.clear();
+  _pos = 0;
+
+  while (_data.empty() && !_at_end) {
+    blocks.clear();
+    header_sizes.clear();
+    offsets.assign(1, 0);
+
+    std::vector<char> header;
+    while (blocks.size() < BLOCK_GZIP_BATCH_BLOCKS) {
+      size_t size = _read_block_header(_infile, header);
+      if (!size) {
+	_at_end = true;
+	break;
+      }
+      if (size < header.size() + BLOCK_FOOTER_SIZE) {
+	throw InvalidTableFile();
+      }
+
+      blocks.push_back(header);
+      std::vector<char> &block = blocks.back();
+      block.resize(size);
+      _infile.read(&block[header.size()], size - header.size());
+      if ((size_t) _infile.gcount() != size - header.size()) {
+	throw InvalidTableFile();
+      }
+
+      // no block holds more than the writer puts in one; a bigger size
+      // is corrupt, and must not be allocated for.
+      size_t isize = _get_le((const unsigned char *) &block[size - 4], 4);
+      if (isize > BLOCK_GZIP_MAX_INPUT) {
+	throw InvalidTableFile();
+      }
+
+      header_sizes.push_back(header.size());
+      offsets.push_back(offsets.back() + isize);
+    }
+
+    _data.resize(offsets.back());
+
+    long long n_blocks = blocks.size();
+    bool ok = true;
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic ) reduction( &&: ok )
+    for (long long i = 0; i < n_blocks; i++) {
+      if (offsets[i + 1] > offsets[i]) {
+	ok = _decompress_block(blocks[i], header_sizes[i], &_data[offsets[i]],
+			       offsets[i + 1] - offsets[i]) && ok;
+      }
+    }
+    if (!ok) {
+      throw InvalidTableFile();
+    }
+  }
+
+  return !_data.empty();
+}
+
+unsigned long long BlockGzipReader::read(void * data, unsigned long long n)
+{
+  char * p = (char *) data;
+  unsigned long long done = 0;
+
+  while (done < n) {
+    if (_pos == _data.size() && !_fill()) {
+      break;
+    }
+    size_t chunk = std::min((unsigned long long) (_data.size() - _pos),
+			    n - done);
+    memcpy(p + done, &_data[_pos], chunk);
+    _pos += chunk;
+    done += chunk;
+  }
+  return done;
+}
+
+void BlockGzipReader::close()
+{
+  if (_infile.is_open()) {
+    _infile.close();
+  }
+  _data.clear();
+  _pos = 0;
+}
+
+bool BlockGzipReader::is_block_gzip(const std::string &filename)
+{
+  std::ifstream infile(filename.c_str(), ios::binary);
+  std::vector<char> header;
+
+  return infile.is_open() && _read_block_header(infile, header) != 0;
+}
+
+// vim: set sts=2 sw=2:
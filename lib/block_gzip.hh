@@ -0,0 +1,69 @@
+#ifndef BLOCK_GZIP_HH
+#define BLOCK_GZIP_HH
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+// the most data in one block, as in BGZF: small enough that even
+// incompressible data deflates into a 64 KiB block.
+#define BLOCK_GZIP_MAX_INPUT 0xff00
+
+// the most a block may take up, compressed.
+#define BLOCK_GZIP_MAX_BLOCK 0x10000
+
+// the number of blocks compressed, or decompressed, at a time, split
+// over the configured number of threads.
+#define BLOCK_GZIP_BATCH_BLOCKS 256
+
+namespace khmer {
+
+  //
+  // Block-compressed gzip files, in the BGZF layout: a series of gzip
+  // members, each deflating at most BLOCK_GZIP_MAX_INPUT bytes on its
+  // own, with the compressed size of the member in a "BC" extra field,
+  // ending in an empty member. Any gzip reader reads them as one stream;
+  // these classes use the block sizes to find the blocks, and compress
+  // and decompress batches of them in parallel.
+  //
+
+  class BlockGzipWriter {
+  protected:
+    std::ofstream	_outfile;
+    std::vector<char>	_pending;	// data not yet compressed
+
+    void _flush(size_t n_bytes);
+
+  public:
+    BlockGzipWriter(const std::string &outfilename);
+    ~BlockGzipWriter() { close(); }
+
+    void write(const void * data, unsigned long long n);
+    void close();
+  };
+
+  class BlockGzipReader {
+  protected:
+    std::ifstream	_infile;
+    std::vector<char>	_data;		// decompressed, not yet read
+    size_t		_pos;
+    bool		_at_end;
+
+    bool _fill();
+
+  public:
+    BlockGzipReader(const std::string &infilename);
+    ~BlockGzipReader() { close(); }
+
+    // read n bytes; returns how many there were.
+    unsigned long long read(void * data, unsigned long long n);
+    void close();
+
+    // whether the file starts with a block, as BlockGzipWriter writes.
+    static bool is_block_gzip(const std::string &filename);
+  };
+};
+
+#endif // BLOCK_GZIP_HH
+
+// vim: set sts=2 sw=2:
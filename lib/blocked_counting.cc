@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <new>
+#include "blocked_counting.hh"
+#include "table_io.hh"
+
+using namespace std;
+using namespace khmer;
+
+void BlockedCountingHash::_allocate_counters()
+{
+  HashIntoType total_bytes = 0;
+
+  _n_tables = _tablesizes.size();
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    total_bytes += _tablesizes[i];
+  }
+
+  _n_blocks = total_bytes / BLOOM_BLOCK_BYTES + 1;
+  _blockmod.set_size(_n_blocks);
+
+  void * blocks = NULL;
+  if (posix_memalign(&blocks, BLOOM_BLOCK_BYTES,
+		     _n_blocks * BLOOM_BLOCK_BYTES) != 0) {
+    throw std::bad_alloc();
+  }
+
+  _blocks = (Byte *) blocks;
+  memset(_blocks, 0, _n_blocks * BLOOM_BLOCK_BYTES);
+}
+
+void BlockedCountingHash::_free_counters()
+{
+  free(_blocks);
+  _blocks = NULL;
+}
+
+const HashIntoType BlockedCountingHash::n_occupied(HashIntoType start,
+						   HashIntoType stop) const
+{
+  HashIntoType n = 0;
+  HashIntoType n_counters = _n_blocks * BLOOM_BLOCK_BYTES;
+
+  for (HashIntoType i = 0; i < n_counters; i++) {
+    if (_blocks[i]) {
+      n++;
+    }
+  }
+  return n / _n_tables;
+}
+
+void BlockedCountingHash::_add_counter_distribution(HashIntoType * dist) const
+{
+  std::vector<HashIntoType> counters(MAX_BIGCOUNT + 1, 0);
+
+  _counter_distribution_static(*this, _n_blocks * BLOOM_BLOCK_BYTES,
+			       &counters[0]);
+  for (unsigned int c = 0; c <= MAX_BIGCOUNT; c++) {
+    dist[c] += counters[c] / _n_tables;
+  }
+}
+
+//
+// Blocked counting tables are saved as:
+//
+//   version, SAVED_BLOCKED_COUNTING_HT, use_bigcount, ksize, n_tables,
+//   hash_seeded [, seeds], tablesizes, n_blocks, blocks, bigcounts
+//
+// gzipped if the filename ends in .gz.
+//
+
+void BlockedCountingHash::save(std::string outfilename)
+{
+  assert(_blocks);
+
+  TableFileWriter outfile(outfilename);
+
+  unsigned char version = SAVED_FORMAT_VERSION;
+  outfile.write(&version, 1);
+
+  unsigned char ht_type = SAVED_BLOCKED_COUNTING_HT;
+  outfile.write(&ht_type, 1);
+
+  unsigned char use_bigcount = _use_bigcount ? 1 : 0;
+  outfile.write(&use_bigcount, 1);
+
+  unsigned int save_ksize = _ksize;
+  unsigned char save_n_tables = _n_tables;
+  outfile.write(&save_ksize, sizeof(save_ksize));
+  outfile.write(&save_n_tables, sizeof(save_n_tables));
+
+  unsigned char hash_seeded = _tableseeds.size() ? 1 : 0;
+  outfile.write(&hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write(&_tableseeds[0], sizeof(HashIntoType) * save_n_tables);
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned long long save_tablesize = _tablesizes[i];
+    outfile.write(&save_tablesize, sizeof(save_tablesize));
+  }
+
+  unsigned long long save_n_blocks = _n_blocks;
+  outfile.write(&save_n_blocks, sizeof(save_n_blocks));
+  outfile.write(_blocks, _n_blocks * BLOOM_BLOCK_BYTES);
+
+  std::vector<char> records;
+  HashIntoType n_counts = _bigcounts.get_records(records);
+  outfile.write(&n_counts, sizeof(n_counts));
+  if (n_counts) {
+    outfile.write(&records[0], records.size());
+  }
+
+  outfile.close();
+}
+
+void BlockedCountingHash::load(std::string infilename)
+{
+  _free_counters();
+  _tablesizes.clear();
+  _bigcounts.clear();
+
+  TableFileReader infile(infilename);
+
+  unsigned char version, ht_type, use_bigcount;
+  infile.read(&version, 1);
+  infile.read(&ht_type, 1);
+  if (version != SAVED_FORMAT_VERSION ||
+      ht_type != SAVED_BLOCKED_COUNTING_HT) {
+    throw InvalidTableFile();
+  }
+
+  infile.read(&use_bigcount, 1);
+  _use_bigcount = use_bigcount;
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  infile.read(&save_ksize, sizeof(save_ksize));
+  infile.read(&save_n_tables, sizeof(save_n_tables));
+
+  _ksize = (WordLength) save_ksize;
+  _n_tables = (unsigned int) save_n_tables;
+  _init_bitstuff();
+
+  _tableseeds.clear();
+  unsigned char hash_seeded = 0;
+  infile.read(&hash_seeded, 1);
+  if (hash_seeded) {
+    _tableseeds.resize(_n_tables);
+    infile.read(&_tableseeds[0], sizeof(HashIntoType) * _n_tables);
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned long long save_tablesize = 0;
+    infile.read(&save_tablesize, sizeof(save_tablesize));
+    _tablesizes.push_back((HashIntoType) save_tablesize);
+  }
+
+  _allocate_counters();
+
+  unsigned long long save_n_blocks = 0;
+  infile.read(&save_n_blocks, sizeof(save_n_blocks));
+  if (save_n_blocks != _n_blocks) {
+    throw InvalidTableFile();
+  }
+
+  infile.read(_blocks, _n_blocks * BLOOM_BLOCK_BYTES);
+
+  HashIntoType n_counts = 0;
+  infile.read(&n_counts, sizeof(n_counts));
+  if (n_counts > _n_blocks * BLOOM_BLOCK_BYTES) {
+    throw InvalidTableFile();
+  }
+
+  if (n_counts) {
+    std::vector<char> records(n_counts * BIGCOUNT_RECORD_SIZE);
+    infile.read(&records[0], records.size());
+    _bigcounts.set_records(&records[0], n_counts);
+  }
+
+  infile.close();
+}
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,191 @@
+#ifndef BLOCKED_COUNTING_HH
+#define BLOCKED_COUNTING_HH
+
+#include <vector>
+#include "counting.hh"
+#include "blocked_hashbits.hh"
+
+namespace khmer {
+
+  //
+  // BlockedCountingHash: a count-min sketch with the same interface,
+  // saturation and bigcount behavior as CountingHash, whose _n_tables
+  // counters for a k-mer all live in one BLOOM_BLOCK_BYTES block.
+  //
+  // The block is chosen by one hash and the counters within it by
+  // double hashing with an odd step, so that they are distinct and a
+  // k-mer update costs one cache miss rather than _n_tables. The sketch
+  // is as large as the given tables put together.
+  //
+
+  class BlockedCountingHash : public CountingHash {
+  protected:
+    HashIntoType _n_blocks;
+    TableModulus _blockmod;	// reciprocal of _n_blocks
+    Byte * _blocks;
+
+    HashIntoType _block_seed() const {
+      return _tableseeds.size() ? _tableseeds[0] : BLOOM_BLOCK_SEED;
+    }
+
+    HashIntoType _probe_seed() const {
+      return _tableseeds.size() ? ~_tableseeds[0] : BLOOM_PROBE_SEED;
+    }
+
+    // the block holding all of the counters for the given k-mer hash.
+    Byte * _block(HashIntoType khash) const {
+      HashIntoType block = _blockmod.reduce(_seeded_hash(khash,
+							 _block_seed()));
+      return _blocks + block * BLOOM_BLOCK_BYTES;
+    }
+
+    // the first counter, and the step between counters, within the block.
+    void _probes(HashIntoType khash,
+		 unsigned int &pos, unsigned int &step) const {
+      HashIntoType h = _seeded_hash(khash, _probe_seed());
+
+      pos = h % BLOOM_BLOCK_BYTES;
+      step = ((h >> 32) % BLOOM_BLOCK_BYTES) | 1;
+    }
+
+    // as CountingHash::_count_conservative, within the block.
+    void _count_conservative(HashIntoType khash) {
+      Byte *	    block	= _block(khash);
+      unsigned int  max_count	= _thresholds.max_count;
+      unsigned int  min_count	= max_count;
+      unsigned int  first, pos, step;
+
+      _probes(khash, first, step);
+
+      _lock_update(khash);
+      pos = first;
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	if (block[pos] < min_count) {
+	  min_count = block[pos];
+	}
+	pos = (pos + step) % BLOOM_BLOCK_BYTES;
+      }
+
+      if (min_count >= max_count) {
+	_unlock_update(khash);
+	if (_use_bigcount) {
+	  _count_big(khash);
+	}
+	return;
+      }
+
+      pos = first;
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	_raise_counter(block + pos, min_count + 1);
+	pos = (pos + step) % BLOOM_BLOCK_BYTES;
+      }
+      _unlock_update(khash);
+    }
+
+    virtual void _allocate_counters();
+    void _free_counters();
+
+    // per table's worth of counters, as with n_occupied.
+    virtual void _add_counter_distribution(HashIntoType * dist) const;
+
+    // no checkpoints; CountingHash::_snapshot would copy _counts, not the
+    // blocks.
+    virtual Hashtable * _snapshot() const { return NULL; }
+    virtual bool _has_plain_counters() const { return false; }
+
+  public:
+    BlockedCountingHash(WordLength ksize,
+			std::vector<HashIntoType>& tablesizes) :
+      CountingHash(ksize, tablesizes, false) {
+      _blocks = NULL;
+      _allocate_counters();
+    }
+
+    virtual ~BlockedCountingHash() {
+      _free_counters();
+    }
+
+    HashIntoType n_blocks() const { return _n_blocks; }
+
+    virtual void save(std::string);
+    virtual void load(std::string);
+
+    // the number of occupied counters, per table's worth of counters.
+    // (start and stop are ignored; the counters of a table are not laid
+    // out in k-mer hash order.)
+    virtual const HashIntoType n_occupied(HashIntoType start=0,
+					  HashIntoType stop=0) const;
+
+    virtual void count(HashIntoType khash) {
+      if (_use_conservative) {
+	_count_conservative(khash);
+	return;
+      }
+
+      Byte *	    block	= _block(khash);
+      unsigned int  max_count	= _thresholds.max_count;
+      unsigned int  n_full	= 0;
+      unsigned int  pos, step;
+
+      _probes(khash, pos, step);
+
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	if (!_bump_counter(block + pos, max_count)) {
+	  n_full++;
+	}
+	pos = (pos + step) % BLOOM_BLOCK_BYTES;
+      }
+
+      if (n_full == _n_tables && _use_bigcount) {
+	_count_big(khash);
+      }
+    }
+
+    virtual const BoundedCounterType get_count(HashIntoType khash) const {
+      const Byte *	  block		= _block(khash);
+      unsigned int	  max_count	= _thresholds.max_count;
+      BoundedCounterType  min_count	= max_count;
+      unsigned int	  pos, step;
+
+      _probes(khash, pos, step);
+
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	if (block[pos] < min_count) {
+	  min_count = block[pos];
+	}
+	pos = (pos + step) % BLOOM_BLOCK_BYTES;
+      }
+      if (min_count == max_count && _use_bigcount) {
+	min_count = _get_big_count(khash, min_count);
+      }
+      return min_count;
+    }
+
+    // the count in counter i of all of the blocks.
+    BoundedCounterType counter_at(HashIntoType i) const {
+      return _blocks[i];
+    }
+
+    // prefetch the block for the given k-mer hash.
+    void prefetch_bins(HashIntoType khash) const {
+      __builtin_prefetch(_block(khash), 1, 1);
+    }
+
+    virtual void count_many(const HashIntoType * khashes, unsigned int n) {
+      _count_many_static(*this, khashes, n);
+    }
+
+    virtual void get_counts(const HashIntoType * khashes, unsigned int n,
+			    BoundedCounterType * counts) const {
+      _get_counts_static(*this, khashes, n, counts);
+    }
+
+    // unhide the char * overloads, which hash and call the above.
+    using CountingHash::count;
+    using CountingHash::get_count;
+  };
+};
+
+#endif // BLOCKED_COUNTING_HH
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <new>
+#include "blocked_hashbits.hh"
+
+using namespace std;
+using namespace khmer;
+
+void BlockedHashbits::_allocate_counters()
+{
+  HashIntoType total_bits = 0;
+
+  _n_tables = _tablesizes.size();
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    total_bits += _tablesizes[i];
+  }
+
+  _n_blocks = total_bits / BLOOM_BLOCK_BITS + 1;
+  _blockmod.set_size(_n_blocks);
+
+  void * blocks = NULL;
+  if (posix_memalign(&blocks, BLOOM_BLOCK_BYTES,
+		     _n_blocks * BLOOM_BLOCK_BYTES) != 0) {
+    throw std::bad_alloc();
+  }
+
+  _blocks = (Byte *) blocks;
+  memset(_blocks, 0, _n_blocks * BLOOM_BLOCK_BYTES);
+}
+
+void BlockedHashbits::_free_counters()
+{
+  free(_blocks);
+  _blocks = NULL;
+}
+
+const bool BlockedHashbits::test_and_set_bits(HashIntoType khash)
+{
+  Byte * block = _block(khash);
+  unsigned int bit, step;
+  bool is_new_kmer = false;
+
+  _probes(khash, bit, step);
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned char mask = (unsigned char)(1 << (bit % 8));
+
+#ifdef KHMER_THREADED
+    unsigned char bits_orig = __sync_fetch_and_or(block + bit / 8, mask);
+    if (!(bits_orig & mask)) {
+      __sync_add_and_fetch(&_occupied_bins, 1);
+      is_new_kmer = true;
+    }
+#else
+    if (!(block[bit / 8] & mask)) {
+      block[bit / 8] |= mask;
+      _occupied_bins++;
+      is_new_kmer = true;
+    }
+#endif
+
+    bit = (bit + step) % BLOOM_BLOCK_BITS;
+  }
+
+  if (is_new_kmer) {
+#ifdef KHMER_THREADED
+    __sync_add_and_fetch(&_n_unique_kmers, 1);
+#else
+    _n_unique_kmers++;
+#endif
+    return true;		// kmer not seen before
+  }
+
+  return false;			// kmer already seen
+}
+
+void BlockedHashbits::save(std::string outfilename)
+{
+  assert(_blocks);
+
+  unsigned int save_ksize = _ksize;
+  unsigned char save_n_tables = _n_tables;
+  unsigned long long save_tablesize;
+  unsigned long long save_n_blocks = _n_blocks;
+
+  ofstream outfile(outfilename.c_str(), ios::binary);
+
+  unsigned char version = SAVED_FORMAT_VERSION;
+  outfile.write((const char *) &version, 1);
+
+  unsigned char ht_type = SAVED_BLOCKED_HASHBITS;
+  outfile.write((const char *) &ht_type, 1);
+
+  outfile.write((const char *) &save_ksize, sizeof(save_ksize));
+  outfile.write((const char *) &save_n_tables, sizeof(save_n_tables));
+
+  unsigned char hash_seeded = _tableseeds.size() ? 1 : 0;
+  outfile.write((const char *) &hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write((const char *) &_tableseeds[0],
+		  sizeof(HashIntoType) * save_n_tables);
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    save_tablesize = _tablesizes[i];
+    outfile.write((const char *) &save_tablesize, sizeof(save_tablesize));
+  }
+
+  outfile.write((const char *) &save_n_blocks, sizeof(save_n_blocks));
+  outfile.write((const char *) _blocks, _n_blocks * BLOOM_BLOCK_BYTES);
+
+  outfile.close();
+}
+
+void BlockedHashbits::load(std::string infilename)
+{
+  _free_counters();
+  _tablesizes.clear();
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  unsigned long long save_tablesize = 0;
+  unsigned long long save_n_blocks = 0;
+  unsigned char version, ht_type;
+
+  ifstream infile(infilename.c_str(), ios::binary);
+  if (!infile.is_open()) {
+    throw InvalidTableFile();
+  }
+
+  infile.read((char *) &version, 1);
+  infile.read((char *) &ht_type, 1);
+  if (!infile || version != SAVED_FORMAT_VERSION ||
+      ht_type != SAVED_BLOCKED_HASHBITS) {
+    throw InvalidTableFile();
+  }
+
+  infile.read((char *) &save_ksize, sizeof(save_ksize));
+  infile.read((char *) &save_n_tables, sizeof(save_n_tables));
+
+  _ksize = (WordLength) save_ksize;
+  _n_tables = (unsigned int) save_n_tables;
+  _init_bitstuff();
+
+  _tableseeds.clear();
+  unsigned char hash_seeded = 0;
+  infile.read((char *) &hash_seeded, 1);
+  if (hash_seeded) {
+    _tableseeds.resize(_n_tables);
+    infile.read((char *) &_tableseeds[0],
+		sizeof(HashIntoType) * _n_tables);
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    infile.read((char *) &save_tablesize, sizeof(save_tablesize));
+    _tablesizes.push_back((HashIntoType) save_tablesize);
+  }
+  if (!infile) {
+    throw InvalidTableFile();
+  }
+
+  _allocate_counters();
+
+  // a file which ends early, or does not hold the blocks its header
+  // makes for, fails the load.
+  infile.read((char *) &save_n_blocks, sizeof(save_n_blocks));
+  if (!infile || save_n_blocks != _n_blocks) {
+    throw InvalidTableFile();
+  }
+
+  infile.read((char *) _blocks, _n_blocks * BLOOM_BLOCK_BYTES);
+  if (!infile) {
+    throw InvalidTableFile();
+  }
+
+  infile.close();
+}
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,134 @@
+#ifndef BLOCKED_HASHBITS_HH
+#define BLOCKED_HASHBITS_HH
+
+#include <vector>
+#include "hashbits.hh"
+
+// one cache line.
+#define BLOOM_BLOCK_BYTES 64
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK_BYTES * 8)
+
+// default seeds for picking a block, and bits within it, when no
+// hash seed has been set.
+#define BLOOM_BLOCK_SEED 0x9e3779b97f4a7c15ULL
+#define BLOOM_PROBE_SEED 0xbf58476d1ce4e5b9ULL
+
+namespace khmer {
+
+  //
+  // BlockedHashbits: a blocked Bloom filter with the same interface as
+  // Hashbits, for use by the partitioning and graph traversal code.
+  //
+  // Rather than one bit in each of _n_tables separate tables, a k-mer
+  // sets _n_tables bits in a single BLOOM_BLOCK_BYTES block, chosen by
+  // one hash, so that each k-mer costs one cache miss instead of
+  // _n_tables. The bits within the block come from double hashing; the
+  // step is odd, so they are all distinct. The filter is as large as
+  // the given tables put together.
+  //
+
+  class BlockedHashbits : public Hashbits {
+  protected:
+    HashIntoType _n_blocks;
+    TableModulus _blockmod;	// reciprocal of _n_blocks
+    Byte * _blocks;
+
+    HashIntoType _block_seed() const {
+      return _tableseeds.size() ? _tableseeds[0] : BLOOM_BLOCK_SEED;
+    }
+
+    HashIntoType _probe_seed() const {
+      return _tableseeds.size() ? ~_tableseeds[0] : BLOOM_PROBE_SEED;
+    }
+
+    // the block holding all of the bits for the given k-mer hash.
+    Byte * _block(HashIntoType khash) const {
+      HashIntoType block = _blockmod.reduce(_seeded_hash(khash,
+							 _block_seed()));
+      return _blocks + block * BLOOM_BLOCK_BYTES;
+    }
+
+    // the first bit, and the step between bits, within the block.
+    void _probes(HashIntoType khash,
+		 unsigned int &bit, unsigned int &step) const {
+      HashIntoType h = _seeded_hash(khash, _probe_seed());
+
+      bit = h % BLOOM_BLOCK_BITS;
+      step = ((h >> 32) % BLOOM_BLOCK_BITS) | 1;
+    }
+
+    virtual void _allocate_counters();
+    void _free_counters();
+
+    // not checkpointed, mapped or merged, as the blocks are not in
+    // _counts.
+    virtual Hashtable * _snapshot() const { return NULL; }
+    virtual bool _has_plain_counters() const { return false; }
+
+  public:
+    BlockedHashbits(WordLength ksize, std::vector<HashIntoType>& tablesizes) :
+      Hashbits(ksize, tablesizes, false) {
+      _blocks = NULL;
+      _allocate_counters();
+    }
+
+    ~BlockedHashbits() {
+      _free_counters();
+    }
+
+    HashIntoType n_blocks() const { return _n_blocks; }
+
+    virtual void save(std::string);
+    virtual void load(std::string);
+
+    virtual const bool test_and_set_bits(HashIntoType khash);
+
+    virtual void count(HashIntoType khash) {
+      BlockedHashbits::test_and_set_bits(khash);
+    }
+
+    virtual void count_overlap(HashIntoType khash, Hashbits &ht2) {
+      if (test_and_set_bits(khash) && check_overlap(khash, ht2)) {
+	_n_overlap_kmers += 1;
+      }
+    }
+
+    virtual const BoundedCounterType get_count(HashIntoType khash) const {
+      const Byte * block = _block(khash);
+      unsigned int bit, step;
+      _probes(khash, bit, step);
+
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	if (!(block[bit / 8] & (1 << (bit % 8)))) {
+	  return 0;
+	}
+	bit = (bit + step) % BLOOM_BLOCK_BITS;
+      }
+      return 1;
+    }
+
+    // prefetch the block for the given k-mer hash.
+    void prefetch_bins(HashIntoType khash) const {
+      __builtin_prefetch(_block(khash), 1, 1);
+    }
+
+    virtual void count_many(const HashIntoType * khashes, unsigned int n) {
+      _count_many_static(*this, khashes, n);
+    }
+
+    virtual void get_counts(const HashIntoType * khashes, unsigned int n,
+			    BoundedCounterType * counts) const {
+      _get_counts_static(*this, khashes, n, counts);
+    }
+
+    // unhide the char * overloads, which hash and call the above.
+    using Hashbits::test_and_set_bits;
+    using Hashbits::count;
+    using Hashbits::count_overlap;
+    using Hashbits::get_count;
+  };
+};
+
+#endif // BLOCKED_HASHBITS_HH
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include "checkpoint.hh"
+#include "hashtable.hh"
+#include "khmer_exception.hh"
+
+using namespace std;
+using namespace khmer;
+
+#define CHECKPOINT_MAGIC "khmer checkpoint"
+
+bool khmer::sync_file(const std::string &filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+// the directory entry a rename makes is only on disk once its directory
+// is synced; not every file system can, so this is best effort.
+static void _sync_dir_of(const std::string &filename)
+{
+  std::string::size_type slash = filename.find_last_of("/");
+  if (slash == std::string::npos) {
+    sync_file(".");
+  } else {
+    sync_file(slash ? filename.substr(0, slash) : "/");
+  }
+}
+
+//
+// CheckpointInfo
+//
+
+std::string CheckpointInfo::tables_prefix(const std::string &prefix) const
+{
+  std::ostringstream name;
+  name << prefix << "." << generation;
+  return name.str();
+}
+
+// the record is written alongside, then renamed over the last one, so
+// that a crash while writing it leaves the last one whole.
+bool CheckpointInfo::save(const std::string &prefix) const
+{
+  std::string filename_tmp = prefix + ".checkpoint.tmp";
+  ofstream outfile(filename_tmp.c_str());
+  if (!outfile.is_open()) {
+    return false;
+  }
+
+  outfile << CHECKPOINT_MAGIC << "\n";
+  outfile << filename << "\n";
+  outfile << (tag ? 1 : 0) << " " << interval << " " << n_reads << " "
+	  << n_consumed << " " << generation << "\n";
+  outfile.close();
+
+  if (outfile.fail() || !sync_file(filename_tmp) ||
+      rename(filename_tmp.c_str(), (prefix + ".checkpoint").c_str()) != 0) {
+    remove(filename_tmp.c_str());
+    return false;
+  }
+  _sync_dir_of(prefix);
+  return true;
+}
+
+void CheckpointInfo::load(const std::string &prefix)
+{
+  ifstream infile((prefix + ".checkpoint").c_str());
+  if (!infile.is_open()) {
+    throw InvalidCheckpoint();
+  }
+
+  std::string magic;
+  getline(infile, magic);
+  if (magic != CHECKPOINT_MAGIC) {
+    throw InvalidCheckpoint();
+  }
+
+  getline(infile, filename);
+
+  int is_tag = 0;
+  infile >> is_tag >> interval >> n_reads >> n_consumed >> generation;
+  if (infile.fail()) {
+    throw InvalidCheckpoint();
+  }
+  tag = is_tag != 0;
+
+  // the tables it names must still be there, to resume from; the table
+  // loaders do not all fail cleanly on a missing file.
+  std::string tables = tables_prefix(prefix);
+  ifstream ht_file((tables + ".ht").c_str());
+  if (!ht_file.is_open()) {
+    throw InvalidCheckpoint();
+  }
+  if (tag) {
+    ifstream tagset_file((tables + ".tagset").c_str());
+    if (!tagset_file.is_open()) {
+      throw InvalidCheckpoint();
+    }
+  }
+}
+
+//
+// CheckpointWriter
+//
+
+static void _remove_tables(const std::string &tables)
+{
+  remove((tables + ".ht").c_str());
+  remove((tables + ".tagset").c_str());
+}
+
+void * CheckpointWriter::_run(void * writer)
+{
+  CheckpointWriter * me = (CheckpointWriter *) writer;
+  CheckpointInfo &info = me->_info;
+
+  std::string tables = info.tables_prefix(me->_prefix);
+
+  // once the record names these tables, the generation before is not
+  // needed any more; if they, or it, could not be written, these are
+  // not, and the record still names the generation before.
+  if (me->_snapshot->_save_checkpoint(tables) && info.save(me->_prefix)) {
+    if (info.generation > 1) {
+      CheckpointInfo before = info;
+      before.generation--;
+      _remove_tables(before.tables_prefix(me->_prefix));
+    }
+  } else {
+    me->_failed = true;
+    _remove_tables(tables);
+  }
+
+  delete me->_snapshot;
+  me->_snapshot = NULL;
+
+  __sync_synchronize();
+  me->_done = true;
+  return NULL;
+}
+
+void CheckpointWriter::start(Hashtable * snapshot, const CheckpointInfo &info)
+{
+  wait();
+
+  _snapshot = snapshot;
+  _info = info;
+  _done = false;
+
+  if (pthread_create(&_thread, NULL, _run, this) != 0) {
+    _run(this);
+    return;
+  }
+  _running = true;
+}
+
+void CheckpointWriter::wait()
+{
+  if (_running) {
+    pthread_join(_thread, NULL);
+    _running = false;
+  }
+}
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,92 @@
+#ifndef CHECKPOINT_HH
+#define CHECKPOINT_HH
+
+#include <string>
+#include <pthread.h>
+
+// the number of reads a checkpointed consume reads at a time; checkpoints
+// are taken between batches, once all of the reads before are consumed.
+#define CHECKPOINT_BATCH_SIZE 10000
+
+namespace khmer {
+  class Hashtable;
+
+  // flush a written file through to the disk; false if it cannot be.
+  bool sync_file(const std::string &filename);
+
+  //
+  // A checkpoint of a consume_fasta (or consume_fasta_and_tag) run: the
+  // tables, and tags, as of the first n_reads reads of the file, saved
+  // as <prefix>.<generation>.ht (and .tagset), and this record of them
+  // in <prefix>.checkpoint. The record is written after the tables, and
+  // renamed into place, so that it always names a whole checkpoint; the
+  // tables of the generation before are removed after that. Both are
+  // synced to disk first, so that this holds across a power loss, too.
+  //
+
+  struct CheckpointInfo {
+    std::string filename;		// the file being consumed
+    bool tag;				// consume_fasta_and_tag?
+    unsigned long long interval;	// reads between checkpoints
+    unsigned long long n_reads;		// reads consumed into the tables
+    unsigned long long n_consumed;
+    unsigned int generation;
+
+    CheckpointInfo() : tag(false), interval(0), n_reads(0), n_consumed(0),
+		       generation(0) { }
+
+    // the prefix of the table files of this generation.
+    std::string tables_prefix(const std::string &prefix) const;
+
+    // returns false, leaving the record before in place, if this one
+    // could not be written whole.
+    bool save(const std::string &prefix) const;
+
+    // throws InvalidCheckpoint if there is no whole record to read, or
+    // its tables are gone.
+    void load(const std::string &prefix);
+  };
+
+  //
+  // Writes checkpoints on a background thread, one at a time, from
+  // snapshots of the tables, so that consuming carries on meanwhile.
+  //
+
+  class CheckpointWriter {
+  protected:
+    std::string		_prefix;
+    Hashtable *		_snapshot;
+    CheckpointInfo	_info;
+    pthread_t		_thread;
+    bool		_running;
+    volatile bool	_done;
+    bool		_failed;
+
+    static void * _run(void * writer);
+
+  public:
+    CheckpointWriter(const std::string &prefix) :
+      _prefix(prefix), _snapshot(NULL), _running(false), _done(false),
+      _failed(false) { }
+    ~CheckpointWriter() { wait(); }
+
+    // whether a checkpoint is still being written.
+    bool is_busy() const { return _running && !_done; }
+
+    // write a checkpoint of the snapshot, which this takes over, in the
+    // background; waits for the one before, if need be. If no thread
+    // can be started, it is written before this returns.
+    void start(Hashtable * snapshot, const CheckpointInfo &info);
+
+    // wait for the checkpoint being written, if any.
+    void wait();
+
+    // whether a checkpoint written so far could not be recorded; the last
+    // one that was still stands.
+    bool has_failed() const { return _failed; }
+  };
+};
+
+#endif // CHECKPOINT_HH
+
+// vim: set sts=2 sw=2:
@@ -2,15 +2,58 @@
 #include "counting.hh"
 #include "hashbits.hh"
 #include "parsers.hh"
+#include "table_io.hh"
+#include "table_merge.hh"
 
 #include "zlib/zlib.h"
 #include <math.h>
+#include <pthread.h>
 #include <algorithm>
+#include <exception>
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
 using namespace std;
 using namespace khmer;
 using namespace khmer:: read_parsers;
 
+// The k-mers and counts of the read being queried, kept per thread and
+// reused from read to read, so that querying a read allocates nothing
+// once the buffers have grown to the longest read. They are freed when
+// their thread exits.
+
+struct _ReadScratch {
+  std::vector<HashIntoType>	  kmers;
+  std::vector<BoundedCounterType> counts;
+};
+
+static pthread_key_t _scratch_key;
+static pthread_once_t _scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void _free_scratch(void * scratch)
+{
+  delete (_ReadScratch *) scratch;
+}
+
+static void _make_scratch_key()
+{
+  pthread_key_create(&_scratch_key, _free_scratch);
+}
+
+static _ReadScratch& _thread_scratch()
+{
+  pthread_once(&_scratch_key_once, _make_scratch_key);
+
+  _ReadScratch * scratch = (_ReadScratch *) pthread_getspecific(_scratch_key);
+  if (!scratch) {
+    scratch = new _ReadScratch;
+    pthread_setspecific(_scratch_key, scratch);
+  }
+  return *scratch;
+}
+
 MinMaxTable * CountingHash::fasta_file_to_minmax(const std::string &inputfile,
 					      unsigned long long total_reads,
 					      ReadMaskTable * readmask,
@@ -361,25 +404,21 @@ BoundedCounterType CountingHash::get_min_count(const std::string &s,
 					    HashIntoType lower_bound,
 					    HashIntoType upper_bound)
 {
-  KMerIterator kmers(s.c_str(), _ksize);
-  HashIntoType kmer;
-
-  BoundedCounterType min_count = MAX_COUNT, count;
-
-  bool bounded = true;
-  if (lower_bound == upper_bound && upper_bound == 0) {
-    bounded = false;
+  _ReadScratch &scratch = _thread_scratch();
+  std::vector<HashIntoType> &kmers = scratch.kmers;
+  std::vector<BoundedCounterType> &counts = scratch.counts;
+
+  get_kmer_hashes(s, kmers, lower_bound, upper_bound);
+  counts.resize(kmers.size());
+  if (kmers.size()) {
+    get_counts(&kmers[0], kmers.size(), &counts[0]);
   }
 
-  while(!kmers.done()) {
-    kmer = kmers.next();
+  BoundedCounterType min_count = MAX_COUNT;
 
-    if (!bounded || (kmer >= lower_bound && kmer < upper_bound)) {
-      count = this->get_count(kmer);
-    
-      if (count < min_count) {
-	min_count = count;
-      }
+  for (unsigned int i = 0; i < counts.size(); i++) {
+    if (counts[i] < min_count) {
+      min_count = counts[i];
     }
   }
   return min_count;
@@ -389,30 +428,51 @@ BoundedCounterType CountingHash::get_max_count(const std::string &s,
 					    HashIntoType lower_bound,
 					    HashIntoType upper_bound)
 {
-  KMerIterator kmers(s.c_str(), _ksize);
-
-  BoundedCounterType max_count = 0, count;
+  std::vector<HashIntoType> kmers;
+  std::vector<BoundedCounterType> counts;
 
-  bool bounded = true;
-  if (lower_bound == upper_bound && upper_bound == 0) {
-    bounded = false;
+  get_kmer_hashes(s, kmers, lower_bound, upper_bound);
+  counts.resize(kmers.size());
+  if (kmers.size()) {
+    get_counts(&kmers[0], kmers.size(), &counts[0]);
   }
 
-  HashIntoType kmer;
-  while(!kmers.done()) {
-    kmer = kmers.next();
-
-    if (!bounded || (kmer >= lower_bound && kmer < upper_bound)) {
-      count = this->get_count(kmer);
+  BoundedCounterType max_count = 0;
 
-      if (count > max_count) {
-	max_count = count;
-      }
+  for (unsigned int i = 0; i < counts.size(); i++) {
+    if (counts[i] > max_count) {
+      max_count = counts[i];
     }
   }
   return max_count;
 }
 
+//
+// abundance_distribution: the number of distinct k-mers in the given file
+// with each count. One worker per configured thread shares the parser,
+// each with a histogram of its own. Only the calling thread runs the
+// callback.
+//
+
+// Whether this is the first sighting of a k-mer. test_and_set_bits sets
+// the bits one table at a time, so two workers on the same new k-mer
+// could each find one of its bits unset, and both count it; a lock per
+// stripe of k-mers has them take turns, so that exactly one does.
+static bool _first_sighting(Hashbits * tracking, HashIntoType kmer,
+			    std::vector<unsigned int> &locks)
+{
+  if (locks.empty()) {
+    return tracking->test_and_set_bits(kmer);
+  }
+
+  unsigned int * lock = &locks[kmer % locks.size()];
+  while (__sync_lock_test_and_set(lock, 1)) ;
+  bool is_new = tracking->test_and_set_bits(kmer);
+  __sync_lock_release(lock);
+
+  return is_new;
+}
+
 HashIntoType * CountingHash::abundance_distribution(std::string filename,
 						    Hashbits * tracking,
 			    CallbackFn callback,
@@ -425,48 +485,122 @@ HashIntoType * CountingHash::abundance_distribution(std::string filename,
     dist[i] = 0;
   }
 
-  Read read;
-  IParser* parser = IParser::get_parser(filename.c_str());
-  string name;
-  string seq;
-  unsigned long long read_num = 0;
-
   // if not, could lead to overflow.
   assert(sizeof(BoundedCounterType) == 2);
 
-  while(!parser->is_complete()) {
-    read = parser->get_next_read();
-    seq = read.sequence;
+  // Without C++11, a worker's exception cannot be carried out of the
+  // parallel region, so there is just the one.
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+#if !defined( _OPENMP ) || (__cplusplus < 201103L)
+  number_of_threads = 1;
+#endif
 
-    if (check_and_normalize_read(seq)) {
-      HashIntoType kmer;
-      KMerIterator kmers(seq.c_str(), _ksize);
+  IParser* parser = IParser::get_parser(filename.c_str(), number_of_threads);
+  unsigned long long read_num = 0;
+  volatile bool stop = false;
+  std::vector<unsigned int> claim_locks;
+  if (number_of_threads > 1) {
+    claim_locks.assign(ABUNDANCE_CLAIM_LOCKS, 0);
+  }
+#if (__cplusplus >= 201103L)
+  std::exception_ptr error;
+#endif
+
+#pragma omp parallel num_threads( number_of_threads ) default( shared )
+  {
+    std::vector<HashIntoType> thread_dist(MAX_BIGCOUNT + 1, 0);
+    Read read;
+    string seq;
+    std::vector<HashIntoType> kmers;
+    std::vector<BoundedCounterType> counts;
+    unsigned long long next_report = CALLBACK_PERIOD;
+#ifdef _OPENMP
+    bool is_caller = 0 == omp_get_thread_num();
+#else
+    bool is_caller = true;
+#endif
+
+#if (__cplusplus >= 201103L)
+    try {
+#endif
+      while(!stop && !parser->is_complete()) {
+	read = parser->get_next_read();
+	seq = read.sequence;
+
+	if (check_and_normalize_read(seq)) {
+	  get_kmer_hashes(seq, kmers);
+	  counts.resize(kmers.size());
+	  if (kmers.size()) {
+	    get_counts(&kmers[0], kmers.size(), &counts[0]);
+	  }
 
-      while(!kmers.done()) {
-	kmer = kmers.next();
+	  for (unsigned int i = 0; i < kmers.size(); i++) {
+	    if (_first_sighting(tracking, kmers[i], claim_locks)) {
+	      thread_dist[counts[i]]++;
+	    }
+	  }
+	}
 
-	if (!tracking->get_count(kmer)) {
-	  tracking->count(kmer);
+	unsigned long long n = __sync_add_and_fetch(&read_num, 1);
 
-	  BoundedCounterType n = get_count(kmer);
-	  dist[n]++;
+	// run callback, if specified
+	if (is_caller && callback && n >= next_report) {
+	  callback("abundance_distribution", callback_data, n, 0);
+	  next_report = n + CALLBACK_PERIOD;
 	}
       }
+#if (__cplusplus >= 201103L)
+    } catch (...) {
+#pragma omp critical (abundance_distribution_error)
+      if (!error) {
+	error = std::current_exception();
+      }
+      stop = true;
+    }
+#endif
 
-      name.clear();
-      seq.clear();
+#pragma omp critical (abundance_distribution_reduce)
+    for (unsigned int c = 0; c <= MAX_BIGCOUNT; c++) {
+      dist[c] += thread_dist[c];
     }
+  } // omp parallel
 
-    read_num += 1;
+  delete parser;
 
-    // run callback, if specified
-    if (read_num % CALLBACK_PERIOD == 0 && callback) {
-      try {
-        callback("abundance_distribution", callback_data, read_num, 0);
-      } catch (...) {
-        throw;
-      }
+#if (__cplusplus >= 201103L)
+  if (error) {
+    delete[] dist;
+    std::rethrow_exception(error);
+  }
+#endif
+
+  return dist;
+}
+
+void CountingHash::_add_counter_distribution(HashIntoType * dist) const
+{
+  _counter_distribution_static(*this, _tablesizes[0], dist);
+}
+
+HashIntoType * CountingHash::bin_abundance_distribution() const
+{
+  HashIntoType * dist = new HashIntoType[MAX_BIGCOUNT + 1];
+
+  for (unsigned int c = 0; c <= MAX_BIGCOUNT; c++) {
+    dist[c] = 0;
+  }
+
+  _add_counter_distribution(dist);
+
+  std::vector<std::pair<HashIntoType, BoundedCounterType> > big;
+  _bigcounts.get_entries(big);
+
+  for (unsigned int i = 0; i < big.size(); i++) {
+    if (dist[_thresholds.max_count]) {
+      dist[_thresholds.max_count]--;
     }
+    dist[big[i].second]++;
   }
 
   return dist;
@@ -593,6 +727,172 @@ void CountingHash::load(std::string infilename)
   CountingHashFile::load(infilename, *this);
 }
 
+Hashtable * CountingHash::_snapshot() const
+{
+  std::vector<HashIntoType> tablesizes = _tablesizes;
+  CountingHash * snapshot = new CountingHash(_ksize, tablesizes, false);
+
+  init_table_moduli(snapshot->_tablesizes, snapshot->_tablemods);
+  snapshot->_counts = new Byte*[_n_tables];
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    snapshot->_counts[i] = new Byte[_tablesizes[i]];
+    memcpy(snapshot->_counts[i], _counts[i], _tablesizes[i]);
+  }
+
+  snapshot->_tableseeds = _tableseeds;
+  snapshot->_use_bigcount = _use_bigcount;
+
+  std::vector<char> records;
+  HashIntoType n_records = _bigcounts.get_records(records);
+  if (n_records) {
+    snapshot->_bigcounts.set_records(&records[0], n_records);
+  }
+
+  return snapshot;
+}
+
+void CountingHash::save_sparse(std::string outfilename)
+{
+  if (!_has_plain_counters()) {
+    throw UnsupportedTableLayout();
+  }
+  CountingHashSparseFileWriter(outfilename, *this);
+}
+
+// the layout is as CountingHashFileReader reads it.
+bool CountingHash::can_merge(const CountingHash &other) const
+{
+  return _has_plain_counters() && other._has_plain_counters() &&
+    _ksize == other._ksize && _tablesizes == other._tablesizes &&
+    _tableseeds == other._tableseeds &&
+    _thresholds.max_count == other._thresholds.max_count &&
+    _thresholds.max_bigcount == other._thresholds.max_bigcount;
+}
+
+void CountingHash::merge(const CountingHash &other)
+{
+  if (!_has_plain_counters() || !other._has_plain_counters()) {
+    throw UnsupportedTableLayout();
+  }
+  assert(can_merge(other));
+  assert(_counts && other._counts);
+
+  // the sums for the k-mers with big counts, from the counts as they
+  // were before the merge.
+  std::vector<std::pair<HashIntoType, BoundedCounterType> > entries;
+  std::vector<std::pair<HashIntoType, BoundedCounterType> > other_entries;
+  std::vector<std::pair<HashIntoType, unsigned int> > sums;
+
+  _bigcounts.get_entries(entries);
+  other._bigcounts.get_entries(other_entries);
+  entries.insert(entries.end(), other_entries.begin(), other_entries.end());
+  std::sort(entries.begin(), entries.end());
+
+  for (unsigned int i = 0; i < entries.size(); i++) {
+    HashIntoType khash = entries[i].first;
+    if (i && khash == entries[i - 1].first) {
+      continue;
+    }
+    sums.push_back(std::make_pair(khash, (unsigned int) get_count(khash) +
+				  other.get_count(khash)));
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    merge_counters(_counts[i], other._counts[i], _tablesizes[i],
+		   _thresholds.max_count);
+  }
+
+  _use_bigcount = _use_bigcount || other._use_bigcount;
+  if (!_use_bigcount) {
+    return;
+  }
+  for (unsigned int i = 0; i < sums.size(); i++) {
+    if (sums[i].second > _thresholds.max_count) {
+      _bigcounts.set(sums[i].first, MIN(sums[i].second,
+					(unsigned int) _thresholds.max_bigcount));
+    }
+  }
+}
+
+void CountingHash::load_mapped(std::string infilename, bool shared,
+			       bool populate)
+{
+  if (!_has_plain_counters()) {
+    throw UnsupportedTableLayout();
+  }
+
+  _free_tables();
+  _tablesizes.clear();
+
+  // the tables point into the mapping, so it goes with them if the load
+  // fails part way.
+  _mapping = new MappedFile(infilename, shared, populate);
+  MappedFile * mapping = _mapping;
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  unsigned long long save_tablesize = 0;
+  unsigned char version, ht_type, use_bigcount;
+
+  mapping->read(&version, 1);
+  mapping->read(&ht_type, 1);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
+  assert(ht_type == SAVED_COUNTING_HT);
+
+  mapping->read(&use_bigcount, 1);
+  mapping->read(&save_ksize, sizeof(save_ksize));
+  mapping->read(&save_n_tables, sizeof(save_n_tables));
+
+  _ksize = (WordLength) save_ksize;
+  _n_tables = (unsigned int) save_n_tables;
+  _init_bitstuff();
+
+  _tableseeds.clear();
+  if (version >= 4) {
+    unsigned char hash_seeded = 0;
+    mapping->read(&hash_seeded, 1);
+    if (hash_seeded) {
+      _tableseeds.resize(_n_tables);
+      mapping->read(&_tableseeds[0], sizeof(HashIntoType) * _n_tables);
+    }
+  }
+
+  _use_bigcount = use_bigcount;
+
+  _counts = new Byte*[_n_tables]();
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    mapping->read(&save_tablesize, sizeof(save_tablesize));
+    _tablesizes.push_back((HashIntoType) save_tablesize);
+
+    _counts[i] = (Byte *) mapping->take(save_tablesize);
+  }
+
+  init_table_moduli(_tablesizes, _tablemods);
+
+  HashIntoType n_counts = 0;
+  _mapping->read(&n_counts, sizeof(n_counts));
+
+  // the bigcounts change shape as they grow, so they are read in.
+  _bigcounts.clear();
+  if (n_counts) {
+    _bigcounts.set_records(_mapping->take(n_counts * BIGCOUNT_RECORD_SIZE),
+			   n_counts);
+  }
+}
+
+void CountingHash::_get_scratch_counts(const std::string &s,
+				       std::vector<HashIntoType> &kmers,
+				       std::vector<BoundedCounterType> &counts)
+  const
+{
+  get_kmer_hashes(s, kmers);
+  counts.resize(kmers.size());
+  if (kmers.size()) {
+    get_counts(&kmers[0], kmers.size(), &counts[0]);
+  }
+}
+
 // technically, get medioid count... our "median" is always a member of the
 // population.
 
@@ -601,15 +901,10 @@ void CountingHash::get_median_count(const std::string &s,
 				    float &average,
 				    float &stddev)
 {
-  BoundedCounterType count;
-  std::vector<BoundedCounterType> counts;
-  KMerIterator kmers(s.c_str(), _ksize);
+  _ReadScratch &scratch = _thread_scratch();
+  std::vector<BoundedCounterType> &counts = scratch.counts;
 
-  while(!kmers.done()) {
-    HashIntoType kmer = kmers.next();
-    count = this->get_count(kmer);
-    counts.push_back(count);
-  }
+  _get_scratch_counts(s, scratch.kmers, counts);
 
   assert(counts.size());
 
@@ -636,23 +931,20 @@ void CountingHash::get_median_count(const std::string &s,
   stddev /= float(counts.size());
   stddev = sqrt(stddev);
 
-  sort(counts.begin(), counts.end());
-  median = counts[counts.size() / 2]; // rounds down
+  // rounds down
+  nth_element(counts.begin(), counts.begin() + counts.size() / 2,
+	      counts.end());
+  median = counts[counts.size() / 2];
 }
 
 void CountingHash::get_kadian_count(const std::string &s,
 				    BoundedCounterType &kadian,
 				    unsigned int nk)
 {
-  BoundedCounterType count;
-  std::vector<BoundedCounterType> counts;
-  KMerIterator kmers(s.c_str(), _ksize);
+  _ReadScratch &scratch = _thread_scratch();
+  std::vector<BoundedCounterType> &counts = scratch.counts;
 
-  while(!kmers.done()) {
-    HashIntoType kmer = kmers.next();
-    count = this->get_count(kmer);
-    counts.push_back(count);
-  }
+  _get_scratch_counts(s, scratch.kmers, counts);
 
   assert(counts.size());
   unsigned int kpos = nk*_ksize;
@@ -663,18 +955,196 @@ void CountingHash::get_kadian_count(const std::string &s,
     return;
   }
 
-  sort(counts.begin(), counts.end());
+  nth_element(counts.begin(), counts.begin() + (kpos - 1), counts.end());
   kadian = counts[kpos - 1];
+}
 
-#if 0
-  std::cout << "k " << kpos << ": ";
-  for (unsigned int i = 0; i < counts.size(); i++) {
-    std::cout << i << "-" << counts[i] << " ";
+bool CountingHash::median_exceeds(const std::string &s,
+				  BoundedCounterType cutoff) const
+{
+  _ReadScratch &scratch = _thread_scratch();
+  std::vector<HashIntoType> &kmers = scratch.kmers;
+  std::vector<BoundedCounterType> &counts = scratch.counts;
+
+  get_kmer_hashes(s, kmers);
+
+  // the median, counts[n / 2] in sorted order, is above cutoff iff no
+  // more than n / 2 counts are at or below it.
+  unsigned int n = kmers.size();
+  unsigned int max_low = n / 2;
+  unsigned int min_high = n - max_low;
+  unsigned int n_low = 0, n_high = 0;
+
+  counts.resize(MEDIAN_PROBE_BATCH_SIZE);
+  for (unsigned int i = 0; i < n; i += MEDIAN_PROBE_BATCH_SIZE) {
+    unsigned int batch = n - i < MEDIAN_PROBE_BATCH_SIZE ?
+      n - i : MEDIAN_PROBE_BATCH_SIZE;
+
+    get_counts(&kmers[i], batch, &counts[0]);
+    for (unsigned int j = 0; j < batch; j++) {
+      if (counts[j] > cutoff) {
+	if (++n_high >= min_high) {
+	  return true;
+	}
+      } else if (++n_low > max_low) {
+	return false;
+      }
+    }
   }
-  std::cout << "\n";
-#endif // 0
+
+  // only reached if there were no k-mers.
+  return false;
+}
+
+//
+// normalize_by_median: see counting.hh.
+//
+
+// The stem and mate number (1 or 2; 0 if neither) of a read's name.
+static unsigned int _mate_of(const std::string &name, std::string &stem)
+{
+  std::string::size_type space = name.find_first_of(" \t");
+  std::string first = name.substr(0, space);
+
+  stem = first;
+  if (first.length() > 2 && first[first.length() - 2] == '/') {
+    char mate = first[first.length() - 1];
+    if (mate == '1' || mate == '2') {
+      stem = first.substr(0, first.length() - 2);
+      return mate - '0';
+    }
+  }
+  if (space != std::string::npos && space + 2 < name.length() &&
+      name[space + 2] == ':') {
+    char mate = name[space + 1];
+    if (mate == '1' || mate == '2') {
+      return mate - '0';
+    }
+  }
+  return 0;
 }
 
+static bool _is_pair(const Read &first, const Read &second)
+{
+  std::string first_stem, second_stem;
+
+  return _mate_of(first.name, first_stem) == 1 &&
+    _mate_of(second.name, second_stem) == 2 &&
+    first_stem == second_stem;
+}
+
+void CountingHash::normalize_by_median(const std::string &inputfile,
+				       const std::string &outputfile,
+				       BoundedCounterType cutoff,
+				       bool paired,
+				       unsigned long long &n_total,
+				       unsigned long long &n_kept,
+				       CallbackFn callback,
+				       void * callback_data)
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+
+  // only this thread reads, so that the batches are in input order.
+  IParser * parser = IParser::get_parser(inputfile.c_str(), 1);
+  ofstream outfile(outputfile.c_str());
+
+  parser->set_keep_reads_with_n(true);
+
+  std::vector<Read> batch;
+  std::vector<unsigned int> unit_starts;
+  std::vector<char> keep;
+  Read carried;
+  bool have_carried = false;
+
+  n_total = 0;
+  n_kept = 0;
+
+  while (have_carried || !parser->is_complete()) {
+    batch.clear();
+    if (have_carried) {
+      batch.push_back(carried);
+      have_carried = false;
+    }
+    while (batch.size() < NORMALIZE_BATCH_SIZE && !parser->is_complete()) {
+      batch.push_back(parser->get_next_read());
+    }
+
+    // hold back a first mate at the end, for its mate in the next batch.
+    std::string stem;
+    if (paired && !parser->is_complete() && batch.size() > 1 &&
+	_mate_of(batch.back().name, stem) == 1) {
+      carried = batch.back();
+      have_carried = true;
+      batch.pop_back();
+    }
+
+    // split the batch into units: pairs, or single reads.
+    unit_starts.clear();
+    for (unsigned int i = 0; i < batch.size(); i++) {
+      unit_starts.push_back(i);
+      if (paired && i + 1 < batch.size() && _is_pair(batch[i], batch[i+1])) {
+	i++;
+      }
+    }
+    unit_starts.push_back(batch.size());
+
+    long long n_units = unit_starts.size() - 1;
+    keep.assign(n_units, 0);
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic, 64 )
+    for (long long u = 0; u < n_units; u++) {
+      std::string seqs[2];
+      bool valid[2] = { false, false };
+      unsigned int n = unit_starts[u + 1] - unit_starts[u];
+
+      for (unsigned int j = 0; j < n; j++) {
+	// checked and counted with each N as an A; written out as it came.
+	seqs[j] = batch[unit_starts[u] + j].sequence;
+	std::replace(seqs[j].begin(), seqs[j].end(), 'N', 'A');
+	std::replace(seqs[j].begin(), seqs[j].end(), 'n', 'A');
+	valid[j] = check_and_normalize_read(seqs[j]);
+
+	// median < cutoff; once one mate is kept, so is the other.
+	if (valid[j] && !keep[u] && cutoff &&
+	    !median_exceeds(seqs[j], cutoff - 1)) {
+	  keep[u] = 1;
+	}
+      }
+
+      if (keep[u]) {
+	for (unsigned int j = 0; j < n; j++) {
+	  if (valid[j]) {
+	    consume_string(seqs[j]);
+	  }
+	}
+      }
+    }
+
+    for (long long u = 0; u < n_units; u++) {
+      if (!keep[u]) {
+	continue;
+      }
+      for (unsigned int i = unit_starts[u]; i < unit_starts[u + 1]; i++) {
+	outfile << ">" << batch[i].name << "\n" << batch[i].sequence << "\n";
+	n_kept++;
+      }
+    }
+    n_total += batch.size();
+
+    if (callback) {
+      try {
+	callback("normalize_by_median", callback_data, n_total, n_kept);
+      } catch (...) {
+	delete parser;
+	throw;
+      }
+    }
+  }
+
+  outfile.close();
+  delete parser;
+}
 
 void CountingHash::get_kmer_abund_mean(const std::string &filename,
 				       unsigned long long &total,
@@ -811,33 +1281,90 @@ unsigned int CountingHash::trim_on_abundance(std::string seq,
     return 0;
   }
 
-  KMerIterator kmers(seq.c_str(), _ksize);
-
-  SeenSet path;
+  _ReadScratch &scratch = _thread_scratch();
+  std::vector<HashIntoType> &kmers = scratch.kmers;
+  std::vector<BoundedCounterType> &counts = scratch.counts;
 
-  HashIntoType kmer;
+  get_kmer_hashes(seq, kmers);
+  if (kmers.size() < 2) { return 0; }
 
-  if (kmers.done()) { return 0; }
-  kmer = kmers.next();
+  counts.resize(kmers.size());
+  get_counts(&kmers[0], kmers.size(), &counts[0]);
 
-  if (kmers.done() || get_count(kmer) < min_abund) {
+  if (counts[0] < min_abund) {
     return 0;
   }
 
-  unsigned int i = _ksize;
-  while (!kmers.done()) {
-    kmer = kmers.next();
-
-    if (get_count(kmer) < min_abund) {
-      return i;
+  for (unsigned int i = 1; i < counts.size(); i++) {
+    if (counts[i] < min_abund) {
+      return _ksize + i - 1;
     }
-    i++;
   }
 
   return seq.length();
 }
 
 
+//
+// The _many queries: one answer per read, in read order, with the reads
+// split over the configured number of threads.
+//
+
+void CountingHash::get_median_count_many(const std::vector<std::string> &seqs,
+					 std::vector<BoundedCounterType> &medians,
+					 std::vector<float> &averages,
+					 std::vector<float> &stddevs)
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+  long long n = seqs.size();
+
+  medians.assign(n, 0);
+  averages.assign(n, 0);
+  stddevs.assign(n, 0);
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic, 64 )
+  for (long long i = 0; i < n; i++) {
+    if (seqs[i].length() >= _ksize) {
+      get_median_count(seqs[i], medians[i], averages[i], stddevs[i]);
+    }
+  }
+}
+
+void CountingHash::get_min_count_many(const std::vector<std::string> &seqs,
+				      std::vector<BoundedCounterType> &mins)
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+  long long n = seqs.size();
+
+  mins.assign(n, 0);
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic, 64 )
+  for (long long i = 0; i < n; i++) {
+    if (seqs[i].length() >= _ksize) {
+      mins[i] = get_min_count(seqs[i]);
+    }
+  }
+}
+
+void CountingHash::trim_on_abundance_many(const std::vector<std::string> &seqs,
+					  BoundedCounterType min_abund,
+					  std::vector<unsigned int> &trim_at)
+  const
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+  long long n = seqs.size();
+
+  trim_at.assign(n, 0);
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic, 64 )
+  for (long long i = 0; i < n; i++) {
+    trim_at[i] = trim_on_abundance(seqs[i], min_abund);
+  }
+}
+
 unsigned int CountingHash::trim_below_abundance(std::string seq,
 						BoundedCounterType max_abund)
   const
@@ -846,27 +1373,23 @@ unsigned int CountingHash::trim_below_abundance(std::string seq,
     return 0;
   }
 
-  KMerIterator kmers(seq.c_str(), _ksize);
-
-  SeenSet path;
+  std::vector<HashIntoType> kmers;
+  std::vector<BoundedCounterType> counts;
 
-  HashIntoType kmer;
+  get_kmer_hashes(seq, kmers);
+  if (kmers.size() < 2) { return 0; }
 
-  if (kmers.done()) { return 0; }
-  kmer = kmers.next();
+  counts.resize(kmers.size());
+  get_counts(&kmers[0], kmers.size(), &counts[0]);
 
-  if (kmers.done() || get_count(kmer) > max_abund) {
+  if (counts[0] > max_abund) {
     return 0;
   }
 
-  unsigned int i = _ksize;
-  while (!kmers.done()) {
-    kmer = kmers.next();
-
-    if (get_count(kmer) > max_abund) {
-      return i;
+  for (unsigned int i = 1; i < counts.size(); i++) {
+    if (counts[i] > max_abund) {
+      return _ksize + i - 1;
     }
-    i++;
   }
 
   return seq.length();
@@ -879,7 +1402,10 @@ void CountingHashFile::load(const std::string &infilename, CountingHash &ht)
    int found = filename.find_last_of(".");
    std::string type = filename.substr(found+1);
 
-   if (type == "gz") { CountingHashGzFileReader(filename, ht); }
+   if (get_saved_ht_type(filename) == SAVED_SPARSE_COUNTING_HT) {
+     CountingHashSparseFileReader(filename, ht);
+   }
+   else if (type == "gz") { CountingHashGzFileReader(filename, ht); }
    else { CountingHashFileReader(filename, ht); }
 }
 
@@ -897,12 +1423,7 @@ void CountingHashFile::save(const std::string &outfilename, const CountingHash &
 
 CountingHashFileReader::CountingHashFileReader(const std::string &infilename, CountingHash &ht)
 {
-  if (ht._counts) {
-    for (unsigned int i = 0; i < ht._n_tables; i++) {
-      delete ht._counts[i]; ht._counts[i] = NULL;
-    }
-    delete ht._counts; ht._counts = NULL;
-  }
+  ht._free_tables();
   ht._tablesizes.clear();
   
   unsigned int save_ksize = 0;
@@ -915,7 +1436,8 @@ CountingHashFileReader::CountingHashFileReader(const std::string &infilename, Co
 
   infile.read((char *) &version, 1);
   infile.read((char *) &ht_type, 1);
-  assert(version == SAVED_FORMAT_VERSION);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
   assert(ht_type == SAVED_COUNTING_HT);
 
   infile.read((char *) &use_bigcount, 1);
@@ -926,6 +1448,18 @@ CountingHashFileReader::CountingHashFileReader(const std::string &infilename, Co
   ht._n_tables = (unsigned int) save_n_tables;
   ht._init_bitstuff();
 
+  // per-table hash seeds appear as of format version 4.
+  ht._tableseeds.clear();
+  if (version >= 4) {
+    unsigned char hash_seeded = 0;
+    infile.read((char *) &hash_seeded, 1);
+    if (hash_seeded) {
+      ht._tableseeds.resize(ht._n_tables);
+      infile.read((char *) &ht._tableseeds[0],
+		  sizeof(HashIntoType) * ht._n_tables);
+    }
+  }
+
   ht._use_bigcount = use_bigcount;
 
   ht._counts = new Byte*[ht._n_tables];
@@ -946,20 +1480,16 @@ CountingHashFileReader::CountingHashFileReader(const std::string &infilename, Co
     }
   }
 
+  init_table_moduli(ht._tablesizes, ht._tablemods);
+
   HashIntoType n_counts = 0;
   infile.read((char *) &n_counts, sizeof(n_counts));
 
+  ht._bigcounts.clear();
   if (n_counts) {
-    ht._bigcounts.clear();
-
-    HashIntoType kmer;
-    BoundedCounterType count;
-
-    for (HashIntoType n = 0; n < n_counts; n++) {
-      infile.read((char *) &kmer, sizeof(kmer));
-      infile.read((char *) &count, sizeof(count));
-      ht._bigcounts[kmer] = count;
-    }
+    std::vector<char> records(n_counts * BIGCOUNT_RECORD_SIZE);
+    infile.read(&records[0], records.size());
+    ht._bigcounts.set_records(&records[0], n_counts);
   }
 
   infile.close();
@@ -967,12 +1497,7 @@ CountingHashFileReader::CountingHashFileReader(const std::string &infilename, Co
 
 CountingHashGzFileReader::CountingHashGzFileReader(const std::string &infilename, CountingHash &ht)
 {
-  if (ht._counts) {
-    for (unsigned int i = 0; i < ht._n_tables; i++) {
-      delete ht._counts[i]; ht._counts[i] = NULL;
-    }
-    delete ht._counts; ht._counts = NULL;
-  }
+  ht._free_tables();
   ht._tablesizes.clear();
   
   unsigned int save_ksize = 0;
@@ -980,57 +1505,63 @@ CountingHashGzFileReader::CountingHashGzFileReader(const std::string &infilename
   unsigned long long save_tablesize = 0;
   unsigned char version, ht_type, use_bigcount;
 
-  gzFile infile = gzopen(infilename.c_str(), "rb");
+  TableFileReader infile(infilename);
 
-  gzread(infile, (char *) &version, 1);
-  gzread(infile, (char *) &ht_type, 1);
-  assert(version == SAVED_FORMAT_VERSION);
+  infile.read(&version, 1);
+  infile.read(&ht_type, 1);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
   assert(ht_type == SAVED_COUNTING_HT);
 
-  gzread(infile, (char *) &use_bigcount, 1);
-  gzread(infile, (char *) &save_ksize, sizeof(save_ksize));
-  gzread(infile, (char *) &save_n_tables, sizeof(save_n_tables));
+  infile.read(&use_bigcount, 1);
+  infile.read(&save_ksize, sizeof(save_ksize));
+  infile.read(&save_n_tables, sizeof(save_n_tables));
 
   ht._ksize = (WordLength) save_ksize;
   ht._n_tables = (unsigned int) save_n_tables;
   ht._init_bitstuff();
 
+  // per-table hash seeds appear as of format version 4.
+  ht._tableseeds.clear();
+  if (version >= 4) {
+    unsigned char hash_seeded = 0;
+    infile.read(&hash_seeded, 1);
+    if (hash_seeded) {
+      ht._tableseeds.resize(ht._n_tables);
+      infile.read(&ht._tableseeds[0],
+		  sizeof(HashIntoType) * ht._n_tables);
+    }
+  }
+
   ht._use_bigcount = use_bigcount;
 
-  ht._counts = new Byte*[ht._n_tables];
+  ht._counts = new Byte*[ht._n_tables]();
   for (unsigned int i = 0; i < ht._n_tables; i++) {
     HashIntoType tablesize;
 
-    gzread(infile, (char *) &save_tablesize, sizeof(save_tablesize));
+    infile.read(&save_tablesize, sizeof(save_tablesize));
 
     tablesize = (HashIntoType) save_tablesize;
     ht._tablesizes.push_back(tablesize);
 
     ht._counts[i] = new Byte[tablesize];
 
-    unsigned long long loaded = 0;
-    while (loaded != tablesize) {
-      loaded += gzread(infile, (char *) ht._counts[i], tablesize - loaded);
-    }
+    infile.read(ht._counts[i], tablesize);
   }
 
+  init_table_moduli(ht._tablesizes, ht._tablemods);
+
   HashIntoType n_counts = 0;
-  gzread(infile, (char *) &n_counts, sizeof(n_counts));
+  infile.read(&n_counts, sizeof(n_counts));
 
+  ht._bigcounts.clear();
   if (n_counts) {
-    ht._bigcounts.clear();
-
-    HashIntoType kmer;
-    BoundedCounterType count;
-
-    for (HashIntoType n = 0; n < n_counts; n++) {
-      gzread(infile, (char *) &kmer, sizeof(kmer));
-      gzread(infile, (char *) &count, sizeof(count));
-      ht._bigcounts[kmer] = count;
-    }
+    std::vector<char> records(n_counts * BIGCOUNT_RECORD_SIZE);
+    infile.read(&records[0], records.size());
+    ht._bigcounts.set_records(&records[0], n_counts);
   }
 
-  gzclose(infile);
+  infile.close();
 }
 
 CountingHashFileWriter::CountingHashFileWriter(const std::string &outfilename, const CountingHash &ht)
@@ -1058,6 +1589,13 @@ CountingHashFileWriter::CountingHashFileWriter(const std::string &outfilename, c
   outfile.write((const char *) &save_ksize, sizeof(save_ksize));
   outfile.write((const char *) &save_n_tables, sizeof(save_n_tables));
 
+  unsigned char hash_seeded = ht._tableseeds.size() ? 1 : 0;
+  outfile.write((const char *) &hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write((const char *) &ht._tableseeds[0],
+		  sizeof(HashIntoType) * save_n_tables);
+  }
+
   for (unsigned int i = 0; i < save_n_tables; i++) {
     save_tablesize = ht._tablesizes[i];
 
@@ -1065,19 +1603,19 @@ CountingHashFileWriter::CountingHashFileWriter(const std::string &outfilename, c
     outfile.write((const char *) ht._counts[i], save_tablesize);
   }
 
-  HashIntoType n_counts = ht._bigcounts.size();
+  std::vector<char> records;
+  HashIntoType n_counts = ht._bigcounts.get_records(records);
   outfile.write((const char *) &n_counts, sizeof(n_counts));
 
   if (n_counts) {
-    KmerCountMap::const_iterator it = ht._bigcounts.begin();
-    
-    for (; it != ht._bigcounts.end(); it++) {
-      outfile.write((const char *) &it->first, sizeof(it->first));
-      outfile.write((const char *) &it->second, sizeof(it->second));
-    }
+    outfile.write((const char *) &records[0], records.size());
   }
 
   outfile.close();
+
+  if (outfile.fail()) {
+    throw TableFileWriteError();
+  }
 }
 
 CountingHashGzFileWriter::CountingHashGzFileWriter(const std::string &outfilename, const CountingHash &ht)
@@ -1088,43 +1626,158 @@ CountingHashGzFileWriter::CountingHashGzFileWriter(const std::string &outfilenam
   unsigned char save_n_tables = ht._n_tables;
   unsigned long long save_tablesize;
 
-  gzFile outfile = gzopen(outfilename.c_str(), "wb");
+  TableFileWriter outfile(outfilename);
 
   unsigned char version = SAVED_FORMAT_VERSION;
-  gzwrite(outfile, (const char *) &version, 1);
+  outfile.write(&version, 1);
 
   unsigned char ht_type = SAVED_COUNTING_HT;
-  gzwrite(outfile, (const char *) &ht_type, 1);
+  outfile.write(&ht_type, 1);
 
   unsigned char use_bigcount = 0;
   if (ht._use_bigcount) {
     use_bigcount = 1;
   }
-  gzwrite(outfile, (const char *) &use_bigcount, 1);
+  outfile.write(&use_bigcount, 1);
 
-  gzwrite(outfile, (const char *) &save_ksize, sizeof(save_ksize));
-  gzwrite(outfile, (const char *) &save_n_tables, sizeof(save_n_tables));
+  outfile.write(&save_ksize, sizeof(save_ksize));
+  outfile.write(&save_n_tables, sizeof(save_n_tables));
+
+  unsigned char hash_seeded = ht._tableseeds.size() ? 1 : 0;
+  outfile.write(&hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write(&ht._tableseeds[0],
+		  sizeof(HashIntoType) * save_n_tables);
+  }
 
   for (unsigned int i = 0; i < save_n_tables; i++) {
     save_tablesize = ht._tablesizes[i];
 
-    gzwrite(outfile, (const char *) &save_tablesize, sizeof(save_tablesize));
-    gzwrite(outfile, (const char *) ht._counts[i], save_tablesize);
+    outfile.write(&save_tablesize, sizeof(save_tablesize));
+    outfile.write(ht._counts[i], save_tablesize);
   }
 
-  HashIntoType n_counts = ht._bigcounts.size();
-  gzwrite(outfile, (const char *) &n_counts, sizeof(n_counts));
+  std::vector<char> records;
+  HashIntoType n_counts = ht._bigcounts.get_records(records);
+  outfile.write(&n_counts, sizeof(n_counts));
 
   if (n_counts) {
-    KmerCountMap::const_iterator it = ht._bigcounts.begin();
-    
-    for (; it != ht._bigcounts.end(); it++) {
-      gzwrite(outfile, (const char *) &it->first, sizeof(it->first));
-      gzwrite(outfile, (const char *) &it->second, sizeof(it->second));
-    }
+    outfile.write(&records[0], records.size());
   }
 
-  gzclose(outfile);
+  outfile.close();
+}
+
+//
+// Sparse counting tables are laid out as the others, but for their type,
+// SAVED_SPARSE_COUNTING_HT, and for each table being saved as
+// write_sparse_table writes it.
+//
+
+CountingHashSparseFileWriter::CountingHashSparseFileWriter(const std::string &outfilename, const CountingHash &ht)
+{
+  assert(ht._counts[0]);
+
+  unsigned int save_ksize = ht._ksize;
+  unsigned char save_n_tables = ht._n_tables;
+  unsigned long long save_tablesize;
+
+  TableFileWriter outfile(outfilename);
+
+  unsigned char version = SAVED_FORMAT_VERSION;
+  outfile.write(&version, 1);
+
+  unsigned char ht_type = SAVED_SPARSE_COUNTING_HT;
+  outfile.write(&ht_type, 1);
+
+  unsigned char use_bigcount = ht._use_bigcount ? 1 : 0;
+  outfile.write(&use_bigcount, 1);
+
+  outfile.write(&save_ksize, sizeof(save_ksize));
+  outfile.write(&save_n_tables, sizeof(save_n_tables));
+
+  unsigned char hash_seeded = ht._tableseeds.size() ? 1 : 0;
+  outfile.write(&hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write(&ht._tableseeds[0],
+		  sizeof(HashIntoType) * save_n_tables);
+  }
+
+  for (unsigned int i = 0; i < save_n_tables; i++) {
+    save_tablesize = ht._tablesizes[i];
+
+    outfile.write(&save_tablesize, sizeof(save_tablesize));
+    write_sparse_table(outfile, ht._counts[i], save_tablesize);
+  }
+
+  std::vector<char> records;
+  HashIntoType n_counts = ht._bigcounts.get_records(records);
+  outfile.write(&n_counts, sizeof(n_counts));
+
+  if (n_counts) {
+    outfile.write(&records[0], records.size());
+  }
+
+  outfile.close();
+}
+
+CountingHashSparseFileReader::CountingHashSparseFileReader(const std::string &infilename, CountingHash &ht)
+{
+  ht._free_tables();
+  ht._tablesizes.clear();
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  unsigned long long save_tablesize = 0;
+  unsigned char version, ht_type, use_bigcount;
+
+  TableFileReader infile(infilename);
+
+  infile.read(&version, 1);
+  infile.read(&ht_type, 1);
+  assert(version == SAVED_FORMAT_VERSION);
+  assert(ht_type == SAVED_SPARSE_COUNTING_HT);
+
+  infile.read(&use_bigcount, 1);
+  infile.read(&save_ksize, sizeof(save_ksize));
+  infile.read(&save_n_tables, sizeof(save_n_tables));
+
+  ht._ksize = (WordLength) save_ksize;
+  ht._n_tables = (unsigned int) save_n_tables;
+  ht._init_bitstuff();
+
+  ht._tableseeds.clear();
+  unsigned char hash_seeded = 0;
+  infile.read(&hash_seeded, 1);
+  if (hash_seeded) {
+    ht._tableseeds.resize(ht._n_tables);
+    infile.read(&ht._tableseeds[0], sizeof(HashIntoType) * ht._n_tables);
+  }
+
+  ht._use_bigcount = use_bigcount;
+
+  ht._counts = new Byte*[ht._n_tables]();
+  for (unsigned int i = 0; i < ht._n_tables; i++) {
+    infile.read(&save_tablesize, sizeof(save_tablesize));
+    ht._tablesizes.push_back((HashIntoType) save_tablesize);
+
+    ht._counts[i] = new Byte[save_tablesize];
+    read_sparse_table(infile, ht._counts[i], save_tablesize);
+  }
+
+  init_table_moduli(ht._tablesizes, ht._tablemods);
+
+  HashIntoType n_counts = 0;
+  infile.read(&n_counts, sizeof(n_counts));
+
+  ht._bigcounts.clear();
+  if (n_counts) {
+    std::vector<char> records(n_counts * BIGCOUNT_RECORD_SIZE);
+    infile.read(&records[0], records.size());
+    ht._bigcounts.set_records(&records[0], n_counts);
+  }
+
+  infile.close();
 }
 
 void CountingHash::collect_high_abundance_kmers(const std::string &filename,
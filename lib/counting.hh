@@ -4,17 +4,37 @@
 #include <vector>
 #include "khmer_config.hh"
 #include "hashtable.hh"
+#include "fastmod.hh"
 #include "hashbits.hh"
+#include "bigcount_map.hh"
+#include "mapped_file.hh"
 
-namespace khmer {
-  typedef std::map<HashIntoType, BoundedCounterType> KmerCountMap;
+// the number of reads normalize_by_median tests at a time; the reads of
+// a batch are tested against the counts as of the start of the batch,
+// give or take what the other threads have counted so far.
+#define NORMALIZE_BATCH_SIZE 10000
+
+// the number of k-mers median_exceeds looks up at a time, between checks
+// for whether the answer is known.
+#define MEDIAN_PROBE_BATCH_SIZE 16
+
+// the number of locks abundance_distribution's workers share out the
+// k-mers over, to test and set their tracking bits one at a time.
+#define ABUNDANCE_CLAIM_LOCKS 4096
+
+// the number of locks threaded conservative updates share out the k-mers
+// over.
+#define CONSERVATIVE_UPDATE_LOCKS 4096
 
+namespace khmer {
   class CountingHashIntersect;
   class CountingHashFile;
   class CountingHashFileReader;
   class CountingHashFileWriter;
   class CountingHashGzFileReader;
   class CountingHashGzFileWriter;
+  class CountingHashSparseFileReader;
+  class CountingHashSparseFileWriter;
 
   class CountingHash : public khmer::Hashtable {
     friend class CountingHashIntersect;
@@ -23,16 +43,40 @@ namespace khmer {
     friend class CountingHashFileWriter;
     friend class CountingHashGzFileReader;
     friend class CountingHashGzFileWriter;
+    friend class CountingHashSparseFileReader;
+    friend class CountingHashSparseFileWriter;
 
   protected:
     bool _use_bigcount;		// keep track of counts > Bloom filter hash count threshold?
+    bool _use_conservative;	// raise only the minimal counters on count?
     std::vector<HashIntoType> _tablesizes;
+    TableModulusList _tablemods;	// reciprocals of _tablesizes
+    std::vector<HashIntoType> _tableseeds; // per-table hash seeds, if any
     unsigned int _n_tables;
 
     Byte ** _counts;
 
+    // the file the tables are mapped from, if they were load_mapped.
+    MappedFile * _mapping;
+
+    // Saturation thresholds, captured from the active config.
+    HashCountThresholds _thresholds;
+
+    virtual void _init_thresholds() {
+      _thresholds = get_active_config( ).get_hash_count_thresholds( );
+    }
+
+    // the bin of the given k-mer hash in table i.
+    HashIntoType _bin(HashIntoType khash, unsigned int i) const {
+      if (_tableseeds.size()) {
+	khash = _seeded_hash(khash, _tableseeds[i]);
+      }
+      return _tablemods[i].reduce(khash);
+    }
+
     virtual void _allocate_counters() {
       _n_tables = _tablesizes.size();
+      init_table_moduli(_tablesizes, _tablemods);
 
       _counts = new Byte*[_n_tables];
       for (unsigned int i = 0; i < _n_tables; i++) {
@@ -40,26 +84,174 @@ namespace khmer {
 	memset(_counts[i], 0, _tablesizes[i]);
       }
     }
+
+    // for subclasses which lay out their own counters in place of _counts.
+    CountingHash(WordLength ksize, std::vector<HashIntoType>& tablesizes,
+		 bool allocate) :
+      khmer::Hashtable(ksize), _use_bigcount(false), _use_conservative(false), _tablesizes(tablesizes) {
+      _n_tables = _tablesizes.size();
+      _counts = NULL;
+      _mapping = NULL;
+
+      _init_thresholds();
+      if (allocate) {
+	_allocate_counters();
+      }
+    }
+
+    // bump the big count for a k-mer whose counters are all saturated.
+    void _count_big(HashIntoType khash) {
+      if (_thresholds.max_count >= _thresholds.max_bigcount) {
+	return;			// the counters already count this far.
+      }
+      _bigcounts.increment(khash, _thresholds.max_count + 1,
+			   _thresholds.max_bigcount);
+    }
+
+    // add one to a counter, unless it is at max_count; returns false if
+    // it was. Threads never take it past max_count, which would wrap it
+    // when that is 255.
+    static bool _bump_counter(Byte * counter, Byte max_count) {
+#ifdef KHMER_THREADED
+      Byte old = *counter;
+      while (old < max_count) {
+	Byte seen = __sync_val_compare_and_swap(counter, old, old + 1);
+	if (seen == old) {
+	  return true;
+	}
+	old = seen;
+      }
+      return false;
+#else
+      if (*counter < max_count) {
+	*counter += 1;
+	return true;
+      }
+      return false;
+#endif
+    }
+
+    // raise a counter to target, unless it is already there.
+    static void _raise_counter(Byte * counter, Byte target) {
+#ifdef KHMER_THREADED
+      Byte old = *counter;
+      while (old < target) {
+	Byte seen = __sync_val_compare_and_swap(counter, old, target);
+	if (seen == old) {
+	  break;
+	}
+	old = seen;
+      }
+#else
+      if (*counter < target) {
+	*counter = target;
+      }
+#endif
+    }
+
+    // When threaded, conservative updates of a k-mer take turns, with a
+    // lock per stripe of k-mers: two threads counting the same k-mer at
+    // once would otherwise both read the same minimum, and raise it just
+    // once between them. Other k-mers' raises to shared counters only
+    // ever add to them, so those need no lock.
+    std::vector<unsigned int> _update_locks;
+
+    void _lock_update(HashIntoType khash) {
+#ifdef KHMER_THREADED
+      unsigned int * lock = &_update_locks[khash % _update_locks.size()];
+      while (__sync_lock_test_and_set(lock, 1)) ;
+#endif
+    }
+
+    void _unlock_update(HashIntoType khash) {
+#ifdef KHMER_THREADED
+      __sync_lock_release(&_update_locks[khash % _update_locks.size()]);
+#endif
+    }
+
+    // conservative update: raise only the counters at the minimum, to
+    // one more than it; the rest already count the k-mer at least that
+    // many times. Never spills over max_count, even when threaded.
+    void _count_conservative(HashIntoType khash) {
+      unsigned int  max_count	  = _thresholds.max_count;
+      unsigned int  min_count	  = max_count;
+
+      _lock_update(khash);
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	unsigned int the_count = _counts[i][_bin(khash, i)];
+	if (the_count < min_count) {
+	  min_count = the_count;
+	}
+      }
+
+      if (min_count >= max_count) {
+	_unlock_update(khash);
+	if (_use_bigcount) {
+	  _count_big(khash);
+	}
+	return;
+      }
+
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	_raise_counter(_counts[i] + _bin(khash, i), min_count + 1);
+      }
+      _unlock_update(khash);
+    }
+
+    // add the counts of the table's counters to dist, skipping the empty
+    // ones; see bin_abundance_distribution.
+    virtual void _add_counter_distribution(HashIntoType * dist) const;
+
+    // the big count for a k-mer whose counters are all saturated.
+    BoundedCounterType _get_big_count(HashIntoType khash,
+				      BoundedCounterType min_count) const {
+      BoundedCounterType big_count = _bigcounts.get(khash);
+      return big_count ? big_count : min_count;
+    }
+
+    // look up the count of every k-mer in s, reusing the given buffers.
+    void _get_scratch_counts(const std::string &s,
+			     std::vector<HashIntoType> &kmers,
+			     std::vector<BoundedCounterType> &counts) const;
+
+    // a copy of the tables and big counts, for a checkpoint.
+    virtual Hashtable * _snapshot() const;
+
+    // whether the counters are in _counts, a byte each, as save_sparse,
+    // load_mapped and merge need them to be.
+    virtual bool _has_plain_counters() const { return true; }
+
   public:
-    KmerCountMap _bigcounts;
+    BigCountMap _bigcounts;
 
     CountingHash(WordLength ksize, HashIntoType single_tablesize) :
-      khmer::Hashtable(ksize), _use_bigcount(false) {
+      khmer::Hashtable(ksize), _use_bigcount(false), _use_conservative(false),
+      _mapping(NULL) {
       _tablesizes.push_back(single_tablesize);
       
+      _init_thresholds();
       _allocate_counters();
     }
 
     CountingHash(WordLength ksize, std::vector<HashIntoType>& tablesizes) :
-      khmer::Hashtable(ksize), _use_bigcount(false), _tablesizes(tablesizes) {
+      khmer::Hashtable(ksize), _use_bigcount(false), _use_conservative(false), _tablesizes(tablesizes),
+      _mapping(NULL) {
 
+      _init_thresholds();
       _allocate_counters();
     }
 
     virtual ~CountingHash() {
+      _free_tables();
+    }
+
+    // free the tables, or unmap them.
+    void _free_tables() {
       if (_counts) {
 	for (unsigned int i = 0; i < _n_tables; i++) {
-	  delete _counts[i];
+	  if (!_mapping) {
+	    delete _counts[i];
+	  }
 	  _counts[i] = NULL;
 	}
 
@@ -68,18 +260,84 @@ namespace khmer {
 
 	_n_tables = 0;
       }
+
+      delete _mapping;
+      _mapping = NULL;
     }
 
     std::vector<HashIntoType> get_tablesizes() const {
       return _tablesizes;
     }
 
+    // Opt in to an independent seeded hash function per table, derived
+    // from the given seed; a seed of 0 reverts to indexing every table
+    // by the k-mer hash itself. Must be set before anything is counted.
+    void set_hash_seed(HashIntoType seed) {
+      if (seed) {
+	_make_table_seeds(seed, _n_tables, _tableseeds);
+      } else {
+	_tableseeds.clear();
+      }
+    }
+
+    std::vector<HashIntoType> get_table_seeds() const {
+      return _tableseeds;
+    }
+
+    // Re-capture the saturation thresholds from the active config.
+    // Call this after changing the number of threads on the config.
+    void reconfigure() { _init_thresholds(); }
+
     void set_use_bigcount(bool b) { _use_bigcount = b; }
     bool get_use_bigcount() { return _use_bigcount; }
 
+    // Conservative update overestimates far less, so the tables can be
+    // smaller for the same accuracy. It is not saved with the table.
+    void set_use_conservative(bool b) {
+      _use_conservative = b;
+#ifdef KHMER_THREADED
+      if (b && _update_locks.empty()) {
+	_update_locks.assign(CONSERVATIVE_UPDATE_LOCKS, 0);
+      }
+#endif
+    }
+    bool get_use_conservative() { return _use_conservative; }
+
     virtual void save(std::string);
     virtual void load(std::string);
 
+    // Save in the sparse format (see sparse_encode_table), which load
+    // reads back; gzipped, too, if the filename ends in .gz. Only for
+    // CountingHash itself, as load_mapped; the others throw
+    // UnsupportedTableLayout.
+    void save_sparse(std::string);
+
+    // Load an uncompressed saved CountingHash by memory-mapping the file,
+    // with the tables used in place: see MappedFile for shared and
+    // populate. Only for CountingHash itself; the blocked and packed
+    // tables lay out their own counters, load with load(), and throw
+    // UnsupportedTableLayout here.
+    void load_mapped(std::string infilename, bool shared = false,
+		     bool populate = false);
+
+    bool is_mapped() const { return _mapping != NULL; }
+
+    // whether merge can add the other table into this one: the same k,
+    // table sizes and seeds, and the same max_count and max_bigcount,
+    // which depend on the number of threads a table is made with, so
+    // that no count means "saturated" in one table and not the other.
+    // Never, for the blocked or packed tables.
+    bool can_merge(const CountingHash &other) const;
+
+    // Add the counts of the other table into this one, saturating at
+    // max_count; k-mers with a big count in either table get one for the
+    // sum. Counts which only saturate in the merge are capped, as with
+    // count, since there is no telling which k-mers they belong to.
+    // Note: Merges a chunk of the tables per thread at a time. Only for
+    //	     CountingHash itself, as load_mapped; either table being blocked
+    //	     or packed throws UnsupportedTableLayout.
+    void merge(const CountingHash &other);
+
     // accessors to get table info
     const HashIntoType n_entries() const { return _tablesizes[0]; }
 
@@ -102,45 +360,47 @@ namespace khmer {
     }
 
     virtual void count(HashIntoType khash) {
+      if (_use_conservative) {
+	_count_conservative(khash);
+	return;
+      }
+
       unsigned int  n_full	  = 0;
-      Config	    config	  = get_active_config( );
-      unsigned int  max_count	  = config.get_hash_count_threshold( );
-      unsigned int  max_bigcount  = config.get_hash_bigcount_threshold( );
+      unsigned int  max_count	  = _thresholds.max_count;
 //#pragma omp critical (update_counts)
       for (unsigned int i = 0; i < _n_tables; i++) {
-	const HashIntoType bin = khash % _tablesizes[i];
-#ifdef KHMER_THREADED
-	// NOTE: Technically, multiple threads can cause the bin to spill 
-	//	 over max_count a little, if they all read it as less than 
-	//	 max_count before any of them increment it.
-	//	 However, do we actually care if there is a little 
-	//	 bit of slop here? It can always be trimmed off later, if 
-	//	 that would help with stats.
-	if ( max_count > _counts[ i ][ bin ] )
-	  __sync_add_and_fetch( *(_counts + i) + bin, 1 );
-	else
-	  n_full++;
-#else
-	if (_counts[i][bin] < max_count) {
-	  _counts[i][bin] += 1;
-	} else {
+	if (!_bump_counter(_counts[i] + _bin(khash, i), max_count)) {
 	  n_full++;
 	}
-#endif
       } // for each table
 
       if (n_full == _n_tables && _use_bigcount) {
-#pragma omp critical (update_bigcounts)
-	if (_bigcounts[khash] == 0) {
-	  _bigcounts[khash] = max_count + 1;
-	} else {
-	  if (_bigcounts[khash] < max_bigcount) {
-	    _bigcounts[khash] += 1;
-	  }
-	}
+	_count_big(khash);
+      }
+    }
+
+    // prefetch the bins for the given k-mer hash, in every table.
+    void prefetch_bins(HashIntoType khash) const {
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	__builtin_prefetch(_counts[i] + _bin(khash, i), 1, 1);
       }
     }
 
+    virtual void count_many(const HashIntoType * khashes, unsigned int n) {
+      _count_many_static(*this, khashes, n);
+    }
+
+    virtual void get_counts(const HashIntoType * khashes, unsigned int n,
+			    BoundedCounterType * counts) const {
+      _get_counts_static(*this, khashes, n, counts);
+    }
+
+    // the count in counter i of the first table, for walking the table
+    // directly.
+    BoundedCounterType counter_at(HashIntoType i) const {
+      return _counts[0][i];
+    }
+
     // get the count for the given k-mer.
     virtual const BoundedCounterType get_count(const char * kmer) const {
       HashIntoType hash = _hash(kmer, _ksize);
@@ -149,20 +409,16 @@ namespace khmer {
 
     // get the count for the given k-mer hash.
     virtual const BoundedCounterType get_count(HashIntoType khash) const {
-      Config		  config	= get_active_config( );
-      unsigned int	  max_count	= config.get_hash_count_threshold( );
+      unsigned int	  max_count	= _thresholds.max_count;
       BoundedCounterType  min_count	= max_count;
       for (unsigned int i = 0; i < _n_tables; i++) {
-	BoundedCounterType the_count = _counts[i][khash % _tablesizes[i]];
+	BoundedCounterType the_count = _counts[i][_bin(khash, i)];
 	if (the_count < min_count) {
 	  min_count = the_count;
 	}
       }
       if (min_count == max_count && _use_bigcount) {
-	KmerCountMap::const_iterator it = _bigcounts.find(khash);
-	if (it != _bigcounts.end()) {
-	  min_count = it->second;
-	}
+	min_count = _get_big_count(khash, min_count);
       }
       return min_count;
     }
@@ -223,11 +479,41 @@ namespace khmer {
 			  BoundedCounterType &kadian,
 			  unsigned int nk = 1);
 
+    // whether the median k-mer count of s, as get_median_count, is above
+    // cutoff. Stops looking up counts as soon as the answer is known,
+    // which, for most reads, is about halfway through.
+    bool median_exceeds(const std::string &s,
+			BoundedCounterType cutoff) const;
+
+    // Digital normalization: stream the reads of inputfile, writing each
+    // read whose median k-mer count is below cutoff to outputfile, in
+    // input order, and counting its k-mers; discard the rest. If paired,
+    // the two mates of a pair (named .../1 and .../2, or "... 1:..." and
+    // "... 2:...") are kept or discarded together, kept if either is
+    // below cutoff. An N is taken as an A for the test and the count,
+    // but the read is written out as it was. Reads are tested in
+    // batches, over the configured number of threads. The callback runs
+    // once per batch, in the calling thread.
+    void normalize_by_median(const std::string &inputfile,
+			     const std::string &outputfile,
+			     BoundedCounterType cutoff,
+			     bool paired,
+			     unsigned long long &n_total,
+			     unsigned long long &n_kept,
+			     CallbackFn callback = NULL,
+			     void * callback_data = NULL);
+
     HashIntoType * abundance_distribution(std::string filename,
 					  Hashbits * tracking,
 					  CallbackFn callback = NULL,
 					  void * callback_data = NULL) const;
 
+    // The number of bins holding each count, as an estimate of the
+    // number of distinct k-mers with each count, without reading any
+    // sequence or keeping a tracking table. Collisions make it
+    // approximate; each big count moves one saturated bin to its count.
+    HashIntoType * bin_abundance_distribution() const;
+
     HashIntoType * fasta_count_kmers_by_position(const std::string &inputfile,
 					 const unsigned int max_read_len,
 					 BoundedCounterType limit_by_count=0,
@@ -256,6 +542,21 @@ namespace khmer {
     unsigned int trim_below_abundance(std::string seq,
 				      BoundedCounterType max_abund) const;
 
+    // get_median_count, get_min_count and trim_on_abundance over many
+    // reads in one call, for callers that would otherwise pay a call per
+    // read. Each read's answer goes in the same place in the output; the
+    // reads are split over the configured number of threads. Reads
+    // shorter than the k-mer size get 0s.
+    void get_median_count_many(const std::vector<std::string> &seqs,
+			       std::vector<BoundedCounterType> &medians,
+			       std::vector<float> &averages,
+			       std::vector<float> &stddevs);
+    void get_min_count_many(const std::vector<std::string> &seqs,
+			    std::vector<BoundedCounterType> &mins);
+    void trim_on_abundance_many(const std::vector<std::string> &seqs,
+				BoundedCounterType min_abund,
+				std::vector<unsigned int> &trim_at) const;
+
     void collect_high_abundance_kmers(const std::string &infilename,
 				      unsigned int lower_count,
 				      unsigned int upper_count,
@@ -263,6 +564,35 @@ namespace khmer {
   };
 
 
+  //
+  // Add the counts of a table's first n counters to dist, skipping empty
+  // ones, over the configured number of threads, each with a histogram
+  // of its own. As with the batch kernels, the per-counter call is bound
+  // at compile time.
+  //
+  template<typename Table>
+  inline void _counter_distribution_static(const Table &table,
+					   HashIntoType n,
+					   HashIntoType * dist) {
+    unsigned int number_of_threads =
+      get_active_config( ).get_number_of_threads( );
+
+#pragma omp parallel num_threads( number_of_threads ) default( shared )
+    {
+      std::vector<HashIntoType> thread_dist(MAX_BIGCOUNT + 1, 0);
+
+#pragma omp for schedule( static )
+      for (long long i = 0; i < (long long) n; i++) {
+	thread_dist[table.Table::counter_at(i)]++;
+      }
+
+#pragma omp critical (counter_distribution)
+      for (unsigned int c = 1; c <= MAX_BIGCOUNT; c++) {
+	dist[c] += thread_dist[c];
+      }
+    }
+  }
+
   class CountingHashFile {
   public:
     static void load(const std::string &infilename, CountingHash &ht);
@@ -289,6 +619,16 @@ namespace khmer {
   public:
     CountingHashGzFileWriter(const std::string &outfilename, const CountingHash &ht);
   };
+
+  class CountingHashSparseFileReader : public CountingHashFile {
+  public:
+    CountingHashSparseFileReader(const std::string &infilename, CountingHash &ht);
+  };
+
+  class CountingHashSparseFileWriter : public CountingHashFile {
+  public:
+    CountingHashSparseFileWriter(const std::string &outfilename, const CountingHash &ht);
+  };
 };
 
 #endif // COUNTING_HH
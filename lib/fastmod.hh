@@ -0,0 +1,68 @@
+#ifndef FASTMOD_HH
+#define FASTMOD_HH
+
+#include <vector>
+#include "khmer.hh"
+
+namespace khmer {
+
+  //
+  // TableModulus: a table size, along with its precomputed reciprocal.
+  //
+  // Finding the bin of a k-mer hash with this replaces a 64-bit hardware
+  // divide with a few multiplications (Lemire, Kaser & Kurz, "Faster
+  // Remainder by Direct Computation", 2019). The result is exactly
+  // 'x % size' for every 64-bit 'x' and 'size', so bin placement does
+  // not depend on whether this is in use.
+  //
+
+  class TableModulus {
+  protected:
+    HashIntoType _size;
+#ifdef __SIZEOF_INT128__
+    __uint128_t _reciprocal;
+#endif
+
+  public:
+    TableModulus(HashIntoType size = 1) { set_size(size); }
+
+    void set_size(HashIntoType size) {
+      _size = size;
+#ifdef __SIZEOF_INT128__
+      // ceil(2**128 / size); wraps to 0 when size is 1, which still
+      // gives the right answer (0) below.
+      _reciprocal = (~(__uint128_t)0) / size + 1;
+#endif
+    }
+
+    HashIntoType size() const { return _size; }
+
+    // x % size
+    HashIntoType reduce(HashIntoType x) const {
+#ifdef __SIZEOF_INT128__
+      __uint128_t lowbits = _reciprocal * x;
+      __uint128_t bottom = ((lowbits & ~(HashIntoType)0) * _size) >> 64;
+      __uint128_t top = (lowbits >> 64) * _size;
+
+      return (HashIntoType) ((bottom + top) >> 64);
+#else
+      return x % _size;
+#endif
+    }
+  };
+
+  typedef std::vector<TableModulus> TableModulusList;
+
+  // build the list of moduli for the given table sizes.
+  inline void init_table_moduli(const std::vector<HashIntoType> &tablesizes,
+				TableModulusList &moduli) {
+    moduli.clear();
+    for (unsigned int i = 0; i < tablesizes.size(); i++) {
+      moduli.push_back(TableModulus(tablesizes[i]));
+    }
+  }
+};
+
+#endif // FASTMOD_HH
+
+// vim: set sts=2 sw=2:
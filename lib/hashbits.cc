@@ -3,6 +3,9 @@
 #include "hashbits.hh"
 #include "read_parsers.hh"
 #include "threadedParsers.hh"
+#include "table_io.hh"
+#include "checkpoint.hh"
+#include "table_merge.hh"
 #include <omp.h>
 #define MAX_KEEPER_SIZE int(1e6)
 
@@ -28,6 +31,13 @@ void Hashbits::save(std::string outfilename)
   outfile.write((const char *) &save_ksize, sizeof(save_ksize));
   outfile.write((const char *) &save_n_tables, sizeof(save_n_tables));
 
+  unsigned char hash_seeded = _tableseeds.size() ? 1 : 0;
+  outfile.write((const char *) &hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write((const char *) &_tableseeds[0],
+		  sizeof(HashIntoType) * save_n_tables);
+  }
+
   for (unsigned int i = 0; i < _n_tables; i++) {
     save_tablesize = _tablesizes[i];
     unsigned long long tablebytes = save_tablesize / 8 + 1;
@@ -37,16 +47,20 @@ void Hashbits::save(std::string outfilename)
     outfile.write((const char *) _counts[i], tablebytes);
   }
   outfile.close();
+
+  if (outfile.fail()) {
+    throw TableFileWriteError();
+  }
 }
 
 void Hashbits::load(std::string infilename)
 {
-  if (_counts) {
-    for (unsigned int i = 0; i < _n_tables; i++) {
-      delete _counts[i]; _counts[i] = NULL;
-    }
-    delete _counts; _counts = NULL;
+  if (get_saved_ht_type(infilename) == SAVED_SPARSE_HASHBITS) {
+    _load_sparse(infilename);
+    return;
   }
+
+  _free_tables();
   _tablesizes.clear();
   
   unsigned int save_ksize = 0;
@@ -59,7 +73,8 @@ void Hashbits::load(std::string infilename)
 
   infile.read((char *) &version, 1);
   infile.read((char *) &ht_type, 1);
-  assert(version == SAVED_FORMAT_VERSION);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
   assert(ht_type == SAVED_HASHBITS);
 
   infile.read((char *) &save_ksize, sizeof(save_ksize));
@@ -69,6 +84,18 @@ void Hashbits::load(std::string infilename)
   _n_tables = (unsigned int) save_n_tables;
   _init_bitstuff();
 
+  // per-table hash seeds appear as of format version 4.
+  _tableseeds.clear();
+  if (version >= 4) {
+    unsigned char hash_seeded = 0;
+    infile.read((char *) &hash_seeded, 1);
+    if (hash_seeded) {
+      _tableseeds.resize(_n_tables);
+      infile.read((char *) &_tableseeds[0],
+		  sizeof(HashIntoType) * _n_tables);
+    }
+  }
+
   _counts = new Byte*[_n_tables];
   for (unsigned int i = 0; i < _n_tables; i++) {
     HashIntoType tablesize;
@@ -88,9 +115,179 @@ void Hashbits::load(std::string infilename)
       loaded += infile.gcount();	// do I need to do this loop?
     }
   }
+  init_table_moduli(_tablesizes, _tablemods);
+
+  infile.close();
+}
+
+//
+// Sparse hashbits tables are laid out as the others, but for their type,
+// SAVED_SPARSE_HASHBITS, and for each table being saved as
+// write_sparse_table writes it; gzipped if the filename ends in .gz.
+//
+
+void Hashbits::save_sparse(std::string outfilename)
+{
+  if (!_has_plain_counters()) {
+    throw UnsupportedTableLayout();
+  }
+  assert(_counts[0]);
+
+  TableFileWriter outfile(outfilename);
+
+  unsigned char version = SAVED_FORMAT_VERSION;
+  outfile.write(&version, 1);
+
+  unsigned char ht_type = SAVED_SPARSE_HASHBITS;
+  outfile.write(&ht_type, 1);
+
+  unsigned int save_ksize = _ksize;
+  unsigned char save_n_tables = _n_tables;
+  outfile.write(&save_ksize, sizeof(save_ksize));
+  outfile.write(&save_n_tables, sizeof(save_n_tables));
+
+  unsigned char hash_seeded = _tableseeds.size() ? 1 : 0;
+  outfile.write(&hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write(&_tableseeds[0], sizeof(HashIntoType) * save_n_tables);
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned long long save_tablesize = _tablesizes[i];
+
+    outfile.write(&save_tablesize, sizeof(save_tablesize));
+    write_sparse_table(outfile, _counts[i], save_tablesize / 8 + 1);
+  }
+
+  outfile.close();
+}
+
+void Hashbits::_load_sparse(std::string infilename)
+{
+  _free_tables();
+  _tablesizes.clear();
+
+  TableFileReader infile(infilename);
+
+  unsigned char version, ht_type;
+  infile.read(&version, 1);
+  infile.read(&ht_type, 1);
+  assert(version == SAVED_FORMAT_VERSION);
+  assert(ht_type == SAVED_SPARSE_HASHBITS);
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  infile.read(&save_ksize, sizeof(save_ksize));
+  infile.read(&save_n_tables, sizeof(save_n_tables));
+
+  _ksize = (WordLength) save_ksize;
+  _n_tables = (unsigned int) save_n_tables;
+  _init_bitstuff();
+
+  _tableseeds.clear();
+  unsigned char hash_seeded = 0;
+  infile.read(&hash_seeded, 1);
+  if (hash_seeded) {
+    _tableseeds.resize(_n_tables);
+    infile.read(&_tableseeds[0], sizeof(HashIntoType) * _n_tables);
+  }
+
+  _counts = new Byte*[_n_tables]();
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned long long save_tablesize = 0;
+    infile.read(&save_tablesize, sizeof(save_tablesize));
+    _tablesizes.push_back((HashIntoType) save_tablesize);
+
+    unsigned long long tablebytes = save_tablesize / 8 + 1;
+    _counts[i] = new Byte[tablebytes];
+    read_sparse_table(infile, _counts[i], tablebytes);
+  }
+  init_table_moduli(_tablesizes, _tablemods);
+
   infile.close();
 }
 
+// the layout is as load reads it.
+bool Hashbits::can_merge(const Hashbits &other) const
+{
+  return _has_plain_counters() && other._has_plain_counters() &&
+    _ksize == other._ksize && _tablesizes == other._tablesizes &&
+    _tableseeds == other._tableseeds;
+}
+
+void Hashbits::merge(const Hashbits &other)
+{
+  if (!_has_plain_counters() || !other._has_plain_counters()) {
+    throw UnsupportedTableLayout();
+  }
+  assert(can_merge(other));
+  assert(_counts && other._counts);
+
+  _occupied_bins = 0;
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    HashIntoType tablebytes = _tablesizes[i] / 8 + 1;
+
+    merge_bits(_counts[i], other._counts[i], tablebytes);
+    _occupied_bins += count_set_bits(_counts[i], tablebytes);
+  }
+  _n_unique_kmers += other._n_unique_kmers;
+
+  all_tags.insert(other.all_tags.begin(), other.all_tags.end());
+}
+
+void Hashbits::load_mapped(std::string infilename, bool shared, bool populate)
+{
+  if (!_has_plain_counters()) {
+    throw UnsupportedTableLayout();
+  }
+
+  _free_tables();
+  _tablesizes.clear();
+
+  // the tables point into the mapping, so it goes with them if the load
+  // fails part way.
+  _mapping = new MappedFile(infilename, shared, populate);
+  MappedFile * mapping = _mapping;
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  unsigned long long save_tablesize = 0;
+  unsigned char version, ht_type;
+
+  mapping->read(&version, 1);
+  mapping->read(&ht_type, 1);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
+  assert(ht_type == SAVED_HASHBITS);
+
+  mapping->read(&save_ksize, sizeof(save_ksize));
+  mapping->read(&save_n_tables, sizeof(save_n_tables));
+
+  _ksize = (WordLength) save_ksize;
+  _n_tables = (unsigned int) save_n_tables;
+  _init_bitstuff();
+
+  _tableseeds.clear();
+  if (version >= 4) {
+    unsigned char hash_seeded = 0;
+    mapping->read(&hash_seeded, 1);
+    if (hash_seeded) {
+      _tableseeds.resize(_n_tables);
+      mapping->read(&_tableseeds[0], sizeof(HashIntoType) * _n_tables);
+    }
+  }
+
+  _counts = new Byte*[_n_tables]();
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    mapping->read(&save_tablesize, sizeof(save_tablesize));
+    _tablesizes.push_back((HashIntoType) save_tablesize);
+
+    _counts[i] = (Byte *) mapping->take(save_tablesize / 8 + 1);
+  }
+
+  init_table_moduli(_tablesizes, _tablemods);
+}
+
 //////////////////////////////////////////////////////////////////////
 // graph stuff
 
@@ -206,6 +403,10 @@ void Hashbits::save_tagset(std::string outfilename)
   outfile.close();
 
   delete buf;
+
+  if (outfile.fail()) {
+    throw TableFileWriteError();
+  }
 }
 
 void Hashbits::load_tagset(std::string infilename, bool clear_tags)
@@ -224,7 +425,8 @@ void Hashbits::load_tagset(std::string infilename, bool clear_tags)
 
   infile.read((char *) &version, 1);
   infile.read((char *) &ht_type, 1);
-  assert(version == SAVED_FORMAT_VERSION);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
   assert(ht_type == SAVED_TAGS);
   
   infile.read((char *) &save_ksize, sizeof(save_ksize));
@@ -382,6 +584,95 @@ void Hashbits::consume_fasta_and_tag(const std::string &filename,
 
 }
 
+//
+// consume_fasta_and_tag_checkpointed: as consume_fasta_and_tag, taking a
+//     checkpoint of the tables and tags every so often.
+//
+
+void Hashbits::consume_fasta_and_tag_checkpointed(const std::string &filename,
+				      const std::string &checkpoint_prefix,
+				      unsigned long long checkpoint_interval,
+				      unsigned int &total_reads,
+				      unsigned long long &n_consumed,
+				      CallbackFn callback,
+				      void * callback_data)
+{
+  CheckpointInfo info;
+
+  info.filename = filename;
+  info.tag = true;
+  info.interval = checkpoint_interval;
+
+  _consume_fasta_checkpointed(info, checkpoint_prefix, total_reads,
+			      n_consumed, callback, callback_data);
+}
+
+void Hashbits::_consume_checkpoint_batch(std::vector<read_parsers::Read> &batch,
+					 bool tag,
+					 unsigned long long &n_consumed)
+{
+  if (!tag) {
+    Hashtable::_consume_checkpoint_batch(batch, tag, n_consumed);
+    return;
+  }
+
+  // as in consume_fasta_and_tag, the tags are only thread-safe when
+  // built for threads.
+#ifdef KHMER_THREADED
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+#else
+  unsigned int number_of_threads = 1;
+#endif
+  long long n_reads = batch.size();
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic, 64 )
+  for (long long i = 0; i < n_reads; i++) {
+    if (check_and_normalize_read(batch[i].sequence)) {
+      consume_sequence_and_tag(batch[i].sequence, n_consumed);
+    }
+  }
+}
+
+Hashtable * Hashbits::_snapshot() const
+{
+  std::vector<HashIntoType> tablesizes = _tablesizes;
+  Hashbits * snapshot = new Hashbits(_ksize, tablesizes, false);
+
+  init_table_moduli(snapshot->_tablesizes, snapshot->_tablemods);
+  snapshot->_counts = new Byte*[_n_tables];
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    HashIntoType tablebytes = _tablesizes[i] / 8 + 1;
+
+    snapshot->_counts[i] = new Byte[tablebytes];
+    memcpy(snapshot->_counts[i], _counts[i], tablebytes);
+  }
+
+  snapshot->_tableseeds = _tableseeds;
+  snapshot->_tag_density = _tag_density;
+  snapshot->_occupied_bins = _occupied_bins;
+  snapshot->all_tags = all_tags;
+
+  return snapshot;
+}
+
+bool Hashbits::_save_checkpoint(const std::string &prefix)
+{
+  try {
+    save(prefix + ".ht");
+    save_tagset(prefix + ".tagset");
+  } catch (TableFileWriteError &e) {
+    return false;
+  }
+  return sync_file(prefix + ".ht") && sync_file(prefix + ".tagset");
+}
+
+void Hashbits::_load_checkpoint(const std::string &prefix)
+{
+  load(prefix + ".ht");
+  load_tagset(prefix + ".tagset");
+}
+
 void Hashbits::consume_sequence_and_tag(const std::string& seq,
 					unsigned long long& n_consumed,
 					SeenSet * found_tags)
@@ -1526,7 +1817,8 @@ void Hashbits::load_stop_tags(std::string infilename, bool clear_tags)
 
   infile.read((char *) &version, 1);
   infile.read((char *) &ht_type, 1);
-  assert(version == SAVED_FORMAT_VERSION);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
   assert(ht_type == SAVED_STOPTAGS);
   
   infile.read((char *) &save_ksize, sizeof(save_ksize));
@@ -2026,7 +2318,8 @@ unsigned int Hashbits::consume_string_overlap(const std::string &s,
   while(!kmers.done()) {
     kmer = kmers.next();
   
-    if (!bounded || (kmer >= lower_bound && kmer < upper_bound)) {
+    if (!bounded || (kmer >= lower_bound &&
+		     (!upper_bound || kmer < upper_bound))) {
       count_overlap(kmer,ht2);
       n_consumed++;
     }
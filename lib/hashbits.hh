@@ -3,7 +3,9 @@
 
 #include <vector>
 #include "hashtable.hh"
+#include "fastmod.hh"
 #include "subset.hh"
+#include "mapped_file.hh"
 
 #define next_f(kmer_f, ch) ((((kmer_f) << 2) & bitmask) | (twobit_repr(ch)))
 #define next_r(kmer_r, ch) (((kmer_r) >> 2) | (twobit_comp(ch) << rc_left_shift))
@@ -20,6 +22,8 @@ namespace khmer {
     friend class SubsetPartition;
   protected:
     std::vector<HashIntoType> _tablesizes;
+    TableModulusList _tablemods;	// reciprocals of _tablesizes
+    std::vector<HashIntoType> _tableseeds; // per-table hash seeds, if any
     unsigned int _n_tables;
     unsigned int _tag_density;
     HashIntoType _occupied_bins;
@@ -27,8 +31,20 @@ namespace khmer {
 	HashIntoType _n_overlap_kmers;
     Byte ** _counts;
 
+    // the file the tables are mapped from, if they were load_mapped.
+    MappedFile * _mapping;
+
+    // the bin of the given k-mer hash in table i.
+    HashIntoType _bin(HashIntoType khash, unsigned int i) const {
+      if (_tableseeds.size()) {
+	khash = _seeded_hash(khash, _tableseeds[i]);
+      }
+      return _tablemods[i].reduce(khash);
+    }
+
     virtual void _allocate_counters() {
       _n_tables = _tablesizes.size();
+      init_table_moduli(_tablesizes, _tablemods);
 
       HashIntoType tablebytes;
       HashIntoType tablesize;
@@ -44,6 +60,47 @@ namespace khmer {
       }
     }
             
+    void _load_sparse(std::string);
+
+    // a copy of the tables and tags, for a checkpoint, which saves and
+    // loads the tags with the tables.
+    virtual Hashtable * _snapshot() const;
+    virtual bool _save_checkpoint(const std::string &prefix);
+    virtual void _load_checkpoint(const std::string &prefix);
+
+    // whether the bits are in _counts, as save_sparse, load_mapped and
+    // merge need them to be.
+    virtual bool _has_plain_counters() const { return true; }
+
+    // tag the reads, too, if asked; see consume_fasta_and_tag.
+    virtual void _consume_checkpoint_batch(
+	std::vector<read_parsers:: Read> &batch,
+	bool tag,
+	unsigned long long &n_consumed
+    );
+
+    // for subclasses which lay out their own counters in place of _counts.
+    Hashbits(WordLength ksize, std::vector<HashIntoType>& tablesizes,
+	     bool allocate) :
+      khmer::Hashtable(ksize), _tablesizes(tablesizes) {
+      _init_hashbits();
+      _n_tables = _tablesizes.size();
+      _counts = NULL;
+      if (allocate) {
+	_allocate_counters();
+      }
+    }
+
+    void _init_hashbits() {
+      _mapping = NULL;
+      _tag_density = DEFAULT_TAG_DENSITY;
+      assert(_tag_density % 2 == 0);
+      partition = new SubsetPartition(this);
+      _occupied_bins = 0;
+      _n_unique_kmers = 0;
+      _n_overlap_kmers = 0;
+    }
+
     void _clear_all_partitions() {
       if (partition != NULL) {
 	partition->_clear_all_partitions();
@@ -62,20 +119,23 @@ namespace khmer {
 
     Hashbits(WordLength ksize, std::vector<HashIntoType>& tablesizes) :
       khmer::Hashtable(ksize), _tablesizes(tablesizes) {
-      _tag_density = DEFAULT_TAG_DENSITY;
-      assert(_tag_density % 2 == 0);
-      partition = new SubsetPartition(this);
-      _occupied_bins = 0;
-      _n_unique_kmers = 0;
-	  _n_overlap_kmers = 0;
-
+      _init_hashbits();
       _allocate_counters();
     }
 
     ~Hashbits() {
+      _free_tables();
+
+      _clear_all_partitions();
+    }
+
+    // free the tables, or unmap them.
+    void _free_tables() {
       if (_counts) {
 	for (unsigned int i = 0; i < _n_tables; i++) {
-	  delete _counts[i];
+	  if (!_mapping) {
+	    delete _counts[i];
+	  }
 	  _counts[i] = NULL;
 	}
 	delete _counts;
@@ -84,15 +144,56 @@ namespace khmer {
 	_n_tables = 0;
       }
 
-      _clear_all_partitions();
+      delete _mapping;
+      _mapping = NULL;
     }
 
     std::vector<HashIntoType> get_tablesizes() const {
       return _tablesizes;
     }
 
+    // Opt in to an independent seeded hash function per table, derived
+    // from the given seed; a seed of 0 reverts to indexing every table
+    // by the k-mer hash itself. Must be set before anything is counted.
+    void set_hash_seed(HashIntoType seed) {
+      if (seed) {
+	_make_table_seeds(seed, _n_tables, _tableseeds);
+      } else {
+	_tableseeds.clear();
+      }
+    }
+
+    std::vector<HashIntoType> get_table_seeds() const {
+      return _tableseeds;
+    }
+
     virtual void save(std::string);
     virtual void load(std::string);
+
+    // Save in the sparse format, as CountingHash::save_sparse; load reads
+    // it back. The blocked tables throw UnsupportedTableLayout.
+    void save_sparse(std::string);
+
+    // Load an uncompressed saved Hashbits by memory-mapping the file, as
+    // CountingHash::load_mapped. The blocked tables throw
+    // UnsupportedTableLayout.
+    void load_mapped(std::string infilename, bool shared = false,
+		     bool populate = false);
+
+    bool is_mapped() const { return _mapping != NULL; }
+
+    // whether merge can OR the other table into this one: the same k,
+    // table sizes and seeds. Never, for the blocked tables.
+    bool can_merge(const Hashbits &other) const;
+
+    // OR the bits of the other table into this one, and take its tags,
+    // too; n_occupied is recounted from the merged bits. n_unique_kmers
+    // becomes the sum of the two, counting k-mers in both tables twice,
+    // as there is no telling which they are. Threaded as
+    // CountingHash::merge; the blocked tables throw
+    // UnsupportedTableLayout.
+    void merge(const Hashbits &other);
+
     virtual void save_tagset(std::string);
     virtual void load_tagset(std::string, bool clear_tags=true);
 
@@ -147,6 +248,16 @@ namespace khmer {
 			       CallbackFn callback = 0,
 			       void * callback_data = 0);
 
+    // consume_fasta_and_tag, with checkpoints of the tables and tags, as
+    // consume_fasta_checkpointed; resume_consume_fasta carries on with it.
+    void consume_fasta_and_tag_checkpointed(const std::string &filename,
+					    const std::string &checkpoint_prefix,
+					    unsigned long long checkpoint_interval,
+					    unsigned int &total_reads,
+					    unsigned long long &n_consumed,
+					    CallbackFn callback = 0,
+					    void * callback_data = 0);
+
     void consume_sequence_and_tag(const std::string& seq,
 				  unsigned long long& n_consumed,
 				  SeenSet * new_tags = 0);
@@ -243,7 +354,7 @@ namespace khmer {
 
       for (unsigned int i = 0; i < _n_tables; i++)
       {
-        HashIntoType bin = khash % _tablesizes[i];
+        HashIntoType bin = _bin(khash, i);
 	HashIntoType byte = bin / 8;
 	unsigned char bit = (unsigned char)(1 << (bin % 8));
 
@@ -301,7 +412,7 @@ namespace khmer {
       bool is_new_kmer = false;
 
       for (unsigned int i = 0; i < _n_tables; i++) {
-	HashIntoType bin = khash % _tablesizes[i];
+	HashIntoType bin = _bin(khash, i);
 	HashIntoType byte = bin / 8;
 	unsigned char bit = bin % 8;
 	if (!( _counts[i][byte] & (1<<bit))) {
@@ -315,18 +426,25 @@ namespace khmer {
       }
     }
 
-	virtual bool check_overlap(HashIntoType khash, Hashbits &ht2) {
+    // prefetch the bins for the given k-mer hash, in every table.
+    void prefetch_bins(HashIntoType khash) const {
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	__builtin_prefetch(_counts[i] + _bin(khash, i) / 8, 1, 1);
+      }
+    }
+
+    virtual void count_many(const HashIntoType * khashes, unsigned int n) {
+      _count_many_static(*this, khashes, n);
+    }
+
+    virtual void get_counts(const HashIntoType * khashes, unsigned int n,
+			    BoundedCounterType * counts) const {
+      _get_counts_static(*this, khashes, n, counts);
+    }
 
-	  for (unsigned int i = 0; i < ht2._n_tables; i++) {
-		HashIntoType bin = khash % ht2._tablesizes[i];
-		HashIntoType byte = bin / 8;
-		unsigned char bit = bin % 8;
-		if (!( ht2._counts[i][byte] & (1<<bit))) {
-		  return false;
+	virtual bool check_overlap(HashIntoType khash, Hashbits &ht2) {
+	  return ht2.get_count(khash) != 0;
 	}
-      }
-	  return true;
-	  }
 
     virtual void count_overlap(const char * kmer, Hashbits &ht2) {
       HashIntoType hash = _hash(kmer, _ksize);
@@ -337,7 +455,7 @@ namespace khmer {
       bool is_new_kmer = false;
 
       for (unsigned int i = 0; i < _n_tables; i++) {
-	HashIntoType bin = khash % _tablesizes[i];
+	HashIntoType bin = _bin(khash, i);
 	HashIntoType byte = bin / 8;
 	unsigned char bit = bin % 8;
 	if (!( _counts[i][byte] & (1<<bit))) {
@@ -363,7 +481,7 @@ namespace khmer {
     // get the count for the given k-mer hash.
     virtual const BoundedCounterType get_count(HashIntoType khash) const {
       for (unsigned int i = 0; i < _n_tables; i++) {
-	HashIntoType bin = khash % _tablesizes[i];
+	HashIntoType bin = _bin(khash, i);
 	HashIntoType byte = bin / 8;
 	unsigned char bit = bin % 8;
       
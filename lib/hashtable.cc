@@ -1,14 +1,15 @@
+#include <exception>
+
 #include "khmer.hh"
 #include "hashtable.hh"
+#include "checkpoint.hh"
+#include "khmer_exception.hh"
 #include "parsers.hh"
+#include "zlib/zlib.h"
 
-// Note: This simple inlined code should be quicker than a call to a 
-//	 'toupper' function in the C library.
-//	 This should boil down to one integer compare, one branch, and 
-//	 maybe one integer subtraction.
-//	 This will be potentially called on trillions of bytes, 
-//	 so efficiency probably matters some.
-#define quick_toupper( c )  (0x61 <= (c) ? (c) - 0x20 : (c))
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 
 using namespace khmer;
 using namespace std;
@@ -30,6 +31,21 @@ Hashtable:: Hasher::
 { }
 
 
+uint32_t
+Hashtable::
+_max_number_of_workers( )
+{
+  uint32_t	  number_of_threads =
+  get_active_config( ).get_number_of_threads( );
+
+#ifdef _OPENMP
+  if ((uint32_t)omp_get_max_threads( ) > number_of_threads)
+    number_of_threads = omp_get_max_threads( );
+#endif
+  return number_of_threads;
+}
+
+
 //
 // check_and_process_read: checks for non-ACGT characters before consuming
 //
@@ -39,11 +55,33 @@ unsigned int Hashtable::check_and_process_read(std::string &read,
                                             HashIntoType lower_bound,
                                             HashIntoType upper_bound)
 {
-   is_valid = check_and_normalize_read(read);
+   std::vector<HashIntoType> packed, kmers;
+
+   return _check_and_process_read(read, is_valid, packed, kmers,
+				  lower_bound, upper_bound);
+}
+
+//
+// _check_and_process_read: as above, but uses the supplied scratch buffers.
+//			     The read is normalized and packed into 2-bit
+//			     codes in one pass, and the k-mers are then
+//			     rolled from the packed codes.
+//
+
+unsigned int Hashtable::_check_and_process_read(std::string &read,
+					     bool &is_valid,
+					     std::vector<HashIntoType> &packed,
+					     std::vector<HashIntoType> &kmers,
+					     HashIntoType lower_bound,
+					     HashIntoType upper_bound)
+{
+   is_valid = (read.length() >= _ksize) &&
+     normalize_and_pack_read(&read[0], read.length(), packed);
 
    if (!is_valid) { return 0; }
 
-   return consume_string(read, lower_bound, upper_bound);
+   return consume_packed_read(&packed[0], read.length(), kmers,
+			      lower_bound, upper_bound);
 }
 
 //
@@ -62,45 +100,133 @@ bool Hashtable::check_and_normalize_read(std::string &read) const
     return false;
   }
 
-  for (unsigned int i = 0; i < read.length(); i++)  {
-    read[ i ] = quick_toupper( read[ i ] ); // normalize to uppercase letters
-    if (!is_valid_dna(read[i])) {
-      return false;
-    }
-  }
-
-  return true;
+  return normalize_read(&read[0], read.length());
 }
 
 //
 // consume_fasta: consume a FASTA file of reads
 //
 
-// TODO? Inline in header.
+//
+// The workers of the threaded consume_fasta share one of these. Each one
+// runs the per-parser consume_fasta below, with _worker_callback as its
+// callback, which stops it once any worker has failed, and passes the
+// calling thread's reports on to the real callback.
+//
+
+namespace {
+
+  struct _WorkerState
+  {
+    CallbackFn		callback;
+    void *		callback_data;
+    volatile bool	stop;
+#if (__cplusplus >= 201103L)
+    std:: exception_ptr	error;
+#endif
+  };
+
+  struct _WorkerStop { };
+
+  struct _WorkerCallbackData
+  {
+    _WorkerState *	state;
+    bool		is_caller;
+  };
+
+  void
+  _worker_callback(
+    const char * info, void * data,
+    unsigned long long n_reads, unsigned long long other
+  )
+  {
+    _WorkerCallbackData * worker = (_WorkerCallbackData *)data;
+
+    if (worker->state->stop) throw _WorkerStop( );
+    if (worker->is_caller && worker->state->callback)
+      worker->state->callback(
+	info, worker->state->callback_data, n_reads, other
+      );
+  }
+
+} // anonymous namespace
+
 void
 Hashtable::
 consume_fasta(
   std:: string const  &filename,
   unsigned int	      &total_reads, unsigned long long	&n_consumed,
   HashIntoType	      lower_bound,  HashIntoType	upper_bound,
-  CallbackFn	      callback,	    void *		callback_data
+  CallbackFn	      callback,	    void *		callback_data,
+  uint32_t	      number_of_workers
 )
 {
   using namespace khmer:: read_parsers;
 
-  // TODO: Get defaults from config.
-  // Note: Always assume only 1 thread if invoked this way.
+  // As many workers as asked for, or as OpenMP would run, up to as many
+  // as this table has hashers for. Without C++11, a worker's exception
+  // cannot be carried out of the parallel region, so there is just the
+  // one.
+  uint32_t	  number_of_threads = number_of_workers;
+#if defined( _OPENMP ) && (__cplusplus >= 201103L)
+  if (!number_of_threads)
+    number_of_threads = omp_get_max_threads( );
+  if (number_of_threads > _number_of_threads)
+    number_of_threads = _number_of_threads;
+#else
+  number_of_threads = 1;
+#endif
+
+  // TODO: Get the cache size from config.
   IParser *	  parser = 
   IParser::get_parser(
-    filename, 1, 2*1024*1024*1024U, TraceLogger:: TLVL_NONE
+    filename, number_of_threads, 2*1024*1024*1024U, TraceLogger:: TLVL_NONE
   );
 
-  consume_fasta(
-    parser, 
-    total_reads, n_consumed, 
-    lower_bound, upper_bound, 
-    callback, callback_data
-  );
+  _WorkerState	  state;
+  state.callback	= callback;
+  state.callback_data	= callback_data;
+  state.stop		= false;
+
+#pragma omp parallel num_threads( number_of_threads ) default( shared )
+  {
+    _WorkerCallbackData	worker;
+    worker.state	= &state;
+#ifdef _OPENMP
+    // The calling thread may be holding locks (e.g. the Python GIL) that
+    // the callback depends on.
+    worker.is_caller	= 0 == omp_get_thread_num( );
+#else
+    worker.is_caller	= true;
+#endif
+
+#if (__cplusplus >= 201103L)
+    try
+    {
+#endif
+      consume_fasta(
+	parser, 
+	total_reads, n_consumed, 
+	lower_bound, upper_bound, 
+	_worker_callback, &worker
+      );
+#if (__cplusplus >= 201103L)
+    }
+    catch (_WorkerStop &) { }
+    catch (...)
+    {
+#pragma omp critical (consume_fasta_error)
+      if (!state.error) state.error = std:: current_exception( );
+      state.stop = true;
+    }
+#endif
+  } // omp parallel
+
+  delete parser;
+
+#if (__cplusplus >= 201103L)
+  if (state.error) std:: rethrow_exception( state.error );
+#endif
 }
 
 void
@@ -132,7 +258,10 @@ consume_fasta(
     read      = parser->get_next_read();
 
     this_n_consumed = 
-    check_and_process_read(read.sequence, is_valid, lower_bound, upper_bound);
+    _check_and_process_read(
+      read.sequence, is_valid, hasher.packed_read, hasher.read_kmers,
+      lower_bound, upper_bound
+    );
 
     n_consumed_LOCAL  = __sync_add_and_fetch( &n_consumed, this_n_consumed );
     total_reads_LOCAL = __sync_add_and_fetch( &total_reads, 1 );
@@ -161,38 +290,226 @@ consume_fasta(
 
 } // consume_fasta
 
+//
+// consume_fasta_checkpointed: consume a FASTA file of reads, checkpointing
+//     the tables every so often.
+//
+
+void
+Hashtable::
+consume_fasta_checkpointed(
+  std:: string const  &filename,
+  std:: string const  &checkpoint_prefix,
+  unsigned long long  checkpoint_interval,
+  unsigned int	      &total_reads, unsigned long long	&n_consumed,
+  CallbackFn	      callback,	    void *		callback_data
+)
+{
+  CheckpointInfo  info;
+
+  info.filename	= filename;
+  info.interval	= checkpoint_interval;
+
+  _consume_fasta_checkpointed(
+    info, checkpoint_prefix, total_reads, n_consumed, callback, callback_data
+  );
+}
+
+bool
+Hashtable::
+_save_checkpoint(std:: string const &prefix)
+{
+  std:: string filename = prefix + ".ht";
+
+  try {
+    save( filename );
+  } catch (TableFileWriteError &e) {
+    return false;
+  }
+  return sync_file( filename );
+}
+
+void
+Hashtable::
+resume_consume_fasta(
+  std:: string const  &checkpoint_prefix,
+  unsigned int	      &total_reads, unsigned long long	&n_consumed,
+  CallbackFn	      callback,	    void *		callback_data
+)
+{
+  CheckpointInfo  info;
+
+  info.load( checkpoint_prefix );
+  _load_checkpoint( info.tables_prefix( checkpoint_prefix ) );
+
+  _consume_fasta_checkpointed(
+    info, checkpoint_prefix, total_reads, n_consumed, callback, callback_data
+  );
+}
+
+void
+Hashtable::
+_consume_fasta_checkpointed(
+  CheckpointInfo      &info,
+  std:: string const  &checkpoint_prefix,
+  unsigned int	      &total_reads, unsigned long long	&n_consumed,
+  CallbackFn	      callback,	    void *		callback_data
+)
+{
+  using namespace khmer:: read_parsers;
+
+  // Only this thread reads, so that the batches are in input order, and a
+  // checkpoint covers exactly the reads before some point in the file.
+  IParser *		  parser  = IParser::get_parser( info.filename, 1 );
+  CheckpointWriter	  writer( checkpoint_prefix );
+  std:: vector< Read >	  batch;
+  unsigned long long	  n_since_checkpoint  = 0;
+
+  // The cache segments of the parser do not map a read back to a place in
+  // the file; so skip to the first read the checkpoint has not consumed.
+  for (unsigned long long i = 0; i < info.n_reads; ++i)
+  {
+    if (parser->is_complete( )) break;
+    parser->get_next_read( );
+  }
+
+  total_reads = info.n_reads;
+  n_consumed  = info.n_consumed;
+
+  try
+  {
+    while (!parser->is_complete( ))
+    {
+      batch.clear( );
+      while ((batch.size( ) < CHECKPOINT_BATCH_SIZE) && !parser->is_complete( ))
+	batch.push_back( parser->get_next_read( ) );
+
+      _consume_checkpoint_batch( batch, info.tag, n_consumed );
+      total_reads	  += batch.size( );
+      n_since_checkpoint  += batch.size( );
+
+      // Take a checkpoint once one is due, and the last one is written.
+      if ((n_since_checkpoint >= info.interval) && !writer.is_busy( ))
+      {
+	// Give up once a checkpoint could not be recorded; the last one
+	// that was still stands, to resume from.
+	if (writer.has_failed( )) throw InvalidCheckpoint( );
+
+	Hashtable * snapshot = _snapshot( );
+	assert( NULL != snapshot );
+
+	info.n_reads	= total_reads;
+	info.n_consumed	= n_consumed;
+	info.generation++;
+	writer.start( snapshot, info );
+
+	n_since_checkpoint  = 0;
+      }
+
+      if (callback)
+	callback(
+	  "consume_fasta_checkpointed", callback_data, total_reads, n_consumed
+	);
+    }
+  }
+  catch (...)
+  {
+    writer.wait( );
+    delete parser;
+    throw;
+  }
+
+  writer.wait( );
+  delete parser;
+
+  if (writer.has_failed( )) throw InvalidCheckpoint( );
+}
+
+void
+Hashtable::
+_consume_checkpoint_batch(
+  std:: vector< read_parsers:: Read >  &batch,
+  bool				      tag,
+  unsigned long long		      &n_consumed
+)
+{
+  uint32_t		  number_of_threads =
+  get_active_config( ).get_number_of_threads( );
+  long long		  n_reads	    = batch.size( );
+  unsigned long long	  n_batch_consumed  = 0;
+
+  assert( !tag );
+
+#pragma omp parallel num_threads( number_of_threads ) reduction( +: n_batch_consumed )
+  {
+    std:: vector< HashIntoType >  packed, kmers;
+    bool			  is_valid;
+
+#pragma omp for schedule( dynamic, 64 )
+    for (long long i = 0; i < n_reads; ++i)
+      n_batch_consumed +=
+      _check_and_process_read(
+	batch[ i ].sequence, is_valid, packed, kmers, 0, 0
+      );
+  } // omp parallel
+
+  n_consumed += n_batch_consumed;
+}
+
 //
 // consume_string: run through every k-mer in the given string, & hash it.
+// Note: All of the k-mers are hashed up front, so that the table can
+//	 prefetch their bins while counting them.
 //
 
 unsigned int Hashtable::consume_string(const std::string &s,
 				       HashIntoType lower_bound,
 				       HashIntoType upper_bound)
 {
-  const char * sp = s.c_str();
-  unsigned int n_consumed = 0;
+  std::vector<HashIntoType> kmers;
+
+  (this->*_collect_string_kmers)(s.c_str(), kmers, lower_bound, upper_bound);
+  if (kmers.size()) {
+    count_many(&kmers[0], kmers.size());
+  }
 
-  bool bounded = true;
+  return kmers.size();
+}
 
-  KMerIterator kmers(sp, _ksize);
-  HashIntoType kmer;
+//
+// consume_packed_read: run through every k-mer in the given 2-bit packed
+// read, & hash it.
+//
 
-  if (lower_bound == upper_bound && upper_bound == 0) {
-    bounded = false;
+unsigned int Hashtable::consume_packed_read(const HashIntoType * packed,
+					    unsigned int length,
+					    std::vector<HashIntoType> &kmers,
+					    HashIntoType lower_bound,
+					    HashIntoType upper_bound)
+{
+  (this->*_collect_packed_kmers)(packed, length, kmers,
+				 lower_bound, upper_bound);
+  if (kmers.size()) {
+    count_many(&kmers[0], kmers.size());
   }
 
-  while(!kmers.done()) {
-    kmer = kmers.next();
-  
-    if (!bounded || (kmer >= lower_bound && kmer < upper_bound)) {
+  return kmers.size();
+}
 
-      count(kmer);
-      n_consumed++;
+unsigned char khmer::get_saved_ht_type(std::string const &filename)
+{
+  unsigned char header[2] = { 0, 0 };
 
-    }
+  gzFile infile = gzopen(filename.c_str(), "rb");
+  if (infile == NULL) {
+    return 0;
+  }
+  if (gzread(infile, header, 2) != 2) {
+    header[1] = 0;
   }
+  gzclose(infile);
 
-  return n_consumed;
+  return header[1];
 }
 
 // vim: set sts=2 sw=2:
@@ -23,10 +23,16 @@ extern "C"
 
 #include "khmer.hh"
 #include "storage.hh"
+#include "read_encoding.hh"
+#include "kmer_hash.hh"
 #include "read_parsers.hh"
 
 #define CALLBACK_PERIOD 100000
 
+// How many k-mers ahead of the current one to prefetch table bins for,
+// when counting a batch of k-mers.
+#define KMER_PREFETCH_DISTANCE 8
+
 namespace khmer {
 
   typedef unsigned int PartitionID;
@@ -45,85 +51,225 @@ namespace khmer {
 
   //
   // Sequence iterator class, test.  Not really a C++ iterator yet.
+  // k-mers longer than MAX_NARROW_KSIZE are rolled in a WideHashIntoType
+  // and reduced into a HashIntoType (see kmer_hash.hh).
   //
 
   class KMerIterator {
   protected:
     const char * _seq;
     const unsigned char _ksize;
-    
-    HashIntoType _kmer_f, _kmer_r;
-    HashIntoType bitmask;
-    unsigned int _nbits_sub_1;
+    const bool _is_wide;
+
+    KMerRoller<HashIntoType> _narrow;
+    KMerRoller<WideHashIntoType> _wide;
     unsigned int index, length;
     bool initialized;
+
+    HashIntoType _first() {
+      index = _ksize;
+
+      if (_is_wide) {
+	_hash_word(_seq, _ksize, _wide.kmer_f, _wide.kmer_r);
+	return _wide.hash();
+      }
+      _hash_word(_seq, _ksize, _narrow.kmer_f, _narrow.kmer_r);
+      return _narrow.hash();
+    }
+
+    HashIntoType _next() {
+      if (done()) {
+	throw std::exception();
+      }
+
+      if (!initialized) {
+	initialized = true;
+	return _first();
+      }
+
+      unsigned char ch = _seq[index];
+      index++;
+      assert(index <= length);
+
+      if (_is_wide) {
+	_wide.roll(twobit_repr(ch), twobit_comp(ch));
+	return _wide.hash();
+      }
+      _narrow.roll(twobit_repr(ch), twobit_comp(ch));
+      return _narrow.hash();
+    }
   public:
-    KMerIterator(const char * seq, unsigned char k) : _seq(seq), _ksize(k) {
-      bitmask = 0;
-      for (unsigned int i = 0; i < _ksize; i++) {
-	bitmask = (bitmask << 2) | 3;
+    KMerIterator(const char * seq, unsigned char k) :
+      _seq(seq), _ksize(k), _is_wide(k > MAX_NARROW_KSIZE) {
+      if (_is_wide) {
+	_wide.init(_ksize);
+      } else {
+	_narrow.init(_ksize);
       }
-      _nbits_sub_1 = (_ksize*2 - 2);
 
       index = _ksize - 1;
       length = strlen(seq);
       initialized = false;
     }
 
+    // Note: The forward and reverse complement k-mers themselves are only
+    //	     available for k <= MAX_NARROW_KSIZE, which the graph code needs.
     HashIntoType first(HashIntoType& f, HashIntoType& r) {
-      HashIntoType x;
-      x = _hash(_seq, _ksize, _kmer_f, _kmer_r);
+      assert(!_is_wide);
+      HashIntoType x = _first();
 
-      f = _kmer_f;
-      r = _kmer_r;
-
-      index = _ksize;
+      f = _narrow.kmer_f;
+      r = _narrow.kmer_r;
 
       return x;
     }
 
     HashIntoType next(HashIntoType& f, HashIntoType& r) {
+      assert(!_is_wide);
+      HashIntoType x = _next();
+
+      f = _narrow.kmer_f;
+      r = _narrow.kmer_r;
+
+      return x;
+    }
+
+    HashIntoType first() { return _first(); }
+    HashIntoType next() { return _next(); }
+
+    bool done() { return index >= length; }
+  };
+
+  //
+  // Sequence iterator over a string, which only yields the k-mer hashes,
+  // rolled by the given KMerRoller or FixedKMerRoller (see kmer_hash.hh).
+  //
+
+  template<typename Roller>
+  class RolledKMerIterator {
+  protected:
+    const char * _seq;
+    const unsigned char _ksize;
+
+    Roller _roller;
+    unsigned int index, length;
+    bool initialized;
+
+    void _roll() {
+      unsigned char ch = _seq[index];
+      index++;
+
+      _roller.roll(twobit_repr(ch), twobit_comp(ch));
+    }
+  public:
+    RolledKMerIterator(const char * seq, unsigned char k) :
+      _seq(seq), _ksize(k) {
+      _roller.init(_ksize);
+
+      index = _ksize - 1;
+      length = strlen(seq);
+      initialized = false;
+    }
+
+    HashIntoType next() {
       if (done()) {
 	throw std::exception();
       }
 
       if (!initialized) {
 	initialized = true;
-	return first(f, r);
+	for (index = 0; index < _ksize; ) {
+	  _roll();
+	}
+	return _roller.hash();
       }
 
-      unsigned char ch = _seq[index];
+      _roll();
+      return _roller.hash();
+    }
+
+    bool done() { return index >= length; }
+  };
+
+  //
+  // Sequence iterator over a 2-bit packed read (see read_encoding.hh).
+  // Same interface as KMerIterator, but the forward and reverse complement
+  // k-mers are rolled directly from the packed codes, by the given
+  // KMerRoller or FixedKMerRoller.
+  //
+
+  template<typename Roller>
+  class PackedKMerIterator {
+  protected:
+    typedef typename Roller::word_type Word;
+
+    const HashIntoType * _packed;
+    const unsigned char _ksize;
+
+    Roller _roller;
+    unsigned int index, length;
+    bool initialized;
+
+    // roll the next base into the forward and reverse complement k-mers.
+    void _roll() {
+      Word code = packed_base(_packed, index);
       index++;
-      assert(index <= length);
 
-      // left-shift the previous hash over
-      _kmer_f = _kmer_f << 2;
+      // complementary codes differ only in their low bit.
+      _roller.roll(code, code ^ 1);
+    }
+  public:
+    PackedKMerIterator(const HashIntoType * packed, unsigned int len,
+		       unsigned char k) : _packed(packed), _ksize(k) {
+      _roller.init(_ksize);
 
-      // 'or' in the current nt
-      _kmer_f |= twobit_repr(ch);
+      index = _ksize - 1;
+      length = len;
+      initialized = false;
+    }
 
-      // mask off the 2 bits we shifted over.
-      _kmer_f &= bitmask;
+    HashIntoType first(Word& f, Word& r) {
+      _roller.init(_ksize);
+      for (index = 0; index < _ksize; ) {
+	_roll();
+      }
 
-      // now handle reverse complement
-      _kmer_r = _kmer_r >> 2;
-      _kmer_r |= (twobit_comp(ch) << _nbits_sub_1);
+      f = _roller.kmer_f;
+      r = _roller.kmer_r;
 
-      f = _kmer_f;
-      r = _kmer_r;
+      return _roller.hash();
+    }
+
+    HashIntoType next(Word& f, Word& r) {
+      if (done()) {
+	throw std::exception();
+      }
+
+      if (!initialized) {
+	initialized = true;
+	return first(f, r);
+      }
 
-      return uniqify_rc(_kmer_f, _kmer_r);
+      _roll();
+
+      f = _roller.kmer_f;
+      r = _roller.kmer_r;
+
+      return _roller.hash();
     }
 
-    HashIntoType first() { return first(_kmer_f, _kmer_r); }
-    HashIntoType next() { return next(_kmer_f, _kmer_r); }
+    HashIntoType first() { Word f, r; return first(f, r); }
+    HashIntoType next() { Word f, r; return next(f, r); }
 
     bool done() { return index >= length; }
   };
 
   class ReadMaskTable;
+  struct CheckpointInfo;
+  class CheckpointWriter;
 
   class Hashtable {		// Base class implementation of a Bloom ht.
+    friend class CheckpointWriter;
 
   protected:
 
@@ -133,6 +279,10 @@ namespace khmer {
 	uint32_t			thread_id;
 	// TODO: Add HasherPerformanceMetrics instance.
 	TraceLogger			trace_logger;
+	// Scratch buffer for the 2-bit packed form of the current read.
+	std:: vector< HashIntoType >	packed_read;
+	// Scratch buffer for the k-mers of the current read.
+	std:: vector< HashIntoType >	read_kmers;
 
 	Hasher(
 	    uint32_t const  thread_id,
@@ -152,10 +302,13 @@ namespace khmer {
     HashIntoType    bitmask;
     unsigned int    _nbits_sub_1;
 
+    // The most threads that may work on a table at once: as configured,
+    // or as many as OpenMP runs, for the consume_fasta driver.
+    static uint32_t _max_number_of_workers( );
+
     Hashtable(
 	WordLength	ksize,
-	// TODO: Get default number of threads from config.
-	uint32_t const	number_of_threads   = 1,
+	uint32_t const	number_of_threads   = _max_number_of_workers( ),
 	uint8_t const	trace_level	    = TraceLogger:: TLVL_NONE
     )
     :	_trace_level( trace_level ),
@@ -193,6 +346,59 @@ namespace khmer {
 	bitmask = (bitmask << 2) | 3;
       }
       _nbits_sub_1 = (_ksize*2 - 2);
+
+      // pick the k-mer kernels for this k: compiled for the k itself, for
+      // the values of k we run most, or else with a runtime mask and shift.
+      switch (_ksize) {
+      case 20: _use_kmer_kernels< FixedKMerRoller<HashIntoType, 20> >(); break;
+      case 25: _use_kmer_kernels< FixedKMerRoller<HashIntoType, 25> >(); break;
+      case 31: _use_kmer_kernels< FixedKMerRoller<HashIntoType, 31> >(); break;
+      case 32: _use_kmer_kernels< FixedKMerRoller<HashIntoType, 32> >(); break;
+      default:
+	if (_ksize > MAX_NARROW_KSIZE) {
+	  _use_kmer_kernels< KMerRoller<WideHashIntoType> >();
+	} else {
+	  _use_kmer_kernels< KMerRoller<HashIntoType> >();
+	}
+      }
+    }
+
+    // k-mer kernels: collect the (in-bounds) k-mers of a string, or of
+    // a 2-bit packed read, into a buffer. Instantiated per KMerRoller.
+    typedef void (Hashtable::*StringKMerCollector)(
+	const char *, std::vector<HashIntoType> &, HashIntoType, HashIntoType
+    ) const;
+    typedef void (Hashtable::*PackedKMerCollector)(
+	const HashIntoType *, unsigned int,
+	std::vector<HashIntoType> &, HashIntoType, HashIntoType
+    ) const;
+
+    StringKMerCollector _collect_string_kmers;
+    PackedKMerCollector _collect_packed_kmers;
+
+    template<typename Roller>
+    void _use_kmer_kernels() {
+      _collect_string_kmers = &Hashtable::_collect_string_kmers_with<Roller>;
+      _collect_packed_kmers = &Hashtable::_collect_packed_kmers_with<Roller>;
+    }
+
+    template<typename Roller>
+    void _collect_string_kmers_with(const char * seq,
+				    std::vector<HashIntoType> &kmers,
+				    HashIntoType lower_bound,
+				    HashIntoType upper_bound) const {
+      RolledKMerIterator<Roller> kmer_iter(seq, _ksize);
+      _collect_kmers(kmer_iter, kmers, lower_bound, upper_bound);
+    }
+
+    template<typename Roller>
+    void _collect_packed_kmers_with(const HashIntoType * packed,
+				    unsigned int length,
+				    std::vector<HashIntoType> &kmers,
+				    HashIntoType lower_bound,
+				    HashIntoType upper_bound) const {
+      PackedKMerIterator<Roller> kmer_iter(packed, length, _ksize);
+      _collect_kmers(kmer_iter, kmers, lower_bound, upper_bound);
     }
 
 
@@ -232,6 +438,64 @@ namespace khmer {
       return uniqify_rc(h, r);
     }
 
+    unsigned int _check_and_process_read(std::string &read,
+					 bool &is_valid,
+					 std::vector<HashIntoType> &packed,
+					 std::vector<HashIntoType> &kmers,
+					 HashIntoType lower_bound,
+					 HashIntoType upper_bound);
+
+    // a copy of the tables, to checkpoint while this one carries on; or
+    // NULL, for tables which cannot be checkpointed.
+    virtual Hashtable * _snapshot() const { return NULL; }
+
+    // save, or load, the tables of a checkpoint, named by the prefix.
+    // Saving syncs them to disk, and returns false if they could not be
+    // written whole.
+    virtual bool _save_checkpoint(const std::string &prefix);
+    virtual void _load_checkpoint(const std::string &prefix) {
+      load(prefix + ".ht");
+    }
+
+    // consume a batch of reads for a checkpointed consume, in parallel;
+    // only Hashbits tags them.
+    virtual void _consume_checkpoint_batch(
+	std::vector<read_parsers:: Read> &batch,
+	bool tag,
+	unsigned long long &n_consumed
+    );
+
+    // run the consume the checkpoint describes, from its n_reads'th read
+    // on, checkpointing under the given prefix.
+    void _consume_fasta_checkpointed(CheckpointInfo &info,
+				     const std::string &checkpoint_prefix,
+				     unsigned int &total_reads,
+				     unsigned long long &n_consumed,
+				     CallbackFn callback,
+				     void * callback_data);
+
+    // collect every (in-bounds) k-mer from the iterator into 'kmers'.
+    // The bounds are [lower_bound, upper_bound); an upper bound of 0 is
+    // the top of the hash space, so that the last of a set of ranges can
+    // take in the largest hashes.
+    template<typename KMerIteratorType>
+    void _collect_kmers(KMerIteratorType &kmer_iter,
+			std::vector<HashIntoType> &kmers,
+			HashIntoType lower_bound,
+			HashIntoType upper_bound) const {
+      bool bounded = lower_bound || upper_bound;
+
+      kmers.clear();
+      while(!kmer_iter.done()) {
+	HashIntoType kmer = kmer_iter.next();
+
+	if (!bounded || (kmer >= lower_bound &&
+			 (!upper_bound || kmer < upper_bound))) {
+	  kmers.push_back(kmer);
+	}
+      }
+    }
+
   public:
 
     // accessor to get 'k'
@@ -240,10 +504,38 @@ namespace khmer {
     virtual void count(const char * kmer) = 0;
     virtual void count(HashIntoType khash) = 0;
 
+    // count a batch of k-mer hashes.
+    // Tables override this to overlap the memory accesses of
+    // successive k-mers by prefetching their bins ahead of time.
+    virtual void count_many(const HashIntoType * khashes, unsigned int n) {
+      for (unsigned int i = 0; i < n; i++) {
+	count(khashes[i]);
+      }
+    }
+
     // get the count for the given k-mer.
     virtual const BoundedCounterType get_count(const char * kmer) const = 0;
     virtual const BoundedCounterType get_count(HashIntoType khash) const = 0;
 
+    // get the counts for a batch of k-mer hashes.
+    // Tables override this, like count_many, to prefetch and to bind the
+    // per-k-mer lookups at compile time.
+    virtual void get_counts(const HashIntoType * khashes, unsigned int n,
+			    BoundedCounterType * counts) const {
+      for (unsigned int i = 0; i < n; i++) {
+	counts[i] = get_count(khashes[i]);
+      }
+    }
+
+    // hash every (in-bounds) k-mer in the string into 'kmers'.
+    void get_kmer_hashes(const std::string &s,
+			 std::vector<HashIntoType> &kmers,
+			 HashIntoType lower_bound = 0,
+			 HashIntoType upper_bound = 0) const {
+      (this->*_collect_string_kmers)(s.c_str(), kmers,
+				     lower_bound, upper_bound);
+    }
+
     virtual void save(std::string) = 0;
     virtual void load(std::string) = 0;
 
@@ -251,6 +543,14 @@ namespace khmer {
     unsigned int consume_string(const std::string &s,
 				HashIntoType lower_bound = 0,
 				HashIntoType upper_bound = 0);
+
+    // count every k-mer in a 2-bit packed read of the given length,
+    // using the supplied scratch buffer to batch the k-mers.
+    unsigned int consume_packed_read(const HashIntoType * packed,
+				     unsigned int length,
+				     std::vector<HashIntoType> &kmers,
+				     HashIntoType lower_bound = 0,
+				     HashIntoType upper_bound = 0);
     
     // checks each read for non-ACGT characters
     bool check_and_normalize_read(std::string &read) const;
@@ -265,6 +565,10 @@ namespace khmer {
     // Note: Yes, the name 'comsume_fasta' is a bit misleading, 
     //	     but the FASTA format is effectively a subset of the FASTQ format
     //	     and the FASTA portion is what we care about in this case.
+    // Note: This spawns number_of_workers workers (by default, as many as
+    //	     OpenMP would run), all sharing one parser; only the calling
+    //	     thread runs the callback. The configured number of threads
+    //	     is left alone, as the saturation thresholds depend on it.
     void consume_fasta(
 	std::string const   &filename,
 	unsigned int	    &total_reads,
@@ -272,7 +576,8 @@ namespace khmer {
 	HashIntoType	    lower_bound	    = 0,
 	HashIntoType	    upper_bound	    = 0,
 	CallbackFn	    callback	    = NULL,
-	void *		    callback_data   = NULL
+	void *		    callback_data   = NULL,
+	uint32_t	    number_of_workers = 0
     );
     // Count every k-mer from a stream of FASTA or FASTQ reads, 
     // using the supplied parser.
@@ -286,8 +591,86 @@ namespace khmer {
 	void *		    callback_data   = NULL
     );
 
+    // Count every k-mer in a FASTA or FASTQ file, as consume_fasta, but
+    // take a checkpoint every checkpoint_interval reads or so, under the
+    // given prefix (see CheckpointInfo), for resume_consume_fasta.
+    // Note: Checkpoints are written by a background thread, from a copy
+    //	     of the tables taken between batches of reads; so there must be
+    //	     memory for a second copy of the tables. Only for CountingHash
+    //	     and Hashbits themselves.
+    void consume_fasta_checkpointed(
+	std::string const   &filename,
+	std::string const   &checkpoint_prefix,
+	unsigned long long  checkpoint_interval,
+	unsigned int	    &total_reads,
+	unsigned long long  &n_consumed,
+	CallbackFn	    callback	    = NULL,
+	void *		    callback_data   = NULL
+    );
+
+    // Load the last checkpoint taken under the given prefix, and carry on
+    // with the consume it was taken of, from the first read it had not
+    // consumed; the reads before are parsed over, but not consumed.
+    // total_reads and n_consumed count the reads before, too.
+    void resume_consume_fasta(
+	std::string const   &checkpoint_prefix,
+	unsigned int	    &total_reads,
+	unsigned long long  &n_consumed,
+	CallbackFn	    callback	    = NULL,
+	void *		    callback_data   = NULL
+    );
+
   };
-			  
+
+  //
+  // Batch kernels over a concrete table type. The per-k-mer calls are
+  // qualified with that type, so they are bound at compile time and can
+  // be inlined into the loop, rather than going through the vtable once
+  // per k-mer. Tables implement count_many and get_counts with these;
+  // so a table which overrides count or get_count must override those,
+  // too.
+  //
+
+  // count a batch of k-mer hashes, prefetching the bins of the k-mers
+  // KMER_PREFETCH_DISTANCE ahead of the one being counted.
+  template<typename Table>
+  inline void _count_many_static(Table &table,
+				 const HashIntoType * khashes, unsigned int n) {
+    unsigned int i;
+
+    for (i = 0; i < n && i < KMER_PREFETCH_DISTANCE; i++) {
+      table.Table::prefetch_bins(khashes[i]);
+    }
+    for (i = 0; i < n; i++) {
+      if (i + KMER_PREFETCH_DISTANCE < n) {
+	table.Table::prefetch_bins(khashes[i + KMER_PREFETCH_DISTANCE]);
+      }
+      table.Table::count(khashes[i]);
+    }
+  }
+
+  // get the counts for a batch of k-mer hashes, likewise.
+  template<typename Table>
+  inline void _get_counts_static(const Table &table,
+				 const HashIntoType * khashes, unsigned int n,
+				 BoundedCounterType * counts) {
+    unsigned int i;
+
+    for (i = 0; i < n && i < KMER_PREFETCH_DISTANCE; i++) {
+      table.Table::prefetch_bins(khashes[i]);
+    }
+    for (i = 0; i < n; i++) {
+      if (i + KMER_PREFETCH_DISTANCE < n) {
+	table.Table::prefetch_bins(khashes[i + KMER_PREFETCH_DISTANCE]);
+      }
+      counts[i] = table.Table::get_count(khashes[i]);
+    }
+  }
+
+  // Peek at the type (SAVED_HASHBITS, SAVED_COUNTING_HT, ...) of a saved
+  // table, so that the right kind of table can be made to load it.
+  // Gzipped files are read transparently. Returns 0 if it can't be read.
+  unsigned char get_saved_ht_type(std::string const &filename);
 
 };
 
@@ -0,0 +1,187 @@
+#include <math.h>
+#include "hllcounter.hh"
+#include "read_encoding.hh"
+#include "read_parsers.hh"
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+using namespace std;
+using namespace khmer;
+using namespace khmer:: read_parsers;
+
+HLLCounter::HLLCounter(WordLength ksize, unsigned int p) :
+  _ksize(ksize), _p(p)
+{
+  assert(p >= HLL_MIN_P && p <= HLL_MAX_P);
+  _registers.assign(1U << p, 0);
+}
+
+double HLLCounter::error_rate() const
+{
+  return 1.04 / sqrt((double) _registers.size());
+}
+
+void HLLCounter::_add(std::vector<unsigned char> &registers,
+		      HashIntoType khash) const
+{
+  HashIntoType h = _seeded_hash(khash, 0);
+  HashIntoType index = h >> (64 - _p);
+
+  // a 1 past the last of the other 64 - p bits stops the run of zeros
+  // there, if they are all zero.
+  HashIntoType rest = (h << _p) | (1ULL << (_p - 1));
+  unsigned char rank = __builtin_clzll(rest) + 1;
+
+  if (rank > registers[index]) {
+    registers[index] = rank;
+  }
+}
+
+unsigned int HLLCounter::_consume_read(std::vector<unsigned char> &registers,
+				       std::string &read) const
+{
+  if (read.length() < _ksize || !normalize_read(&read[0], read.length())) {
+    return 0;
+  }
+
+  KMerIterator kmers(read.c_str(), _ksize);
+  unsigned int n = 0;
+
+  while (!kmers.done()) {
+    _add(registers, kmers.next());
+    n++;
+  }
+  return n;
+}
+
+unsigned int HLLCounter::consume_string(const std::string &s)
+{
+  std::string read = s;
+
+  return _consume_read(_registers, read);
+}
+
+void HLLCounter::consume_fasta(const std::string &filename,
+			       unsigned int &total_reads,
+			       unsigned long long &n_consumed,
+			       CallbackFn callback,
+			       void * callback_data)
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+
+  // the parser reads ahead in this thread; the others only hash.
+  IParser * parser = IParser::get_parser(filename.c_str(), 1);
+  std::vector<Read> batch;
+
+  total_reads = 0;
+  n_consumed = 0;
+
+  while (!parser->is_complete()) {
+    batch.clear();
+    while (batch.size() < HLL_BATCH_SIZE && !parser->is_complete()) {
+      batch.push_back(parser->get_next_read());
+    }
+
+    long long n_reads = batch.size();
+    unsigned long long n_batch_consumed = 0;
+
+#pragma omp parallel num_threads( number_of_threads ) reduction( +: n_batch_consumed )
+    {
+      std::vector<unsigned char> registers(_registers.size(), 0);
+
+#pragma omp for schedule( dynamic, 64 )
+      for (long long r = 0; r < n_reads; r++) {
+	n_batch_consumed += _consume_read(registers, batch[r].sequence);
+      }
+
+#pragma omp critical (hll_merge)
+      for (unsigned int i = 0; i < registers.size(); i++) {
+	if (registers[i] > _registers[i]) {
+	  _registers[i] = registers[i];
+	}
+      }
+    } // omp parallel
+
+    total_reads += batch.size();
+    n_consumed += n_batch_consumed;
+
+    if (callback) {
+      callback("consume_fasta", callback_data, total_reads, n_consumed);
+    }
+  }
+
+  delete parser;
+}
+
+unsigned long long HLLCounter::estimate_cardinality() const
+{
+  double m = _registers.size();
+  double alpha;
+
+  switch (_registers.size()) {
+  case 16: alpha = 0.673; break;
+  case 32: alpha = 0.697; break;
+  case 64: alpha = 0.709; break;
+  default: alpha = 0.7213 / (1.0 + 1.079 / m);
+  }
+
+  double sum = 0;
+  unsigned int n_zeros = 0;
+  for (unsigned int i = 0; i < _registers.size(); i++) {
+    sum += ldexp(1.0, -(int) _registers[i]);
+    if (!_registers[i]) {
+      n_zeros++;
+    }
+  }
+
+  double estimate = alpha * m * m / sum;
+
+  // while many registers are still empty, linear counting of those is
+  // the better estimate. With 64-bit hashes, there is no need of the
+  // correction at the top of the range.
+  if (estimate <= 2.5 * m && n_zeros) {
+    estimate = m * log(m / n_zeros);
+  }
+
+  return (unsigned long long) (estimate + 0.5);
+}
+
+void HLLCounter::merge(const HLLCounter &other)
+{
+  assert(can_merge(other));
+
+  for (unsigned int i = 0; i < _registers.size(); i++) {
+    if (other._registers[i] > _registers[i]) {
+      _registers[i] = other._registers[i];
+    }
+  }
+}
+
+// for a given rate, n_tables * tablesize is least with half of each
+// table's bins taken, at n_tables = -log2(fp_rate).
+void HLLCounter::optimal_size(double fp_rate,
+			      unsigned int &n_tables,
+			      HashIntoType &tablesize) const
+{
+  assert(fp_rate > 0 && fp_rate < 1);
+
+  double n = estimate_cardinality() * (1.0 + 3.0 * error_rate());
+  if (n < 1) {
+    n = 1;
+  }
+
+  if (!n_tables) {
+    n_tables = (unsigned int) floor(-log(fp_rate) / log(2.0) + 0.5);
+    if (!n_tables) {
+      n_tables = 1;
+    }
+  }
+
+  double occupancy = pow(fp_rate, 1.0 / n_tables);
+  tablesize = (HashIntoType) ceil(-n / log(1.0 - occupancy));
+}
+
+// vim: set sts=2 sw=2:
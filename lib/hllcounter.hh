@@ -0,0 +1,85 @@
+#ifndef HLLCOUNTER_HH
+#define HLLCOUNTER_HH
+
+#include <vector>
+#include <string>
+#include "hashtable.hh"
+
+// the default number of index bits of an HLLCounter: 2^14 registers,
+// for a standard error of about 0.8%, in 16kB.
+#define HLL_DEFAULT_P 14
+#define HLL_MIN_P 4
+#define HLL_MAX_P 18
+
+// the number of reads HLLCounter::consume_fasta reads at a time.
+#define HLL_BATCH_SIZE 10000
+
+namespace khmer {
+
+  //
+  // A HyperLogLog estimate of the number of distinct k-mers in a set of
+  // reads, in one pass and a few kB, to size the tables for them before
+  // they are counted.
+  //
+  // Each k-mer hash, as from KMerIterator, is mixed (as for a table seed
+  // of 0); the top p bits of that pick a register, which keeps the
+  // longest run of leading zeros it has seen in the rest.
+  //
+
+  class HLLCounter {
+  protected:
+    WordLength _ksize;
+    unsigned int _p;
+    std::vector<unsigned char> _registers;	// 2^p of them
+
+    void _add(std::vector<unsigned char> &registers, HashIntoType khash)
+      const;
+    unsigned int _consume_read(std::vector<unsigned char> &registers,
+			       std::string &read) const;
+
+  public:
+    HLLCounter(WordLength ksize, unsigned int p = HLL_DEFAULT_P);
+
+    WordLength ksize() const { return _ksize; }
+    unsigned int n_registers() const { return _registers.size(); }
+
+    // the relative standard error of the estimate, 1.04 / sqrt(2^p).
+    double error_rate() const;
+
+    void add(HashIntoType khash) { _add(_registers, khash); }
+
+    // add every k-mer in the string; returns the number added, or 0 if
+    // the string is too short or has a base other than ACGT.
+    unsigned int consume_string(const std::string &s);
+
+    // add every k-mer of every read in a FASTA or FASTQ file.
+    void consume_fasta(const std::string &filename,
+		       unsigned int &total_reads,
+		       unsigned long long &n_consumed,
+		       CallbackFn callback = NULL,
+		       void * callback_data = NULL);
+
+    // estimate the number of distinct k-mers added so far.
+    unsigned long long estimate_cardinality() const;
+
+    // as if every k-mer added to the other had been added to this.
+    bool can_merge(const HLLCounter &other) const {
+      return other._ksize == _ksize && other._p == _p;
+    }
+    void merge(const HLLCounter &other);
+
+    // the table size, and number of tables if n_tables is 0 (else the
+    // given number), for which the chance that a k-mer not in a table
+    // has all of its bins taken (or that a k-mer's count is overstated)
+    // is at most fp_rate, with as few bins in all as can be. That chance
+    // is (1 - e^(-n / tablesize))^n_tables, for n distinct k-mers; taken
+    // here as the estimate plus three standard errors.
+    void optimal_size(double fp_rate,
+		      unsigned int &n_tables,
+		      HashIntoType &tablesize) const;
+  };
+};
+
+#endif // HLLCOUNTER_HH
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,147 @@
+// Merge saved counting hashes, or hashbits tables, built from different
+// sets of reads, into one table, as if it had been built from all of them.
+//
+// Usage: ht-merge [-T number_of_threads] -o output_file table_file ...
+//
+// The tables must all be of the one kind, with the same k, table sizes and
+// hash seeds. Counts add up, saturating as in counting; bits are OR'ed.
+// The output is saved in the plain format, gzipped if its name ends in
+// '.gz'.
+
+#if (__cplusplus >= 201103L)
+#   include <cstdint>
+#else
+extern "C"
+{
+#   include <stdint.h>
+}
+#endif
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <error.h>
+
+#include <string>
+#include <vector>
+
+#include "khmer.hh"
+#include "khmer_config.hh"
+#include "counting.hh"
+#include "hashbits.hh"
+
+using namespace std;
+using namespace khmer;
+
+
+static const char *	    SHORT_OPTS		= "T:o:";
+
+
+// The saved type of a table, taking the sparse tables as the plain ones,
+// which they load as.
+static unsigned char _table_kind( string const &ifile_name )
+{
+    unsigned char   ht_type = get_saved_ht_type( ifile_name );
+
+    if (SAVED_SPARSE_COUNTING_HT == ht_type) return SAVED_COUNTING_HT;
+    if (SAVED_SPARSE_HASHBITS == ht_type) return SAVED_HASHBITS;
+    return ht_type;
+}
+
+
+// Load the first table, and merge each of the others into it, in turn.
+template< typename Table >
+static void merge_tables(
+    vector< string > const &ifile_names, string const &ofile_name
+)
+{
+    vector< HashIntoType >  sizes( 1, 1 );
+    Table		    merged( 20, sizes );
+
+    printf( "Loading '%s'....\n", ifile_names[ 0 ].c_str( ) );
+    merged.load( ifile_names[ 0 ] );
+
+    for (size_t i = 1; i < ifile_names.size( ); ++i)
+    {
+	Table	    other( 20, sizes );
+
+	printf( "Merging '%s'....\n", ifile_names[ i ].c_str( ) );
+	other.load( ifile_names[ i ] );
+	if (!merged.can_merge( other ))
+	    error(
+		1, 0, "'%s' does not match the k, table sizes or seeds of '%s'",
+		ifile_names[ i ].c_str( ), ifile_names[ 0 ].c_str( )
+	    );
+	merged.merge( other );
+    }
+
+    printf( "Saving '%s'....\n", ofile_name.c_str( ) );
+    merged.save( ofile_name );
+}
+
+
+int main( int argc, char * argv[ ] )
+{
+    int			opt		    = -1;
+    char *		conv_residue	    = NULL;
+    uint32_t		number_of_threads   = 0;
+    string		ofile_name;
+    vector< string >	ifile_names;
+
+    while (-1 != (opt = getopt( argc, argv, SHORT_OPTS )))
+    {
+
+	switch (opt)
+	{
+	case 'T':
+	    number_of_threads = (uint32_t)strtoul( optarg, &conv_residue, 10 );
+	    if (!strcmp( optarg, conv_residue ) || !number_of_threads)
+		error( EINVAL, EINVAL, "Invalid number of threads" );
+	    break;
+	case 'o':
+	    ofile_name = string( optarg );
+	    break;
+	default:
+	    error( 0, 0, "Skipping unknown arg, '%c'", optopt );
+	}
+
+    }
+
+    if (ofile_name.empty( ))
+	error( EINVAL, 0, "Name of output file required (-o)" );
+
+    while (optind < argc) ifile_names.push_back( string( argv[ optind++ ] ) );
+    if (ifile_names.size( ) < 2)
+	error( EINVAL, 0, "Names of at least two hash table files required" );
+
+    if (number_of_threads)
+	get_active_config( ).set_number_of_threads( number_of_threads );
+
+    unsigned char   ht_type = _table_kind( ifile_names[ 0 ] );
+    for (size_t i = 1; i < ifile_names.size( ); ++i)
+	if (_table_kind( ifile_names[ i ] ) != ht_type)
+	    error(
+		EINVAL, 0, "'%s' is not the same kind of table as '%s'",
+		ifile_names[ i ].c_str( ), ifile_names[ 0 ].c_str( )
+	    );
+
+    switch (ht_type)
+    {
+    case SAVED_COUNTING_HT:
+	merge_tables< CountingHash >( ifile_names, ofile_name );
+	break;
+    case SAVED_HASHBITS:
+	merge_tables< Hashbits >( ifile_names, ofile_name );
+	break;
+    default:
+	error(
+	    EINVAL, 0, "'%s' is not a counting hash or hashbits table",
+	    ifile_names[ 0 ].c_str( )
+	);
+    }
+
+    return 0;
+
+}
+
+// vim: set sts=4 sw=4 tw=80:
@@ -8,12 +8,18 @@
 #define CIRCUM_RADIUS 2		// @CTB remove
 #define CIRCUM_MAX_VOL 200	// @CTB remove
 
-#define SAVED_FORMAT_VERSION 3
+#define SAVED_FORMAT_VERSION 4
+#define MIN_SAVED_FORMAT_VERSION 3	// oldest version we can still load
 #define SAVED_COUNTING_HT 1
 #define SAVED_HASHBITS 2
 #define SAVED_TAGS 3
 #define SAVED_STOPTAGS 4
 #define SAVED_SUBSET 5
+#define SAVED_BLOCKED_HASHBITS 6
+#define SAVED_BLOCKED_COUNTING_HT 7
+#define SAVED_PACKED_COUNTING_HT 8
+#define SAVED_SPARSE_COUNTING_HT 9
+#define SAVED_SPARSE_HASHBITS 10
 
 #define VERBOSE_REPARTITION 0
 
@@ -24,6 +30,10 @@ namespace khmer {
   // largest number we're going to hash into. (8 bytes/64 bits/32 nt)
   typedef unsigned long long int HashIntoType;
 
+  // a k-mer too long for HashIntoType; reduced into one for the tables.
+  // (16 bytes/128 bits/64 nt)
+  typedef __uint128_t WideHashIntoType;
+
   // largest size 'k' value for k-mer calculations.  (1 byte/255)
   typedef unsigned char WordLength;
 
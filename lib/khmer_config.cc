@@ -188,6 +188,19 @@ namespace khmer
 #endif
   }
 
+
+  const
+  HashCountThresholds
+  Config::
+  get_hash_count_thresholds( void )
+  {
+    HashCountThresholds	thresholds;
+
+    thresholds.max_count    = get_hash_count_threshold( );
+    thresholds.max_bigcount = get_hash_bigcount_threshold( );
+    return thresholds;
+  }
+
 }
 
 // vim: set sts=2 sw=2:
@@ -11,6 +11,15 @@ using namespace std;
 namespace khmer
 {
 
+  // Typed snapshot of the hash count saturation thresholds.
+  // Per-k-mer code paths should capture one of these once, 
+  // rather than consult the string-keyed config data on every k-mer.
+  struct HashCountThresholds
+  {
+    BoundedCounterType	max_count;
+    BoundedCounterType	max_bigcount;
+  };
+
   // Special class for holding ocnfiguration values 
   // and providing accessors to them.
   // There is no need for there to be a singleton.
@@ -51,6 +60,7 @@ namespace khmer
     // This changes depending on whether multi-threading is enabled.
     const Byte get_hash_count_threshold( void );
     const BoundedCounterType get_hash_bigcount_threshold( void );
+    const HashCountThresholds get_hash_count_thresholds( void );
 
   };
 
@@ -0,0 +1,41 @@
+#ifndef KHMER_EXCEPTION_HH
+#define KHMER_EXCEPTION_HH
+
+#include <exception>
+
+namespace khmer {
+
+  // a saved table, or the file it is in, could not be opened or read
+  // whole; the table it was being loaded into is left empty.
+  struct InvalidTableFile : public std::exception {
+    virtual const char * what() const throw() {
+      return "could not read the table file";
+    }
+  };
+
+  // the table does not lay out its counters as the operation needs, e.g.
+  // mapping, sparse saving or merging a blocked or packed table.
+  struct UnsupportedTableLayout : public std::exception {
+    virtual const char * what() const throw() {
+      return "not supported for this table's counter layout";
+    }
+  };
+
+  // a table file could not be written whole.
+  struct TableFileWriteError : public std::exception {
+    virtual const char * what() const throw() {
+      return "could not write the table file";
+    }
+  };
+
+  // a checkpoint record could not be written, or read back.
+  struct InvalidCheckpoint : public std::exception {
+    virtual const char * what() const throw() {
+      return "could not write or read the checkpoint";
+    }
+  };
+};
+
+#endif // KHMER_EXCEPTION_HH
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,166 @@
+#ifndef KMER_HASH_HH
+#define KMER_HASH_HH
+
+#include <string>
+#include <assert.h>
+
+#include "khmer.hh"
+#include "ktable.hh"
+
+// the longest k-mer that fits in the given word type.
+#define MAX_KSIZE_FOR(Word) ((WordLength) (sizeof(Word) * 4))
+
+// k-mers up to this long are hashed into a HashIntoType as is; longer
+// ones are rolled in a WideHashIntoType and reduced into a HashIntoType.
+#define MAX_NARROW_KSIZE MAX_KSIZE_FOR(HashIntoType)
+#define MAX_KSIZE MAX_KSIZE_FOR(WideHashIntoType)
+
+namespace khmer {
+
+  //
+  // The k-mer core, templated on the word type the k-mer is rolled in.
+  //
+
+  // reduce a k-mer word into the HashIntoType the tables are indexed by.
+  // Narrow k-mers are their own hash, so that they can still be reversed
+  // (see _revhash) and walked by the graph code.
+  inline HashIntoType _reduce_kmer(HashIntoType kmer) {
+    return kmer;
+  }
+
+  inline HashIntoType _reduce_kmer(WideHashIntoType kmer) {
+    HashIntoType lo = (HashIntoType) kmer;
+    HashIntoType hi = (HashIntoType) (kmer >> 64);
+
+    return _seeded_hash(lo, _seeded_hash(hi, 0));
+  }
+
+  // a mask of the low 2*k bits of the word.
+  template<typename Word>
+  inline Word _kmer_bitmask(WordLength k) {
+    Word bitmask = 0;
+    for (unsigned int i = 0; i < k; i++) {
+      bitmask = (bitmask << 2) | 3;
+    }
+    return bitmask;
+  }
+
+  // hash a k-length DNA sequence into a word, in both orientations.
+  template<typename Word>
+  inline Word _hash_word(const char * kmer, const WordLength k,
+			 Word& _h, Word& _r) {
+    assert(k <= MAX_KSIZE_FOR(Word));
+    assert(strlen(kmer) >= k);
+
+    Word h = 0, r = 0;
+
+    h |= (Word) twobit_repr(kmer[0]);
+    r |= (Word) twobit_comp(kmer[k-1]);
+
+    for (WordLength i = 1, j = k - 2; i < k; i++, j--) {
+      h = h << 2;
+      r = r << 2;
+
+      h |= (Word) twobit_repr(kmer[i]);
+      r |= (Word) twobit_comp(kmer[j]);
+    }
+
+    _h = h;
+    _r = r;
+
+    return uniqify_rc(h, r);
+  }
+
+  // given a k-mer word, return the associated k-mer.
+  template<typename Word>
+  inline std::string _revhash_word(Word hash, WordLength k) {
+    std::string s(k, 'A');
+
+    for (WordLength i = k; i > 0; i--) {
+      s[i - 1] = revtwobit_repr((unsigned int) (hash & 3));
+      hash = hash >> 2;
+    }
+
+    return s;
+  }
+
+  //
+  // KMerRoller: the forward and reverse complement words of a k-mer,
+  // rolled along a sequence one base (2-bit code) at a time.
+  //
+
+  template<typename Word>
+  class KMerRoller {
+  protected:
+    Word _bitmask;
+    unsigned int _nbits_sub_1;
+  public:
+    typedef Word word_type;
+
+    Word kmer_f, kmer_r;
+
+    KMerRoller() : _bitmask(0), _nbits_sub_1(0), kmer_f(0), kmer_r(0) { }
+
+    void init(WordLength k) {
+      assert(k <= MAX_KSIZE_FOR(Word));
+
+      _bitmask = _kmer_bitmask<Word>(k);
+      _nbits_sub_1 = (k*2 - 2);
+      kmer_f = 0;
+      kmer_r = 0;
+    }
+
+    // roll in the 2-bit code of the next base, given the code of its
+    // complement.
+    void roll(Word code, Word comp) {
+      kmer_f = ((kmer_f << 2) | code) & _bitmask;
+      kmer_r = (kmer_r >> 2) | (comp << _nbits_sub_1);
+    }
+
+    // the canonical k-mer, reduced into a HashIntoType.
+    HashIntoType hash() const {
+      return _reduce_kmer((Word) uniqify_rc(kmer_f, kmer_r));
+    }
+  };
+
+  //
+  // FixedKMerRoller: a KMerRoller for a k fixed at compile time, so that
+  // the mask and shifts fold into constants and the rolling hash can be
+  // unrolled. Instantiated for the common values of k (see
+  // Hashtable::_init_bitstuff).
+  //
+
+  template<typename Word, WordLength K>
+  class FixedKMerRoller {
+  public:
+    typedef Word word_type;
+
+    Word kmer_f, kmer_r;
+
+    FixedKMerRoller() : kmer_f(0), kmer_r(0) { }
+
+    static Word bitmask() {
+      return ~(Word) 0 >> (8*sizeof(Word) - 2*K);
+    }
+
+    void init(WordLength k) {
+      assert(k == K);
+
+      kmer_f = 0;
+      kmer_r = 0;
+    }
+
+    void roll(Word code, Word comp) {
+      kmer_f = ((kmer_f << 2) | code) & bitmask();
+      kmer_r = (kmer_r >> 2) | (comp << (2*K - 2));
+    }
+
+    HashIntoType hash() const {
+      return _reduce_kmer((Word) uniqify_rc(kmer_f, kmer_r));
+    }
+  };
+};
+
+#endif // KMER_HASH_HH
+
+// vim: set sts=2 sw=2:
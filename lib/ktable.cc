@@ -6,6 +6,7 @@
 
 #include "khmer.hh"
 #include "ktable.hh"
+#include "kmer_hash.hh"
 
 using namespace std;
 using namespace khmer;
@@ -18,70 +19,79 @@ HashIntoType khmer::_hash(const char * kmer, const WordLength k,
 			  HashIntoType& _h, HashIntoType& _r)
 {
   // sizeof(HashIntoType) * 8 bits / 2 bits/base  
-  assert(k <= sizeof(HashIntoType)*4);
-  assert(strlen(kmer) >= k);
+  assert(k <= MAX_NARROW_KSIZE);
 
-  HashIntoType h = 0, r = 0;
-
-  h |= twobit_repr(kmer[0]);
-  r |= twobit_comp(kmer[k-1]);
-
-  for (WordLength i = 1, j = k - 2; i < k; i++, j--) {
-    h = h << 2;
-    r = r << 2;
-
-    h |= twobit_repr(kmer[i]);
-    r |= twobit_comp(kmer[j]);
-  }
-
-  _h = h;
-  _r = r;
-
-  return uniqify_rc(h, r);
+  return _hash_word(kmer, k, _h, _r);
 }
 
 // _hash: return the maximum of the forward and reverse hash.
+// k-mers longer than MAX_NARROW_KSIZE are reduced into a 64-bit number.
 
 HashIntoType khmer::_hash(const char * kmer, const WordLength k)
 {
+  if (k > MAX_NARROW_KSIZE) {
+    WideHashIntoType h = 0;
+    WideHashIntoType r = 0;
+
+    return _reduce_kmer(_hash_word(kmer, k, h, r));
+  }
+
   HashIntoType h = 0;
   HashIntoType r = 0;
 
-  return _hash(kmer, k, h, r);
+  return _hash_word(kmer, k, h, r);
 }
 
 // _hash_forward: return the hash from the forward direction only.
 
 HashIntoType khmer::_hash_forward(const char * kmer, WordLength k)
 {
+  if (k > MAX_NARROW_KSIZE) {
+    WideHashIntoType h = 0;
+    WideHashIntoType r = 0;
+
+    _hash_word(kmer, k, h, r);
+    return _reduce_kmer(h);
+  }
+
   HashIntoType h = 0;
   HashIntoType r = 0;
 
-  
-  _hash(kmer, k, h, r);
+  _hash_word(kmer, k, h, r);
   return h;			// return forward only
 }
 
 //
 // _revhash: given an unsigned int, return the associated k-mer.
+// Note: Only k-mers up to MAX_NARROW_KSIZE long can be reversed;
+//	 longer ones are reduced, one-way, by _hash.
 //
 
 std::string khmer::_revhash(HashIntoType hash, WordLength k)
 {
-  std::string s = "";
+  assert(k <= MAX_NARROW_KSIZE);
 
-  unsigned int val = hash & 3;
-  s += revtwobit_repr(val);
+  return _revhash_word(hash, k);
+}
 
-  for (WordLength i = 1; i < k; i++) {
-    hash = hash >> 2;
-    val = hash & 3;
-    s += revtwobit_repr(val);
-  }
+//
+// _make_table_seeds: derive n independent seeds from a single seed, with
+// the SplitMix64 generator.
+//
 
-  reverse(s.begin(), s.end());
+void khmer::_make_table_seeds(HashIntoType seed, unsigned int n,
+			      std::vector<HashIntoType>& seeds)
+{
+  HashIntoType state = seed;
 
-  return s;
+  seeds.clear();
+  for (unsigned int i = 0; i < n; i++) {
+    HashIntoType z = (state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    seeds.push_back(z ^ (z >> 31));
+  }
 }
 
 //
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <vector>
 #include <assert.h>
 
 #include "khmer.hh"
@@ -67,6 +68,25 @@ namespace khmer {
 
   std::string _revhash(HashIntoType hash, WordLength k);
 
+  // one-way hash: mix a k-mer hash under the given seed, so that each
+  // Bloom table can have its own independent hash function.
+  // (The MurmurHash3 64-bit finalizer.)
+  inline HashIntoType _seeded_hash(HashIntoType khash, HashIntoType seed) {
+    HashIntoType h = khash ^ seed;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+  }
+
+  // derive n independent table seeds from a single seed.
+  void _make_table_seeds(HashIntoType seed, unsigned int n,
+			 std::vector<HashIntoType>& seeds);
+
   //
   // KTable class: keep track of k-mer prevalences.
   //
@@ -0,0 +1,97 @@
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+#include <string.h>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "khmer_exception.hh"
+
+namespace khmer {
+
+  //
+  // MappedFile: a whole saved table file, memory-mapped, for tables to
+  // use their counters in place instead of reading them in.
+  //
+  // The mapping is copy-on-write, unless shared: then writes to the
+  // table go to the file, and are seen by every process mapping it.
+  // Pages are read in as they are first touched, unless populate asks
+  // for them all up front. The file must not be truncated or rewritten
+  // while it is mapped, e.g. by saving a mapped table over it.
+  //
+  // read() and take() walk through the file from the start, like
+  // reading it; take() returns the bytes in place, without copying.
+  //
+
+  class MappedFile {
+  protected:
+    char *		_data;
+    unsigned long long	_size;
+    unsigned long long	_pos;
+
+  private:
+    MappedFile(const MappedFile &);
+    MappedFile& operator=(const MappedFile &);
+
+  public:
+    MappedFile(const std::string &filename, bool shared, bool populate) :
+      _data(NULL), _size(0), _pos(0) {
+      int fd = ::open(filename.c_str(), shared ? O_RDWR : O_RDONLY);
+      if (fd < 0) {
+	throw InvalidTableFile();
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+	::close(fd);
+	throw InvalidTableFile();
+      }
+      _size = st.st_size;
+
+      int flags = shared ? MAP_SHARED : MAP_PRIVATE;
+#ifdef MAP_POPULATE
+      if (populate) {
+	flags |= MAP_POPULATE;
+      }
+#endif
+      void * data = mmap(NULL, _size, PROT_READ | PROT_WRITE, flags, fd, 0);
+
+      // the mapping outlives the descriptor.
+      ::close(fd);
+
+      if (data == MAP_FAILED) {
+	throw InvalidTableFile();
+      }
+      _data = (char *) data;
+    }
+
+    ~MappedFile() {
+      if (_data) {
+	munmap(_data, _size);
+	_data = NULL;
+      }
+    }
+
+    unsigned long long size() const { return _size; }
+
+    void read(void * data, unsigned long long n) {
+      memcpy(data, take(n), n);
+    }
+
+    // throws InvalidTableFile if the file ends first.
+    char * take(unsigned long long n) {
+      if (n > _size - _pos) {
+	throw InvalidTableFile();
+      }
+      char * p = _data + _pos;
+      _pos += n;
+      return p;
+    }
+  };
+};
+
+#endif // MAPPED_FILE_HH
+
+// vim: set sts=2 sw=2:
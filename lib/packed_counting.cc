@@ -0,0 +1,187 @@
+#include "packed_counting.hh"
+#include "table_io.hh"
+
+using namespace std;
+using namespace khmer;
+
+void PackedCountingHash::_init_thresholds()
+{
+  CountingHash::_init_thresholds();
+
+  // the compare-and-swap increments never spill over, so the counters
+  // can always fill up, whatever the number of threads.
+  BoundedCounterType counter_max = (1U << _counter_bits) - 1;
+  _thresholds.max_count = counter_max < _thresholds.max_bigcount ?
+    counter_max : _thresholds.max_bigcount;
+}
+
+void PackedCountingHash::_allocate_counters()
+{
+  _n_tables = _tablesizes.size();
+  init_table_moduli(_tablesizes, _tablemods);
+
+  _counts = new Byte*[_n_tables];
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    _counts[i] = new Byte[_table_bytes(i)];
+    memset(_counts[i], 0, _table_bytes(i));
+  }
+}
+
+void PackedCountingHash::_free_counters()
+{
+  if (_counts) {
+    for (unsigned int i = 0; i < _n_tables; i++) {
+      delete[] _counts[i];
+    }
+    delete[] _counts;
+    _counts = NULL;
+  }
+}
+
+const HashIntoType PackedCountingHash::n_occupied(HashIntoType start,
+						  HashIntoType stop) const
+{
+  HashIntoType n = 0;
+  if (stop == 0) { stop = _tablesizes[0]; }
+
+  for (HashIntoType i = start; i < stop; i++) {
+    HashIntoType bin = i % _tablesizes[0];
+    unsigned int c;
+
+    switch (_counter_bits) {
+    case 4:  c = _get_counter<Byte, 4>(_counts[0], bin); break;
+    case 8:  c = _get_counter<Byte, 8>(_counts[0], bin); break;
+    default: c = _get_counter<uint16_t, 16>(_counts[0], bin); break;
+    }
+    if (c) {
+      n++;
+    }
+  }
+  return n;
+}
+
+//
+// Packed counting tables are saved as:
+//
+//   version, SAVED_PACKED_COUNTING_HT, use_bigcount, ksize, n_tables,
+//   counter_bits, hash_seeded [, seeds], (tablesize, table) * n_tables,
+//   bigcounts
+//
+// gzipped if the filename ends in .gz.
+//
+
+void PackedCountingHash::save(std::string outfilename)
+{
+  assert(_counts);
+
+  TableFileWriter outfile(outfilename);
+
+  unsigned char version = SAVED_FORMAT_VERSION;
+  outfile.write(&version, 1);
+
+  unsigned char ht_type = SAVED_PACKED_COUNTING_HT;
+  outfile.write(&ht_type, 1);
+
+  unsigned char use_bigcount = _use_bigcount ? 1 : 0;
+  outfile.write(&use_bigcount, 1);
+
+  unsigned int save_ksize = _ksize;
+  unsigned char save_n_tables = _n_tables;
+  unsigned char save_counter_bits = _counter_bits;
+  outfile.write(&save_ksize, sizeof(save_ksize));
+  outfile.write(&save_n_tables, sizeof(save_n_tables));
+  outfile.write(&save_counter_bits, sizeof(save_counter_bits));
+
+  unsigned char hash_seeded = _tableseeds.size() ? 1 : 0;
+  outfile.write(&hash_seeded, 1);
+  if (hash_seeded) {
+    outfile.write(&_tableseeds[0], sizeof(HashIntoType) * save_n_tables);
+  }
+
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned long long save_tablesize = _tablesizes[i];
+    outfile.write(&save_tablesize, sizeof(save_tablesize));
+    outfile.write(_counts[i], _table_bytes(i));
+  }
+
+  std::vector<char> records;
+  HashIntoType n_counts = _bigcounts.get_records(records);
+  outfile.write(&n_counts, sizeof(n_counts));
+  if (n_counts) {
+    outfile.write(&records[0], records.size());
+  }
+
+  outfile.close();
+}
+
+void PackedCountingHash::load(std::string infilename)
+{
+  _free_counters();
+  _tablesizes.clear();
+  _bigcounts.clear();
+
+  TableFileReader infile(infilename);
+
+  unsigned char version, ht_type, use_bigcount;
+  infile.read(&version, 1);
+  infile.read(&ht_type, 1);
+  if (version != SAVED_FORMAT_VERSION ||
+      ht_type != SAVED_PACKED_COUNTING_HT) {
+    throw InvalidTableFile();
+  }
+
+  infile.read(&use_bigcount, 1);
+  _use_bigcount = use_bigcount;
+
+  unsigned int save_ksize = 0;
+  unsigned char save_n_tables = 0;
+  unsigned char save_counter_bits = 0;
+  infile.read(&save_ksize, sizeof(save_ksize));
+  infile.read(&save_n_tables, sizeof(save_n_tables));
+  infile.read(&save_counter_bits, sizeof(save_counter_bits));
+  if (!is_valid_counter_bits(save_counter_bits)) {
+    throw InvalidTableFile();
+  }
+
+  _ksize = (WordLength) save_ksize;
+  _n_tables = (unsigned int) save_n_tables;
+  _counter_bits = save_counter_bits;
+  _init_bitstuff();
+  _init_thresholds();
+
+  _tableseeds.clear();
+  unsigned char hash_seeded = 0;
+  infile.read(&hash_seeded, 1);
+  if (hash_seeded) {
+    _tableseeds.resize(_n_tables);
+    infile.read(&_tableseeds[0], sizeof(HashIntoType) * _n_tables);
+  }
+
+  _counts = new Byte*[_n_tables]();
+  for (unsigned int i = 0; i < _n_tables; i++) {
+    unsigned long long save_tablesize = 0;
+    infile.read(&save_tablesize, sizeof(save_tablesize));
+    _tablesizes.push_back((HashIntoType) save_tablesize);
+
+    _counts[i] = new Byte[_table_bytes(i)];
+    infile.read(_counts[i], _table_bytes(i));
+  }
+  init_table_moduli(_tablesizes, _tablemods);
+
+  HashIntoType n_counts = 0;
+  infile.read(&n_counts, sizeof(n_counts));
+  // there is at most one big count per counter of a table.
+  if (_tablesizes.empty() || n_counts > _tablesizes[0]) {
+    throw InvalidTableFile();
+  }
+
+  if (n_counts) {
+    std::vector<char> records(n_counts * BIGCOUNT_RECORD_SIZE);
+    infile.read(&records[0], records.size());
+    _bigcounts.set_records(&records[0], n_counts);
+  }
+
+  infile.close();
+}
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,260 @@
+#ifndef PACKED_COUNTING_HH
+#define PACKED_COUNTING_HH
+
+#include <vector>
+#include <stdint.h>
+#include "counting.hh"
+
+namespace khmer {
+
+  //
+  // PackedCountingHash: a CountingHash whose counters are 4, 8 or 16
+  // bits wide, packed into the tables, instead of one Byte each.
+  //
+  // 4-bit counters fit twice the bins in the same memory, for uses that
+  // only care about low counts (e.g. normalizing to a coverage of 20);
+  // 16-bit counters count to 65535 without going to the bigcounts.
+  // Counters saturate at 2**bits - 1 (or the bigcount limit, if lower),
+  // past which the bigcounts take over, as with CountingHash. Threaded
+  // increments compare-and-swap the word holding the counter, so they
+  // never clobber a neighbor and never spill over the saturation point.
+  //
+
+  class PackedCountingHash : public CountingHash {
+  protected:
+    unsigned int _counter_bits;
+
+    // the table byte holding the counter in the given bin.
+    template<typename Word, unsigned int Bits>
+    static HashIntoType _cell(HashIntoType bin) {
+      return (bin / (sizeof(Word) * 8 / Bits)) * sizeof(Word);
+    }
+
+    template<typename Word, unsigned int Bits>
+    static unsigned int _shift(HashIntoType bin) {
+      return (bin % (sizeof(Word) * 8 / Bits)) * Bits;
+    }
+
+    template<typename Word, unsigned int Bits>
+    static unsigned int _get_counter(const Byte * table, HashIntoType bin) {
+      Word w = *(const Word *) (table + _cell<Word, Bits>(bin));
+      return (w >> _shift<Word, Bits>(bin)) & ((1U << Bits) - 1);
+    }
+
+    // increment the counter in the given bin, unless it is saturated;
+    // returns false if it was.
+    template<typename Word, unsigned int Bits>
+    static bool _increment_counter(Byte * table, HashIntoType bin,
+				   unsigned int max_count) {
+      Word *	    wp	  = (Word *) (table + _cell<Word, Bits>(bin));
+      unsigned int  shift = _shift<Word, Bits>(bin);
+      unsigned int  mask  = (1U << Bits) - 1;
+#ifdef KHMER_THREADED
+      Word old = *wp;
+      while (((old >> shift) & mask) < max_count) {
+	Word updated = old + ((Word) 1 << shift);
+	Word seen = __sync_val_compare_and_swap(wp, old, updated);
+	if (seen == old) {
+	  return true;
+	}
+	old = seen;
+      }
+      return false;
+#else
+      if (((*wp >> shift) & mask) >= max_count) {
+	return false;
+      }
+      *wp += (Word) 1 << shift;
+      return true;
+#endif
+    }
+
+    // raise the counter in the given bin to target, unless it is already
+    // there.
+    template<typename Word, unsigned int Bits>
+    static void _raise_counter(Byte * table, HashIntoType bin,
+			       unsigned int target) {
+      Word *	    wp	  = (Word *) (table + _cell<Word, Bits>(bin));
+      unsigned int  shift = _shift<Word, Bits>(bin);
+      unsigned int  mask  = (1U << Bits) - 1;
+#ifdef KHMER_THREADED
+      Word old = *wp;
+      while (((old >> shift) & mask) < target) {
+	Word updated = (old & ~((Word) mask << shift)) |
+	  ((Word) target << shift);
+	Word seen = __sync_val_compare_and_swap(wp, old, updated);
+	if (seen == old) {
+	  break;
+	}
+	old = seen;
+      }
+#else
+      if (((*wp >> shift) & mask) < target) {
+	*wp = (*wp & ~((Word) mask << shift)) | ((Word) target << shift);
+      }
+#endif
+    }
+
+    // as CountingHash::_count_conservative.
+    template<typename Word, unsigned int Bits>
+    void _count_conservative(HashIntoType khash) {
+      unsigned int  max_count	  = _thresholds.max_count;
+      unsigned int  min_count	  = max_count;
+
+      _lock_update(khash);
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	unsigned int the_count =
+	  _get_counter<Word, Bits>(_counts[i], _bin(khash, i));
+	if (the_count < min_count) {
+	  min_count = the_count;
+	}
+      }
+
+      if (min_count >= max_count) {
+	_unlock_update(khash);
+	if (_use_bigcount) {
+	  _count_big(khash);
+	}
+	return;
+      }
+
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	_raise_counter<Word, Bits>(_counts[i], _bin(khash, i), min_count + 1);
+      }
+      _unlock_update(khash);
+    }
+
+    template<typename Word, unsigned int Bits>
+    void _count(HashIntoType khash) {
+      if (_use_conservative) {
+	_count_conservative<Word, Bits>(khash);
+	return;
+      }
+
+      unsigned int  n_full	  = 0;
+      unsigned int  max_count	  = _thresholds.max_count;
+
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	if (!_increment_counter<Word, Bits>(_counts[i], _bin(khash, i),
+					    max_count)) {
+	  n_full++;
+	}
+      }
+
+      if (n_full == _n_tables && _use_bigcount) {
+	_count_big(khash);
+      }
+    }
+
+    template<typename Word, unsigned int Bits>
+    const BoundedCounterType _get_count(HashIntoType khash) const {
+      unsigned int	  max_count	= _thresholds.max_count;
+      BoundedCounterType  min_count	= max_count;
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	BoundedCounterType the_count =
+	  _get_counter<Word, Bits>(_counts[i], _bin(khash, i));
+	if (the_count < min_count) {
+	  min_count = the_count;
+	}
+      }
+      if (min_count == max_count && _use_bigcount) {
+	min_count = _get_big_count(khash, min_count);
+      }
+      return min_count;
+    }
+
+    // the bytes of table i; a whole number of 16-bit words, so that any
+    // counter width can be read a word at a time.
+    HashIntoType _table_bytes(unsigned int i) const {
+      return (_tablesizes[i] * _counter_bits + 15) / 16 * 2;
+    }
+
+    virtual void _init_thresholds();
+    virtual void _allocate_counters();
+    void _free_counters();
+
+    virtual void _add_counter_distribution(HashIntoType * dist) const {
+      _counter_distribution_static(*this, _tablesizes[0], dist);
+    }
+
+    // the packed counters are not checkpointed, mapped or merged.
+    virtual Hashtable * _snapshot() const { return NULL; }
+    virtual bool _has_plain_counters() const { return false; }
+
+  public:
+    PackedCountingHash(WordLength ksize,
+		       std::vector<HashIntoType>& tablesizes,
+		       unsigned int counter_bits) :
+      CountingHash(ksize, tablesizes, false), _counter_bits(counter_bits) {
+      assert(is_valid_counter_bits(counter_bits));
+
+      _init_thresholds();
+      _allocate_counters();
+    }
+
+    virtual ~PackedCountingHash() {
+      _free_counters();
+    }
+
+    static bool is_valid_counter_bits(unsigned int bits) {
+      return bits == 4 || bits == 8 || bits == 16;
+    }
+
+    unsigned int get_counter_bits() const { return _counter_bits; }
+
+    virtual void save(std::string);
+    virtual void load(std::string);
+
+    virtual const HashIntoType n_occupied(HashIntoType start=0,
+					  HashIntoType stop=0) const;
+
+    virtual void count(HashIntoType khash) {
+      switch (_counter_bits) {
+      case 4:	_count<Byte, 4>(khash); break;
+      case 8:	_count<Byte, 8>(khash); break;
+      default:	_count<uint16_t, 16>(khash); break;
+      }
+    }
+
+    virtual const BoundedCounterType get_count(HashIntoType khash) const {
+      switch (_counter_bits) {
+      case 4:	return _get_count<Byte, 4>(khash);
+      case 8:	return _get_count<Byte, 8>(khash);
+      default:	return _get_count<uint16_t, 16>(khash);
+      }
+    }
+
+    BoundedCounterType counter_at(HashIntoType i) const {
+      switch (_counter_bits) {
+      case 4:	return _get_counter<Byte, 4>(_counts[0], i);
+      case 8:	return _get_counter<Byte, 8>(_counts[0], i);
+      default:	return _get_counter<uint16_t, 16>(_counts[0], i);
+      }
+    }
+
+    // prefetch the bins for the given k-mer hash, in every table.
+    void prefetch_bins(HashIntoType khash) const {
+      for (unsigned int i = 0; i < _n_tables; i++) {
+	__builtin_prefetch(_counts[i] + _bin(khash, i) * _counter_bits / 8,
+			   1, 1);
+      }
+    }
+
+    virtual void count_many(const HashIntoType * khashes, unsigned int n) {
+      _count_many_static(*this, khashes, n);
+    }
+
+    virtual void get_counts(const HashIntoType * khashes, unsigned int n,
+			    BoundedCounterType * counts) const {
+      _get_counts_static(*this, khashes, n, counts);
+    }
+
+    // unhide the char * overloads, which hash and call the above.
+    using CountingHash::count;
+    using CountingHash::get_count;
+  };
+};
+
+#endif // PACKED_COUNTING_HH
+
+// vim: set sts=2 sw=2:
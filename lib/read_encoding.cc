@@ -0,0 +1,207 @@
+#include "read_encoding.hh"
+
+#if defined( __AVX2__ )
+#   include <immintrin.h>
+#elif defined( __SSE2__ )
+#   include <emmintrin.h>
+#endif
+
+// Note: This simple inlined code should be quicker than a call to a
+//	 'toupper' function in the C library.
+//	 This should boil down to one integer compare, one branch, and
+//	 maybe one integer subtraction.
+//	 This will be potentially called on trillions of bytes,
+//	 so efficiency probably matters some.
+#define quick_toupper( c )  (0x61 <= (c) ? (c) - 0x20 : (c))
+
+// Note: The 2-bit codes can be read directly off of the ASCII values.
+//	 Bits 1 and 2 of 'A', 'C', 'T', and 'G' are 0, 1, 2, and 3,
+//	 respectively, and swapping those two bits yields the codes
+//	 used by 'twobit_repr': A = 0, T = 1, C = 2, G = 3.
+#define quick_twobit_code( c )	\
+    ((((c) >> 1) & 1) << 1 | (((c) >> 2) & 1))
+
+// Number of bases normalized per call to the span kernel.
+// Must be a multiple of BASES_PER_PACKED_WORD.
+#define NORMALIZE_SPAN_SIZE	256
+
+
+namespace khmer
+{
+
+
+// Upper-case and validate a span of at most NORMALIZE_SPAN_SIZE bases.
+// If 'codes' is not NULL, then also emit the 2-bit code of each base,
+// one per byte.
+static inline
+bool
+_normalize_span( char * seq, size_t const length, unsigned char * codes )
+{
+    size_t  i	= 0;
+
+#if defined( __AVX2__ )
+    __m256i const   lower_limit_32  = _mm256_set1_epi8( 0x60 );
+    __m256i const   case_bit_32	    = _mm256_set1_epi8( 0x20 );
+    __m256i const   base_A_32	    = _mm256_set1_epi8( 'A' );
+    __m256i const   base_C_32	    = _mm256_set1_epi8( 'C' );
+    __m256i const   base_G_32	    = _mm256_set1_epi8( 'G' );
+    __m256i const   base_T_32	    = _mm256_set1_epi8( 'T' );
+    __m256i const   bit_0_32	    = _mm256_set1_epi8( 1 );
+
+    for ( ; i + 32 <= length; i += 32)
+    {
+	__m256i	    chars   = _mm256_loadu_si256( (__m256i const *)(seq + i) );
+
+	chars = _mm256_sub_epi8(
+	    chars,
+	    _mm256_and_si256(
+		_mm256_cmpgt_epi8( chars, lower_limit_32 ), case_bit_32
+	    )
+	);
+	_mm256_storeu_si256( (__m256i *)(seq + i), chars );
+
+	__m256i	    valid   =
+	_mm256_or_si256(
+	    _mm256_or_si256(
+		_mm256_cmpeq_epi8( chars, base_A_32 ),
+		_mm256_cmpeq_epi8( chars, base_C_32 )
+	    ),
+	    _mm256_or_si256(
+		_mm256_cmpeq_epi8( chars, base_G_32 ),
+		_mm256_cmpeq_epi8( chars, base_T_32 )
+	    )
+	);
+	if (-1 != _mm256_movemask_epi8( valid )) return false;
+
+	if (NULL != codes)
+	{
+	    // Note: Bits shifted in from the neighboring byte are masked off.
+	    __m256i bit_1 =
+	    _mm256_and_si256( _mm256_srli_epi16( chars, 1 ), bit_0_32 );
+	    __m256i bit_2 =
+	    _mm256_and_si256( _mm256_srli_epi16( chars, 2 ), bit_0_32 );
+	    _mm256_storeu_si256(
+		(__m256i *)(codes + i),
+		_mm256_or_si256( _mm256_add_epi8( bit_1, bit_1 ), bit_2 )
+	    );
+	}
+    }
+#endif
+
+#if defined( __SSE2__ )
+    __m128i const   lower_limit_16  = _mm_set1_epi8( 0x60 );
+    __m128i const   case_bit_16	    = _mm_set1_epi8( 0x20 );
+    __m128i const   base_A_16	    = _mm_set1_epi8( 'A' );
+    __m128i const   base_C_16	    = _mm_set1_epi8( 'C' );
+    __m128i const   base_G_16	    = _mm_set1_epi8( 'G' );
+    __m128i const   base_T_16	    = _mm_set1_epi8( 'T' );
+    __m128i const   bit_0_16	    = _mm_set1_epi8( 1 );
+
+    for ( ; i + 16 <= length; i += 16)
+    {
+	__m128i	    chars   = _mm_loadu_si128( (__m128i const *)(seq + i) );
+
+	chars = _mm_sub_epi8(
+	    chars,
+	    _mm_and_si128( _mm_cmpgt_epi8( chars, lower_limit_16 ), case_bit_16 )
+	);
+	_mm_storeu_si128( (__m128i *)(seq + i), chars );
+
+	__m128i	    valid   =
+	_mm_or_si128(
+	    _mm_or_si128(
+		_mm_cmpeq_epi8( chars, base_A_16 ),
+		_mm_cmpeq_epi8( chars, base_C_16 )
+	    ),
+	    _mm_or_si128(
+		_mm_cmpeq_epi8( chars, base_G_16 ),
+		_mm_cmpeq_epi8( chars, base_T_16 )
+	    )
+	);
+	if (0xffff != _mm_movemask_epi8( valid )) return false;
+
+	if (NULL != codes)
+	{
+	    // Note: Bits shifted in from the neighboring byte are masked off.
+	    __m128i bit_1 = _mm_and_si128( _mm_srli_epi16( chars, 1 ), bit_0_16 );
+	    __m128i bit_2 = _mm_and_si128( _mm_srli_epi16( chars, 2 ), bit_0_16 );
+	    _mm_storeu_si128(
+		(__m128i *)(codes + i),
+		_mm_or_si128( _mm_add_epi8( bit_1, bit_1 ), bit_2 )
+	    );
+	}
+    }
+#endif
+
+    // Scalar fallback and tail.
+    for ( ; i < length; ++i)
+    {
+	char const  ch	= quick_toupper( seq[ i ] );
+
+	seq[ i ] = ch;
+	if (!(('A' == ch) || ('C' == ch) || ('G' == ch) || ('T' == ch)))
+	    return false;
+	if (NULL != codes) codes[ i ] = quick_twobit_code( ch );
+    }
+
+    return true;
+}
+
+
+bool
+normalize_read( char * seq, size_t const length )
+{
+    for (size_t start = 0; start < length; start += NORMALIZE_SPAN_SIZE)
+    {
+	size_t const	span	= MIN( NORMALIZE_SPAN_SIZE, length - start );
+
+	if (!_normalize_span( seq + start, span, NULL )) return false;
+    }
+
+    return true;
+}
+
+
+bool
+normalize_and_pack_read(
+    char * seq, size_t const length, std:: vector< HashIntoType > &packed
+)
+{
+    unsigned char   codes[ NORMALIZE_SPAN_SIZE ];
+    HashIntoType    word	= 0;
+
+    packed.clear( );
+    packed.reserve( length / BASES_PER_PACKED_WORD + 1 );
+
+    for (size_t start = 0; start < length; start += NORMALIZE_SPAN_SIZE)
+    {
+	size_t const	span	= MIN( NORMALIZE_SPAN_SIZE, length - start );
+
+	if (!_normalize_span( seq + start, span, codes )) return false;
+
+	// Note: Spans always begin on a word boundary.
+	for (size_t j = 0; j < span; ++j)
+	{
+	    word = (word << 2) | codes[ j ];
+	    if (0 == ((j + 1) % BASES_PER_PACKED_WORD))
+	    {
+		packed.push_back( word );
+		word = 0;
+	    }
+	}
+    }
+
+    // Left-justify any partial last word.
+    if (length % BASES_PER_PACKED_WORD)
+	packed.push_back(
+	    word
+	    << (2 * (BASES_PER_PACKED_WORD - (length % BASES_PER_PACKED_WORD)))
+	);
+
+    return true;
+}
+
+
+} // namespace khmer
+
+// vim: set ft=cpp sts=4 sw=4 tw=80:
@@ -0,0 +1,52 @@
+#ifndef READ_ENCODING_HH
+#define READ_ENCODING_HH
+
+
+#include <cstddef>
+#include <vector>
+
+#include "khmer.hh"
+
+
+// Number of bases held by each word of a 2-bit packed read.
+#define BASES_PER_PACKED_WORD	32
+
+
+namespace khmer
+{
+
+
+// Upper-case a read in place and check that it consists only of ACGT.
+// Returns false on the first invalid base.
+bool normalize_read( char * seq, size_t const length );
+
+// Upper-case a read in place, check that it consists only of ACGT,
+// and pack it into 2-bit codes, all in a single pass over the read.
+// The codes are the same as those given by 'twobit_repr'.
+// Bases are packed BASES_PER_PACKED_WORD to a word,
+// most significant bits first.
+// Note: Uses SSE2 or AVX2 instructions, when the compiler targets them,
+//	 and falls back to scalar code otherwise.
+bool normalize_and_pack_read(
+    char * seq, size_t const length, std:: vector< HashIntoType > &packed
+);
+
+
+// Fetch the 2-bit code of the base at the given position of a packed read.
+inline
+HashIntoType
+packed_base( HashIntoType const * packed, size_t const pos )
+{
+    return
+    (packed[ pos / BASES_PER_PACKED_WORD ]
+     >> (2 * (BASES_PER_PACKED_WORD - 1 - (pos % BASES_PER_PACKED_WORD))))
+    & 3;
+}
+
+
+} // namespace khmer
+
+
+#endif // READ_ENCODING_HH
+
+// vim: set ft=cpp sts=4 sw=4 tw=80:
@@ -1120,6 +1120,7 @@ IParser(
     ),
     _thread_id_map( ThreadIDMap( number_of_threads ) ),
     _unithreaded( 1 == number_of_threads ),
+    _keep_reads_with_n( false ),
     _states( new ParserState *[ number_of_threads ] )
 { for (uint32_t i = 0; i < number_of_threads; ++i) _states[ i ] = NULL; }
 
@@ -1351,7 +1352,8 @@ get_next_read( )
 	state.pmetrics.numreads_parsed_total++;
 
 	// Discard invalid read.
-	if (std:: string:: npos != the_read.sequence.find_first_of( "Nn" ))
+	if (    !_keep_reads_with_n
+	    &&	(std:: string:: npos != the_read.sequence.find_first_of( "Nn" )))
 	{
 	    trace_logger(
 		TraceLogger:: TLVL_DEBUG6,
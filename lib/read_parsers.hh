@@ -415,6 +415,10 @@ struct IParser
 
     virtual Read	get_next_read( )    = 0;
 
+    // Pass on FASTA reads with an N in them, instead of discarding them.
+    inline void		set_keep_reads_with_n( bool const keep )
+    { _keep_reads_with_n = keep; }
+
 protected:
     
     struct ParserState
@@ -449,6 +453,7 @@ protected:
 
     ThreadIDMap		_thread_id_map;
     bool		_unithreaded;
+    bool		_keep_reads_with_n;
 
     ParserState **	_states;
 
@@ -0,0 +1,261 @@
+#include <math.h>
+#include "sharded_counting.hh"
+
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
+using namespace std;
+using namespace khmer;
+using namespace khmer:: read_parsers;
+
+ShardedCountingHash::ShardedCountingHash(WordLength ksize,
+					 std::vector<HashIntoType> &tablesizes,
+					 unsigned int n_shards) :
+  _ksize(ksize), _tablesizes(tablesizes), _shards(n_shards, NULL)
+{
+  assert(n_shards > 0);
+  _hasher = new CountingHash(ksize, 1);
+  _init_bounds(n_shards);
+}
+
+ShardedCountingHash::~ShardedCountingHash()
+{
+  for (unsigned int i = 0; i < _shards.size(); i++) {
+    drop_shard(i);
+  }
+  delete _hasher;
+}
+
+// cut the hash space at the quantiles of the hash of a random k-mer. That
+// is uniform over 4^k hashes, or over all 64 bits for the k-mers which
+// are hashed down to them; except that the smaller of the hashes of a
+// k-mer and its reverse complement falls below x with probability
+// 1 - (1 - x)^2, for x a fraction of the space.
+void ShardedCountingHash::_init_bounds(unsigned int n_shards)
+{
+  long double space = _ksize < 32 ? ldexpl(1.0L, 2 * _ksize) :
+    ldexpl(1.0L, 64);
+#if !NO_UNIQUE_RC
+  bool folded = _ksize <= MAX_NARROW_KSIZE;
+#else
+  bool folded = false;
+#endif
+
+  _lower_bounds.resize(n_shards);
+  for (unsigned int i = 0; i < n_shards; i++) {
+    long double q = (long double) i / n_shards;
+    long double x = folded ? 1.0L - sqrtl(1.0L - q) : q;
+
+    _lower_bounds[i] = (HashIntoType) (space * x);
+  }
+}
+
+CountingHash &ShardedCountingHash::shard(unsigned int i)
+{
+  if (!_shards[i]) {
+    _shards[i] = new CountingHash(_ksize, _tablesizes);
+  }
+  return *_shards[i];
+}
+
+bool ShardedCountingHash::has_all_shards() const
+{
+  for (unsigned int i = 0; i < _shards.size(); i++) {
+    if (!_shards[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ShardedCountingHash::drop_shard(unsigned int i)
+{
+  delete _shards[i];
+  _shards[i] = NULL;
+}
+
+void ShardedCountingHash::load_shard(unsigned int i, std::string filename,
+				     bool mapped)
+{
+  // no need to allocate tables of the default size, only to replace them.
+  std::vector<HashIntoType> tablesizes(1, 1);
+
+  drop_shard(i);
+  _shards[i] = new CountingHash(_ksize, tablesizes);
+  try {
+    if (mapped) {
+      _shards[i]->load_mapped(filename);
+    } else {
+      _shards[i]->load(filename);
+    }
+  } catch (...) {
+    drop_shard(i);
+    throw;
+  }
+
+  // a shard of some other table would answer for the wrong k-mers.
+  if (_shards[i]->ksize() != _ksize) {
+    drop_shard(i);
+    throw InvalidTableFile();
+  }
+}
+
+void ShardedCountingHash::consume_fasta_shard(unsigned int i,
+					      const std::string &filename,
+					      unsigned int &total_reads,
+					      unsigned long long &n_consumed,
+					      CallbackFn callback,
+					      void * callback_data)
+{
+  HashIntoType lower, upper;
+
+  get_shard_bounds(i, lower, upper);
+
+  // the first shard has a lower bound of 0, which takes two to mean no
+  // bounds at all; fine, so long as it ends where the last one begins.
+  if (!lower && !upper) {
+    assert(_shards.size() == 1);
+  }
+
+  total_reads = 0;
+  n_consumed = 0;
+  shard(i).consume_fasta(filename, total_reads, n_consumed, lower, upper,
+			 callback, callback_data);
+}
+
+void ShardedCountingHash::consume_fasta(const std::string &filename,
+					unsigned int &total_reads,
+					unsigned long long &n_consumed,
+					CallbackFn callback,
+					void * callback_data)
+{
+  unsigned int number_of_threads =
+    get_active_config( ).get_number_of_threads( );
+
+  for (unsigned int i = 0; i < _shards.size(); i++) {
+    shard(i);
+  }
+
+  // only this thread reads; every thread hashes and counts.
+  IParser * parser = IParser::get_parser(filename.c_str(), 1);
+  std::vector<Read> batch;
+
+  total_reads = 0;
+  n_consumed = 0;
+
+  while (!parser->is_complete()) {
+    batch.clear();
+    while (batch.size() < SHARDED_BATCH_SIZE && !parser->is_complete()) {
+      batch.push_back(parser->get_next_read());
+    }
+
+    long long n_reads = batch.size();
+    unsigned long long n_batch_consumed = 0;
+
+#pragma omp parallel num_threads( number_of_threads ) reduction( +: n_batch_consumed )
+    {
+      std::vector<HashIntoType> kmers;
+      std::vector< std::vector<HashIntoType> > routed(_shards.size());
+
+#pragma omp for schedule( dynamic, 64 )
+      for (long long r = 0; r < n_reads; r++) {
+	if (!_hasher->check_and_normalize_read(batch[r].sequence)) {
+	  continue;
+	}
+	_hasher->get_kmer_hashes(batch[r].sequence, kmers);
+
+	for (unsigned int j = 0; j < kmers.size(); j++) {
+	  routed[shard_of(kmers[j])].push_back(kmers[j]);
+	}
+	for (unsigned int i = 0; i < routed.size(); i++) {
+	  if (routed[i].size()) {
+	    _shards[i]->count_many(&routed[i][0], routed[i].size());
+	    routed[i].clear();
+	  }
+	}
+	n_batch_consumed += kmers.size();
+      }
+    } // omp parallel
+
+    total_reads += batch.size();
+    n_consumed += n_batch_consumed;
+
+    if (callback) {
+      callback("consume_fasta", callback_data, total_reads, n_consumed);
+    }
+  }
+
+  delete parser;
+}
+
+unsigned int ShardedCountingHash::consume_string(const std::string &s)
+{
+  std::vector<HashIntoType> kmers;
+
+  _hasher->get_kmer_hashes(s, kmers);
+  for (unsigned int j = 0; j < kmers.size(); j++) {
+    shard(shard_of(kmers[j])).count(kmers[j]);
+  }
+  return kmers.size();
+}
+
+void ShardedCountingHash::_get_kmer_counts(const std::string &s,
+				std::vector<BoundedCounterType> &counts) const
+{
+  std::vector<HashIntoType> kmers;
+
+  _hasher->get_kmer_hashes(s, kmers);
+  counts.resize(kmers.size());
+  for (unsigned int j = 0; j < kmers.size(); j++) {
+    counts[j] = get_count(kmers[j]);
+  }
+}
+
+// as CountingHash::get_median_count.
+void ShardedCountingHash::get_median_count(const std::string &s,
+					   BoundedCounterType &median,
+					   float &average,
+					   float &stddev) const
+{
+  std::vector<BoundedCounterType> counts;
+
+  _get_kmer_counts(s, counts);
+
+  median = 0;
+  average = 0;
+  stddev = 0;
+  if (!counts.size()) {
+    return;
+  }
+
+  for (unsigned int j = 0; j < counts.size(); j++) {
+    average += counts[j];
+  }
+  average /= float(counts.size());
+
+  for (unsigned int j = 0; j < counts.size(); j++) {
+    stddev += (float(counts[j]) - average) * (float(counts[j]) - average);
+  }
+  stddev /= float(counts.size());
+  stddev = sqrt(stddev);
+
+  // rounds down
+  nth_element(counts.begin(), counts.begin() + counts.size() / 2,
+	      counts.end());
+  median = counts[counts.size() / 2];
+}
+
+BoundedCounterType ShardedCountingHash::get_min_count(const std::string &s)
+  const
+{
+  std::vector<BoundedCounterType> counts;
+
+  _get_kmer_counts(s, counts);
+  if (!counts.size()) {
+    return 0;
+  }
+  return *std::min_element(counts.begin(), counts.end());
+}
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,121 @@
+#ifndef SHARDED_COUNTING_HH
+#define SHARDED_COUNTING_HH
+
+#include <vector>
+#include <algorithm>
+#include "counting.hh"
+
+// the number of reads the single-pass consume_fasta reads at a time.
+#define SHARDED_BATCH_SIZE 10000
+
+namespace khmer {
+
+  //
+  // A counting hash split by k-mer hash into shards, each a CountingHash
+  // which counts only the k-mers of its own range of hashes, through the
+  // lower and upper bounds of consume_fasta and consume_string. A shard
+  // need only be sized for its share of the k-mers; so the shards can be
+  // built a pass over the reads at a time, saved and dropped, to count
+  // more k-mers than fit in memory at once. Loaded back, or mapped, each
+  // k-mer of a query is looked up in its own shard.
+  //
+  // The ranges are cut so that random k-mers fall evenly between them:
+  // with the reverse complements folded together, a k-mer hashes to the
+  // smaller of two hashes, which skews towards the bottom of the space.
+  //
+
+  class ShardedCountingHash {
+  protected:
+    WordLength _ksize;
+    std::vector<HashIntoType> _tablesizes;	// of each shard
+    std::vector<HashIntoType> _lower_bounds;	// of the ranges, in order
+    std::vector<CountingHash *> _shards;	// NULL until used
+
+    // a table of one bin, to hash and check reads with.
+    CountingHash * _hasher;
+
+    void _init_bounds(unsigned int n_shards);
+
+    // the count of every k-mer in s, each from its own shard.
+    void _get_kmer_counts(const std::string &s,
+			  std::vector<BoundedCounterType> &counts) const;
+
+  public:
+    ShardedCountingHash(WordLength ksize,
+			std::vector<HashIntoType> &tablesizes,
+			unsigned int n_shards);
+    ~ShardedCountingHash();
+
+    WordLength ksize() const { return _ksize; }
+    unsigned int n_shards() const { return _shards.size(); }
+
+    // the range of hashes of a shard, [lower, upper); an upper bound of 0
+    // is the top of the hash space.
+    void get_shard_bounds(unsigned int i,
+			  HashIntoType &lower, HashIntoType &upper) const {
+      lower = _lower_bounds[i];
+      upper = i + 1 < _lower_bounds.size() ? _lower_bounds[i + 1] : 0;
+    }
+
+    // the shard whose range holds the given k-mer hash.
+    unsigned int shard_of(HashIntoType khash) const {
+      return std::upper_bound(_lower_bounds.begin(), _lower_bounds.end(),
+			      khash) - _lower_bounds.begin() - 1;
+    }
+
+    // the shard, allocated empty, if it is not there.
+    CountingHash &shard(unsigned int i);
+
+    bool has_shard(unsigned int i) const { return _shards[i] != NULL; }
+    bool has_all_shards() const;
+
+    // free a shard, once it is saved, to make room for the next.
+    void drop_shard(unsigned int i);
+
+    void save_shard(unsigned int i, std::string filename) {
+      shard(i).save(filename);
+    }
+
+    // load a saved shard; or map it, as CountingHash::load_mapped.
+    void load_shard(unsigned int i, std::string filename,
+		    bool mapped = false);
+
+    // one pass over the reads, counting the k-mers of the one shard.
+    void consume_fasta_shard(unsigned int i,
+			     const std::string &filename,
+			     unsigned int &total_reads,
+			     unsigned long long &n_consumed,
+			     CallbackFn callback = NULL,
+			     void * callback_data = NULL);
+
+    // one pass over the reads, counting the k-mers of every shard; each
+    // read is hashed once, and its k-mers sent to their shards.
+    void consume_fasta(const std::string &filename,
+		       unsigned int &total_reads,
+		       unsigned long long &n_consumed,
+		       CallbackFn callback = NULL,
+		       void * callback_data = NULL);
+
+    unsigned int consume_string(const std::string &s);
+
+    // queries; the shards must all be there.
+    BoundedCounterType get_count(HashIntoType khash) const {
+      return _shards[shard_of(khash)]->get_count(khash);
+    }
+
+    BoundedCounterType get_count(const char * kmer) const {
+      return get_count(_hash(kmer, _ksize));
+    }
+
+    void get_median_count(const std::string &s,
+			  BoundedCounterType &median,
+			  float &average,
+			  float &stddev) const;
+
+    BoundedCounterType get_min_count(const std::string &s) const;
+  };
+};
+
+#endif // SHARDED_COUNTING_HH
+
+// vim: set sts=2 sw=2:
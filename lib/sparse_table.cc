@@ -0,0 +1,229 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "sparse_table.hh"
+
+#if defined( __AVX2__ )
+#   include <immintrin.h>
+#elif defined( __SSE2__ )
+#   include <emmintrin.h>
+#endif
+
+
+namespace khmer
+{
+
+
+// Bitmap of the nonzero bytes in a full block of SPARSE_BLOCK_SIZE bytes,
+// least significant bit first.
+static inline
+uint64_t
+_nonzero_bitmap( Byte const * block )
+{
+#if defined( __AVX2__ )
+    __m256i const   zero_32	= _mm256_setzero_si256( );
+    uint32_t const  lo		=
+    _mm256_movemask_epi8(
+	_mm256_cmpeq_epi8(
+	    _mm256_loadu_si256( (__m256i const *)block ), zero_32
+	)
+    );
+    uint32_t const  hi		=
+    _mm256_movemask_epi8(
+	_mm256_cmpeq_epi8(
+	    _mm256_loadu_si256( (__m256i const *)(block + 32) ), zero_32
+	)
+    );
+
+    return ~(((uint64_t)hi << 32) | lo);
+#elif defined( __SSE2__ )
+    __m128i const   zero_16	= _mm_setzero_si128( );
+    uint64_t	    zeros	= 0;
+
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+	uint64_t const	bits	=
+	(uint16_t)_mm_movemask_epi8(
+	    _mm_cmpeq_epi8(
+		_mm_loadu_si128( (__m128i const *)(block + 16 * i) ), zero_16
+	    )
+	);
+	zeros |= bits << (16 * i);
+    }
+
+    return ~zeros;
+#else
+    uint64_t	    bitmap	= 0;
+
+    for (unsigned int i = 0; i < SPARSE_BLOCK_SIZE; ++i)
+	if (block[ i ]) bitmap |= (uint64_t)1 << i;
+
+    return bitmap;
+#endif
+}
+
+
+// Bitmap of the nonzero bytes in block 'i' of the table,
+// zero-padding a partial last block.
+static inline
+uint64_t
+_block_bitmap( Byte const * table, size_t const length, size_t const i )
+{
+    size_t const    start	= i * SPARSE_BLOCK_SIZE;
+
+    if (start + SPARSE_BLOCK_SIZE <= length)
+	return _nonzero_bitmap( table + start );
+
+    Byte	    padded[ SPARSE_BLOCK_SIZE ];
+
+    memset( padded, 0, SPARSE_BLOCK_SIZE );
+    memcpy( padded, table + start, length - start );
+    return _nonzero_bitmap( padded );
+}
+
+
+static inline
+void
+_put_varint( std:: vector< char > &out, uint64_t value )
+{
+    while (value >= 0x80)
+    {
+	out.push_back( (char)((value & 0x7f) | 0x80) );
+	value >>= 7;
+    }
+    out.push_back( (char)value );
+}
+
+
+static inline
+bool
+_get_varint(
+    char const * in, size_t const in_length, size_t &pos, uint64_t &value
+)
+{
+    value = 0;
+    for (unsigned int shift = 0; (pos < in_length) && (shift < 64); shift += 7)
+    {
+	unsigned char const byte    = in[ pos++ ];
+
+	value |= (uint64_t)(byte & 0x7f) << shift;
+	if (!(byte & 0x80)) return true;
+    }
+
+    return false;
+}
+
+
+void
+sparse_encode_table(
+    Byte const * table, size_t const length, std:: vector< char > &out
+)
+{
+    size_t const	    n_blocks	=
+    (length + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE;
+    std:: vector< uint64_t >  bitmaps;
+    size_t		    i		= 0;
+
+    while (i < n_blocks)
+    {
+	size_t const	zeros_start = i;
+
+	while ((i < n_blocks) && !_block_bitmap( table, length, i )) ++i;
+	_put_varint( out, i - zeros_start );
+
+	bitmaps.clear( );
+	for ( ; i < n_blocks; ++i)
+	{
+	    uint64_t const  bitmap  = _block_bitmap( table, length, i );
+
+	    if (!bitmap) break;
+	    bitmaps.push_back( bitmap );
+	}
+	_put_varint( out, bitmaps.size( ) );
+
+	size_t		block	    = i - bitmaps.size( );
+
+	for (size_t j = 0; j < bitmaps.size( ); ++j, ++block)
+	{
+	    Byte const *    src	    = table + block * SPARSE_BLOCK_SIZE;
+	    uint64_t	    bitmap  = bitmaps[ j ];
+
+	    for (unsigned int k = 0; k < 8; ++k)
+		out.push_back( (char)((bitmap >> (8 * k)) & 0xff) );
+
+	    if (!~bitmap)
+	    {
+		out.insert( out.end( ), src, src + SPARSE_BLOCK_SIZE );
+		continue;
+	    }
+	    for ( ; bitmap; bitmap &= bitmap - 1)
+		out.push_back( (char)src[ __builtin_ctzll( bitmap ) ] );
+	}
+    }
+}
+
+
+size_t
+sparse_decode_table(
+    char const * in, size_t const in_length,
+    Byte * table, size_t const length
+)
+{
+    size_t const    n_blocks	=
+    (length + SPARSE_BLOCK_SIZE - 1) / SPARSE_BLOCK_SIZE;
+    size_t	    block	= 0;
+    size_t	    pos		= 0;
+
+    while (block < n_blocks)
+    {
+	uint64_t    n_zero, n_dense;
+
+	if (!_get_varint( in, in_length, pos, n_zero )) return 0;
+	if (n_zero > n_blocks - block) return 0;
+
+	size_t const	start	    = block * SPARSE_BLOCK_SIZE;
+
+	memset(
+	    table + start, 0,
+	    MIN( n_zero * SPARSE_BLOCK_SIZE, length - start )
+	);
+	block += n_zero;
+
+	if (!_get_varint( in, in_length, pos, n_dense )) return 0;
+	if (n_dense > n_blocks - block) return 0;
+
+	for (uint64_t j = 0; j < n_dense; ++j, ++block)
+	{
+	    Byte *	    dst	    = table + block * SPARSE_BLOCK_SIZE;
+	    size_t const    avail   =
+	    MIN( (size_t)SPARSE_BLOCK_SIZE, length - block * SPARSE_BLOCK_SIZE );
+	    uint64_t	    bitmap  = 0;
+
+	    if (in_length - pos < 8) return 0;
+	    for (unsigned int k = 0; k < 8; ++k)
+		bitmap |= (uint64_t)(unsigned char)in[ pos++ ] << (8 * k);
+
+	    if (in_length - pos < (size_t)__builtin_popcountll( bitmap ))
+		return 0;
+	    if ((avail < SPARSE_BLOCK_SIZE) && (bitmap >> avail)) return 0;
+
+	    if (!~bitmap)
+	    {
+		memcpy( dst, in + pos, SPARSE_BLOCK_SIZE );
+		pos += SPARSE_BLOCK_SIZE;
+		continue;
+	    }
+
+	    memset( dst, 0, avail );
+	    for ( ; bitmap; bitmap &= bitmap - 1)
+		dst[ __builtin_ctzll( bitmap ) ] = in[ pos++ ];
+	}
+    }
+
+    return pos;
+}
+
+
+} // namespace khmer
+
+// vim: set ft=cpp sts=4 sw=4 tw=80:
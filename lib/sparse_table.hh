@@ -0,0 +1,53 @@
+#ifndef SPARSE_TABLE_HH
+#define SPARSE_TABLE_HH
+
+
+#include <cstddef>
+#include <vector>
+
+#include "khmer.hh"
+
+
+// Number of table bytes in each bitmap block of the sparse encoding.
+#define SPARSE_BLOCK_SIZE	64
+
+// Number of table bytes encoded as one segment.
+// Segments are saved with their encoded sizes, so that a table can be
+// decoded a segment at a time, without holding all of its encoding.
+// Must be a multiple of SPARSE_BLOCK_SIZE.
+#define SPARSE_SEGMENT_SIZE	(1 << 24)
+
+
+namespace khmer
+{
+
+
+// Encode a table (or segment) of the given length, appending it to 'out'.
+// The table is cut into blocks of SPARSE_BLOCK_SIZE bytes, the last one
+// padded with zeros. The encoding alternates between a run of all-zero
+// blocks, and a run of blocks with nonzero bytes. Each run starts with its
+// length in blocks, as a varint. Each block with nonzero bytes is stored as
+// a 64-bit little-endian bitmap of its nonzero bytes, then those bytes, in
+// order. Mostly empty tables shrink to a few bytes per occupied bin.
+// Note: Uses SSE2 or AVX2 instructions, when the compiler targets them,
+//	 to find the nonzero bytes, and falls back to scalar code otherwise.
+void sparse_encode_table(
+    Byte const * table, size_t const length, std:: vector< char > &out
+);
+
+// Decode an encoding made by 'sparse_encode_table' into a table of the
+// given length, writing every byte of it.
+// Returns the number of encoded bytes used, or 0 if the encoding is
+// malformed or does not fit in 'in_length' bytes.
+size_t sparse_decode_table(
+    char const * in, size_t const in_length,
+    Byte * table, size_t const length
+);
+
+
+} // namespace khmer
+
+
+#endif // SPARSE_TABLE_HH
+
+// vim: set ft=cpp sts=4 sw=4 tw=80:
@@ -305,7 +305,9 @@ void SubsetPartition::find_all_tags(HashIntoType kmer_f,
 {
   const HashIntoType bitmask = _ht->bitmask;
 
-  HashIntoType f, r;
+  const char bases[] = "ACGT";
+  HashIntoType nbr_f[8], nbr_r[8], nbrs[8];
+  BoundedCounterType nbr_counts[8];
   bool first = true;
   NodeQueue node_q;
   std::queue<unsigned int> breadth_q;
@@ -370,71 +372,32 @@ void SubsetPartition::find_all_tags(HashIntoType kmer_f,
     //
     // Enqueue next set of nodes.
     //
+    // Note: The counts of all 8 neighbors are looked up in one batch,
+    //	     so that the table can overlap their memory accesses.
+    //
 
     // NEXT
-    f = next_f(kmer_f, 'A');
-    r = next_r(kmer_r, 'A');
-    if (_ht->get_count(uniqify_rc(f,r)) &&
-	!set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
-    }
-
-    f = next_f(kmer_f, 'C');
-    r = next_r(kmer_r, 'C');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
-    }
-
-    f = next_f(kmer_f, 'G');
-    r = next_r(kmer_r, 'G');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
-    }
-
-    f = next_f(kmer_f, 'T');
-    r = next_r(kmer_r, 'T');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
+    for (unsigned int j = 0; j < 4; j++) {
+      nbr_f[j] = next_f(kmer_f, bases[j]);
+      nbr_r[j] = next_r(kmer_r, bases[j]);
     }
 
     // PREVIOUS.
-    r = prev_r(kmer_r, 'A');
-    f = prev_f(kmer_f, 'A');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
+    for (unsigned int j = 0; j < 4; j++) {
+      nbr_r[4 + j] = prev_r(kmer_r, bases[j]);
+      nbr_f[4 + j] = prev_f(kmer_f, bases[j]);
     }
 
-    r = prev_r(kmer_r, 'C');
-    f = prev_f(kmer_f, 'C');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
-    }
-    
-    r = prev_r(kmer_r, 'G');
-    f = prev_f(kmer_f, 'G');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
+    for (unsigned int j = 0; j < 8; j++) {
+      nbrs[j] = uniqify_rc(nbr_f[j], nbr_r[j]);
     }
+    _ht->get_counts(nbrs, 8, nbr_counts);
 
-    r = prev_r(kmer_r, 'T');
-    f = prev_f(kmer_f, 'T');
-    if (_ht->get_count(uniqify_rc(f,r)) && 
-        !set_contains(keeper, uniqify_rc(f,r))) {
-      node_q.push(f); node_q.push(r);
-      breadth_q.push(breadth + 1);
+    for (unsigned int j = 0; j < 8; j++) {
+      if (nbr_counts[j] && !set_contains(keeper, nbrs[j])) {
+	node_q.push(nbr_f[j]); node_q.push(nbr_r[j]);
+	breadth_q.push(breadth + 1);
+      }
     }
 
     first = false;
@@ -761,7 +724,8 @@ void SubsetPartition::merge_from_disk(string other_filename)
 
   infile.read((char *) &version, 1);
   infile.read((char *) &ht_type, 1);
-  assert(version == SAVED_FORMAT_VERSION);
+  assert(version >= MIN_SAVED_FORMAT_VERSION &&
+	 version <= SAVED_FORMAT_VERSION);
   assert(ht_type == SAVED_SUBSET);
 
   infile.read((char *) &save_ksize, sizeof(save_ksize));
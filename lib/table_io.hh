@@ -0,0 +1,163 @@
+#ifndef TABLE_IO_HH
+#define TABLE_IO_HH
+
+#include <assert.h>
+#include <string>
+#include <fstream>
+#include "zlib/zlib.h"
+#include "block_gzip.hh"
+#include "sparse_table.hh"
+#include "khmer_exception.hh"
+
+namespace khmer {
+
+  //
+  // Raw reading and writing of saved tables, for the table types which
+  // lay out their own files: block-compressed (see BlockGzipWriter) if
+  // the filename ends in .gz.
+  //
+
+  inline bool is_gz_filename(const std::string &filename) {
+    std::string::size_type found = filename.find_last_of(".");
+    return found != std::string::npos && filename.substr(found+1) == "gz";
+  }
+
+  class TableFileWriter {
+    BlockGzipWriter * _gzfile;
+    std::ofstream _outfile;
+  public:
+    TableFileWriter(const std::string &outfilename) : _gzfile(NULL) {
+      if (is_gz_filename(outfilename)) {
+	_gzfile = new BlockGzipWriter(outfilename);
+      } else {
+	_outfile.open(outfilename.c_str(), std::ios::binary);
+	assert(_outfile.is_open());
+      }
+    }
+
+    ~TableFileWriter() { close(); }
+
+    void write(const void * data, unsigned long long n) {
+      if (_gzfile) {
+	_gzfile->write(data, n);
+      } else {
+	_outfile.write((const char *) data, n);
+      }
+    }
+
+    void close() {
+      if (_gzfile) {
+	_gzfile->close();
+	delete _gzfile;
+	_gzfile = NULL;
+      } else if (_outfile.is_open()) {
+	_outfile.close();
+      }
+    }
+  };
+
+  // block-compressed files are decompressed in parallel; gzread reads
+  // any other file, gzipped or not. Throws InvalidTableFile if the file
+  // cannot be opened, or ends before what is asked of it.
+  class TableFileReader {
+    BlockGzipReader * _blockfile;
+    gzFile _gzfile;
+  public:
+    TableFileReader(const std::string &infilename) :
+      _blockfile(NULL), _gzfile(NULL) {
+      if (BlockGzipReader::is_block_gzip(infilename)) {
+	_blockfile = new BlockGzipReader(infilename);
+      } else {
+	_gzfile = gzopen(infilename.c_str(), "rb");
+	if (_gzfile == NULL) {
+	  throw InvalidTableFile();
+	}
+      }
+    }
+
+    ~TableFileReader() { close(); }
+
+    void read(void * data, unsigned long long n) {
+      if (_blockfile) {
+	if (_blockfile->read(data, n) != n) {
+	  throw InvalidTableFile();
+	}
+	return;
+      }
+
+      char * p = (char *) data;
+      while (n) {
+	unsigned int chunk = n > (1U << 30) ? (1U << 30) : (unsigned int) n;
+	int read = gzread(_gzfile, p, chunk);
+	if (read <= 0) {
+	  throw InvalidTableFile();
+	}
+	p += read;
+	n -= read;
+      }
+    }
+
+    void close() {
+      if (_blockfile) {
+	delete _blockfile;
+	_blockfile = NULL;
+      }
+      if (_gzfile) {
+	gzclose(_gzfile);
+	_gzfile = NULL;
+      }
+    }
+  };
+
+  // write a table in the sparse encoding, a segment of SPARSE_SEGMENT_SIZE
+  // bytes at a time, each after its encoded size.
+  inline void write_sparse_table(TableFileWriter &outfile, const Byte * table,
+				 unsigned long long length) {
+    std::vector<char> encoded;
+    for (unsigned long long start = 0; start < length;
+	 start += SPARSE_SEGMENT_SIZE) {
+      unsigned long long n = MIN(length - start,
+				 (unsigned long long) SPARSE_SEGMENT_SIZE);
+
+      encoded.clear();
+      sparse_encode_table(table + start, n, encoded);
+
+      unsigned long long encoded_size = encoded.size();
+      outfile.write(&encoded_size, sizeof(encoded_size));
+      outfile.write(&encoded[0], encoded_size);
+    }
+  }
+
+  // read a table written by write_sparse_table into table, which must
+  // hold length bytes. Throws InvalidTableFile if a segment does not
+  // decode to its share of the table, using all of its encoded bytes.
+  inline void read_sparse_table(TableFileReader &infile, Byte * table,
+				unsigned long long length) {
+    std::vector<char> encoded;
+    for (unsigned long long start = 0; start < length;
+	 start += SPARSE_SEGMENT_SIZE) {
+      unsigned long long n = MIN(length - start,
+				 (unsigned long long) SPARSE_SEGMENT_SIZE);
+
+      // no encoding takes more than a run length, a bitmap and all of
+      // the bytes, for each block.
+      unsigned long long encoded_size = 0;
+      infile.read(&encoded_size, sizeof(encoded_size));
+      if (!encoded_size || encoded_size >
+	  (n / SPARSE_BLOCK_SIZE + 1) * (10 + 8 + SPARSE_BLOCK_SIZE)) {
+	throw InvalidTableFile();
+      }
+      encoded.resize(encoded_size);
+      infile.read(&encoded[0], encoded_size);
+
+      if (sparse_decode_table(&encoded[0], encoded_size, table + start, n) !=
+	  encoded_size) {
+	throw InvalidTableFile();
+      }
+    }
+  }
+};
+
+#endif // TABLE_IO_HH
+
+// vim: set sts=2 sw=2:
@@ -0,0 +1,183 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "table_merge.hh"
+#include "khmer_config.hh"
+
+#if defined( __AVX2__ )
+#   include <immintrin.h>
+#elif defined( __SSE2__ )
+#   include <emmintrin.h>
+#endif
+
+
+namespace khmer
+{
+
+
+static inline
+void
+_merge_counters_chunk(
+    Byte * dst, Byte const * src, size_t const length, Byte const max_count
+)
+{
+    size_t	    i	    = 0;
+
+#if defined( __AVX2__ )
+    __m256i const   max_32  = _mm256_set1_epi8( (char)max_count );
+
+    for ( ; i + 32 <= length; i += 32)
+    {
+	__m256i const	sum =
+	_mm256_adds_epu8(
+	    _mm256_loadu_si256( (__m256i const *)(dst + i) ),
+	    _mm256_loadu_si256( (__m256i const *)(src + i) )
+	);
+	_mm256_storeu_si256(
+	    (__m256i *)(dst + i), _mm256_min_epu8( sum, max_32 )
+	);
+    }
+#elif defined( __SSE2__ )
+    __m128i const   max_16  = _mm_set1_epi8( (char)max_count );
+
+    for ( ; i + 16 <= length; i += 16)
+    {
+	__m128i const	sum =
+	_mm_adds_epu8(
+	    _mm_loadu_si128( (__m128i const *)(dst + i) ),
+	    _mm_loadu_si128( (__m128i const *)(src + i) )
+	);
+	_mm_storeu_si128( (__m128i *)(dst + i), _mm_min_epu8( sum, max_16 ) );
+    }
+#endif
+
+    for ( ; i < length; ++i)
+    {
+	unsigned int const  sum	= (unsigned int)dst[ i ] + src[ i ];
+
+	dst[ i ] = (Byte)MIN( sum, (unsigned int)max_count );
+    }
+}
+
+
+static inline
+void
+_merge_bits_chunk( Byte * dst, Byte const * src, size_t const length )
+{
+    size_t	    i	    = 0;
+
+#if defined( __AVX2__ )
+    for ( ; i + 32 <= length; i += 32)
+	_mm256_storeu_si256(
+	    (__m256i *)(dst + i),
+	    _mm256_or_si256(
+		_mm256_loadu_si256( (__m256i const *)(dst + i) ),
+		_mm256_loadu_si256( (__m256i const *)(src + i) )
+	    )
+	);
+#elif defined( __SSE2__ )
+    for ( ; i + 16 <= length; i += 16)
+	_mm_storeu_si128(
+	    (__m128i *)(dst + i),
+	    _mm_or_si128(
+		_mm_loadu_si128( (__m128i const *)(dst + i) ),
+		_mm_loadu_si128( (__m128i const *)(src + i) )
+	    )
+	);
+#endif
+
+    for ( ; i < length; ++i) dst[ i ] |= src[ i ];
+}
+
+
+static inline
+unsigned long long
+_count_set_bits_chunk( Byte const * table, size_t const length )
+{
+    unsigned long long	n   = 0;
+    size_t		i   = 0;
+
+    for ( ; i + 8 <= length; i += 8)
+    {
+	uint64_t    word;
+
+	memcpy( &word, table + i, 8 );
+	n += __builtin_popcountll( word );
+    }
+    for ( ; i < length; ++i) n += __builtin_popcount( table[ i ] );
+
+    return n;
+}
+
+
+void
+merge_counters(
+    Byte * dst, Byte const * src, size_t const length, Byte const max_count
+)
+{
+    uint32_t const  number_of_threads	=
+    get_active_config( ).get_number_of_threads( );
+    long long const n_chunks		=
+    (length + TABLE_MERGE_CHUNK_SIZE - 1) / TABLE_MERGE_CHUNK_SIZE;
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic )
+    for (long long i = 0; i < n_chunks; ++i)
+    {
+	size_t const	start	= i * TABLE_MERGE_CHUNK_SIZE;
+
+	_merge_counters_chunk(
+	    dst + start, src + start,
+	    MIN( (size_t)TABLE_MERGE_CHUNK_SIZE, length - start ), max_count
+	);
+    }
+}
+
+
+void
+merge_bits( Byte * dst, Byte const * src, size_t const length )
+{
+    uint32_t const  number_of_threads	=
+    get_active_config( ).get_number_of_threads( );
+    long long const n_chunks		=
+    (length + TABLE_MERGE_CHUNK_SIZE - 1) / TABLE_MERGE_CHUNK_SIZE;
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic )
+    for (long long i = 0; i < n_chunks; ++i)
+    {
+	size_t const	start	= i * TABLE_MERGE_CHUNK_SIZE;
+
+	_merge_bits_chunk(
+	    dst + start, src + start,
+	    MIN( (size_t)TABLE_MERGE_CHUNK_SIZE, length - start )
+	);
+    }
+}
+
+
+unsigned long long
+count_set_bits( Byte const * table, size_t const length )
+{
+    uint32_t const	number_of_threads   =
+    get_active_config( ).get_number_of_threads( );
+    long long const	n_chunks	    =
+    (length + TABLE_MERGE_CHUNK_SIZE - 1) / TABLE_MERGE_CHUNK_SIZE;
+    unsigned long long	n		    = 0;
+
+#pragma omp parallel for num_threads( number_of_threads ) schedule( dynamic ) reduction( +: n )
+    for (long long i = 0; i < n_chunks; ++i)
+    {
+	size_t const	start	= i * TABLE_MERGE_CHUNK_SIZE;
+
+	n +=
+	_count_set_bits_chunk(
+	    table + start, MIN( (size_t)TABLE_MERGE_CHUNK_SIZE, length - start )
+	);
+    }
+
+    return n;
+}
+
+
+} // namespace khmer
+
+// vim: set ft=cpp sts=4 sw=4 tw=80:
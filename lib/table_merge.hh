@@ -0,0 +1,39 @@
+#ifndef TABLE_MERGE_HH
+#define TABLE_MERGE_HH
+
+
+#include <cstddef>
+
+#include "khmer.hh"
+
+
+// Number of table bytes a thread merges, or counts the bits of, at a time.
+#define TABLE_MERGE_CHUNK_SIZE	(1 << 20)
+
+
+namespace khmer
+{
+
+
+// Add the counters of 'src' into those of 'dst', saturating at 'max_count'.
+// Counters which are over 'max_count' already are brought down to it.
+// Note: The table is split into chunks over the configured number of
+//	 threads. Uses SSE2 or AVX2 instructions, when the compiler targets
+//	 them, and falls back to scalar code otherwise.
+void merge_counters(
+    Byte * dst, Byte const * src, size_t const length, Byte const max_count
+);
+
+// OR the bits of 'src' into those of 'dst'; threaded as 'merge_counters'.
+void merge_bits( Byte * dst, Byte const * src, size_t const length );
+
+// Number of bits set in the table; threaded as 'merge_counters'.
+unsigned long long count_set_bits( Byte const * table, size_t const length );
+
+
+} // namespace khmer
+
+
+#endif // TABLE_MERGE_HH
+
+// vim: set ft=cpp sts=4 sw=4 tw=80:
@@ -10,8 +10,15 @@
 #include "ktable.hh"
 #include "hashtable.hh"
 #include "hashbits.hh"
+#include "blocked_hashbits.hh"
+#include "blocked_counting.hh"
+#include "packed_counting.hh"
 #include "counting.hh"
 #include "storage.hh"
+#include "table_io.hh"
+#include "checkpoint.hh"
+#include "sharded_counting.hh"
+#include "hllcounter.hh"
 
 //
 // Function necessary for Python loading:
@@ -83,6 +90,65 @@ void _report_fn(const char * info, void * data, unsigned long long n_reads,
   Py_END_ALLOW_THREADS;
 }
 
+// as _report_fn, for a caller which has released the GIL.
+void _report_fn_without_gil(const char * info, void * data,
+			    unsigned long long n_reads,
+			    unsigned long long other)
+{
+  PyGILState_STATE gil = PyGILState_Ensure();
+
+  try {
+    _report_fn(info, data, n_reads, other);
+  } catch (_khmer_signal &e) {
+    PyGILState_Release(gil);
+    throw;
+  }
+  PyGILState_Release(gil);
+}
+
+
+// set a ValueError, and return false, unless k is a k-mer size the
+// tables can hash.
+static bool _check_ksize(unsigned int k)
+{
+  using namespace khmer;	// for MAX_KSIZE
+
+  if (k < 1 || k > MAX_KSIZE) {
+    PyErr_SetString(PyExc_ValueError, "k-mer size must be from 1 to 64");
+    return false;
+  }
+  return true;
+}
+
+// set a ValueError, and return false, if the table's k-mers are wide.
+// Traversal, tagging and partitioning step from k-mer to k-mer, which
+// needs the k-mers themselves; wide ones are kept only as reduced hashes.
+static bool _check_graph_ksize(khmer::Hashtable * ht)
+{
+  using namespace khmer;	// for MAX_NARROW_KSIZE
+
+  if (ht->ksize() > MAX_NARROW_KSIZE) {
+    PyErr_SetString(PyExc_ValueError,
+		    "graph, tag and partition operations need k <= 32");
+    return false;
+  }
+  return true;
+}
+
+// set a ValueError, and return false, if k-mers of size k are wide: their
+// hashes are reduced, one-way, so are not the k-mers themselves, as
+// forward_hash and reverse_hash promise.
+static bool _check_narrow_ksize(unsigned int k)
+{
+  using namespace khmer;	// for MAX_NARROW_KSIZE
+
+  if (k > MAX_NARROW_KSIZE) {
+    PyErr_SetString(PyExc_ValueError,
+		    "k-mers can only be hashed, or reversed, for k <= 32");
+    return false;
+  }
+  return true;
+}
 
 /***********************************************************************/
 
@@ -1167,6 +1233,88 @@ static PyObject * hash_get_use_bigcount(PyObject * self, PyObject * args)
   return PyBool_FromLong((int)val);
 }
 
+static PyObject * hash_set_use_conservative(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  PyObject * x;
+  if (!PyArg_ParseTuple(args, "O", &x)) {
+    return NULL;
+  }
+
+  bool setme = PyObject_IsTrue(x);
+  counting->set_use_conservative(setme);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hash_get_use_conservative(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  bool val = counting->get_use_conservative();
+
+  return PyBool_FromLong((int)val);
+}
+
+static PyObject * hash_set_hash_seed(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  unsigned long long seed = 0;
+
+  if (!PyArg_ParseTuple(args, "K", &seed)) {
+    return NULL;
+  }
+
+  counting->set_hash_seed(seed);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hash_get_table_seeds(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  std::vector<khmer::HashIntoType> seeds = counting->get_table_seeds();
+
+  PyObject * x = PyList_New(seeds.size());
+  for (unsigned int i = 0; i < seeds.size(); i++) {
+    PyList_SET_ITEM(x, i, PyLong_FromUnsignedLongLong(seeds[i]));
+  }
+
+  return x;
+}
+
+static PyObject * hash_reconfigure(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  counting->reconfigure();
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyObject * hash_n_occupied(PyObject * self, PyObject * args)
 {
   khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
@@ -1474,9 +1622,10 @@ static PyObject * hash_consume_fasta(PyObject * self, PyObject * args)
   char * filename;
   khmer::HashIntoType lower_bound = 0, upper_bound = 0;
   PyObject * callback_obj = NULL;
+  unsigned int number_of_workers = 0;
 
-  if (!PyArg_ParseTuple(args, "s|iiO", &filename, &lower_bound, &upper_bound,
-			&callback_obj)) {
+  if (!PyArg_ParseTuple(args, "s|iiOI", &filename, &lower_bound, &upper_bound,
+			&callback_obj, &number_of_workers)) {
     return NULL;
   }
 
@@ -1486,9 +1635,104 @@ static PyObject * hash_consume_fasta(PyObject * self, PyObject * args)
   try {
     counting->consume_fasta(filename, total_reads, n_consumed,
 			     lower_bound, upper_bound, 
-			     _report_fn, callback_obj);
+			     _report_fn, callback_obj, number_of_workers);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * hash_consume_fasta_checkpointed(PyObject * self,
+						  PyObject * args)
+{
+  khmer_KCountingHashObject * me  = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting  = me->counting;
+
+  char * filename;
+  char * checkpoint_prefix;
+  unsigned long long checkpoint_interval;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "ssK|O", &filename, &checkpoint_prefix,
+			&checkpoint_interval, &callback_obj)) {
+    return NULL;
+  }
+
+  if (dynamic_cast<khmer::BlockedCountingHash *>(counting) ||
+      dynamic_cast<khmer::PackedCountingHash *>(counting)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "only 8-bit, unblocked counting hashes can be checkpointed");
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+  unsigned long long  n_consumed    = 0;
+  unsigned int	      total_reads   = 0;
+  try {
+    counting->consume_fasta_checkpointed(filename, checkpoint_prefix,
+					 checkpoint_interval,
+					 total_reads, n_consumed,
+					 _report_fn, callback_obj);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  } catch (khmer::InvalidCheckpoint &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * hash_resume_consume_fasta(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me  = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting  = me->counting;
+
+  char * checkpoint_prefix;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|O", &checkpoint_prefix, &callback_obj)) {
+    return NULL;
+  }
+
+  if (dynamic_cast<khmer::BlockedCountingHash *>(counting) ||
+      dynamic_cast<khmer::PackedCountingHash *>(counting)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "only 8-bit, unblocked counting hashes can be checkpointed");
+    return NULL;
+  }
+
+  khmer::CheckpointInfo info;
+  try {
+    info.load(checkpoint_prefix);
+  } catch (khmer::InvalidCheckpoint &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+  if (info.tag) {
+    PyErr_SetString(PyExc_ValueError,
+		    "a consume_fasta_and_tag checkpoint needs a hashbits");
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+  unsigned long long  n_consumed    = 0;
+  unsigned int	      total_reads   = 0;
+  try {
+    counting->resume_consume_fasta(checkpoint_prefix, total_reads, n_consumed,
+				   _report_fn, callback_obj);
   } catch (_khmer_signal &e) {
     return NULL;
+  } catch (khmer::InvalidCheckpoint &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
   }
 
   return Py_BuildValue("iL", total_reads, n_consumed);
@@ -1620,6 +1864,173 @@ static PyObject * hash_get_kadian_count(PyObject * self, PyObject * args)
   return Py_BuildValue("i", kad);
 }
 
+// copy a list, or other sequence, of strings into seqs; returns false,
+// with the exception set, if it is not one.
+static bool _get_string_list(PyObject * obj, std::vector<std::string> &seqs)
+{
+  PyObject * fast = PySequence_Fast(obj, "expected a list of sequences");
+  if (!fast) {
+    return false;
+  }
+
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(fast);
+  seqs.resize(n);
+  for (Py_ssize_t i = 0; i < n; i++) {
+    PyObject * item = PySequence_Fast_GET_ITEM(fast, i);
+    char * buf;
+    Py_ssize_t len;
+
+    if (PyString_AsStringAndSize(item, &buf, &len) < 0) {
+      Py_DECREF(fast);
+      return false;
+    }
+    seqs[i].assign(buf, len);
+  }
+
+  Py_DECREF(fast);
+  return true;
+}
+
+static PyObject * hash_get_median_count_many(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  PyObject * seq_list;
+  std::vector<std::string> seqs;
+
+  if (!PyArg_ParseTuple(args, "O", &seq_list)) {
+    return NULL;
+  }
+  if (!_get_string_list(seq_list, seqs)) {
+    return NULL;
+  }
+
+  std::vector<khmer::BoundedCounterType> medians;
+  std::vector<float> averages, stddevs;
+
+  Py_BEGIN_ALLOW_THREADS
+  counting->get_median_count_many(seqs, medians, averages, stddevs);
+  Py_END_ALLOW_THREADS
+
+  PyObject * x = PyList_New(seqs.size());
+  if (x == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < seqs.size(); i++) {
+    PyList_SET_ITEM(x, i, Py_BuildValue("iff", medians[i], averages[i],
+					stddevs[i]));
+  }
+
+  return x;
+}
+
+static PyObject * hash_get_min_count_many(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  PyObject * seq_list;
+  std::vector<std::string> seqs;
+
+  if (!PyArg_ParseTuple(args, "O", &seq_list)) {
+    return NULL;
+  }
+  if (!_get_string_list(seq_list, seqs)) {
+    return NULL;
+  }
+
+  std::vector<khmer::BoundedCounterType> mins;
+
+  Py_BEGIN_ALLOW_THREADS
+  counting->get_min_count_many(seqs, mins);
+  Py_END_ALLOW_THREADS
+
+  PyObject * x = PyList_New(seqs.size());
+  if (x == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < seqs.size(); i++) {
+    PyList_SET_ITEM(x, i, PyInt_FromLong(mins[i]));
+  }
+
+  return x;
+}
+
+static PyObject * hash_median_exceeds(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  char * long_str;
+  unsigned int cutoff;
+
+  if (!PyArg_ParseTuple(args, "sI", &long_str, &cutoff)) {
+    return NULL;
+  }
+
+  if (strlen(long_str) < counting->ksize()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "string length must >= the hashtable k-mer size");
+    return NULL;
+  }
+
+  if (cutoff > MAX_BIGCOUNT) {
+    cutoff = MAX_BIGCOUNT;
+  }
+
+  if (counting->median_exceeds(long_str, cutoff)) {
+    Py_RETURN_TRUE;
+  }
+  Py_RETURN_FALSE;
+}
+
+static PyObject * hash_normalize_by_median(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  char * inputfile = NULL;
+  char * outputfile = NULL;
+  unsigned int cutoff = 0;
+  PyObject * paired_o = NULL;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "ssI|OO", &inputfile, &outputfile, &cutoff,
+			&paired_o, &callback_obj)) {
+    return NULL;
+  }
+
+  bool paired = paired_o && PyObject_IsTrue(paired_o);
+  bool invalid_fasta_file = false;
+  bool signalled = false;
+  unsigned long long n_total = 0, n_kept = 0;
+
+  // the callback takes the GIL back for itself.
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    counting->normalize_by_median(inputfile, outputfile, cutoff, paired,
+				  n_total, n_kept,
+				  callback_obj ? _report_fn_without_gil : NULL,
+				  callback_obj);
+  } catch (khmer:: read_parsers:: InvalidFASTAFileFormat &exc) {
+    invalid_fasta_file = true;
+  } catch (_khmer_signal &e) {
+    signalled = true;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (signalled) {
+    return NULL;
+  }
+  if (invalid_fasta_file) {
+    PyErr_SetString( PyExc_ValueError, "invalid FASTA file" );
+    return NULL;
+  }
+
+  return Py_BuildValue("KK", n_total, n_kept);
+}
+
 static PyObject * hash_get_kmer_abund_mean(PyObject * self, PyObject * args)
 {
   khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
@@ -1724,13 +2135,47 @@ static PyObject * count_trim_on_abundance(PyObject * self, PyObject * args)
 
   return ret;
 }
-static PyObject * count_trim_below_abundance(PyObject * self, PyObject * args)
+static PyObject * count_trim_on_abundance_many(PyObject * self,
+					       PyObject * args)
 {
   khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
   khmer::CountingHash * counting = me->counting;
 
-  char * seq = NULL;
-  unsigned int max_count_i = 0;
+  PyObject * seq_list;
+  unsigned int min_count_i = 0;
+  std::vector<std::string> seqs;
+
+  if (!PyArg_ParseTuple(args, "OI", &seq_list, &min_count_i)) {
+    return NULL;
+  }
+  if (!_get_string_list(seq_list, seqs)) {
+    return NULL;
+  }
+
+  std::vector<unsigned int> trim_at;
+
+  Py_BEGIN_ALLOW_THREADS
+  counting->trim_on_abundance_many(seqs, min_count_i, trim_at);
+  Py_END_ALLOW_THREADS
+
+  PyObject * x = PyList_New(seqs.size());
+  if (x == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < seqs.size(); i++) {
+    PyList_SET_ITEM(x, i, PyInt_FromLong(trim_at[i]));
+  }
+
+  return x;
+}
+
+static PyObject * count_trim_below_abundance(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  char * seq = NULL;
+  unsigned int max_count_i = 0;
 
   if (!PyArg_ParseTuple(args, "sI", &seq, &max_count_i)) {
     return NULL;
@@ -1772,8 +2217,12 @@ static PyObject * hash_abundance_distribution(PyObject * self, PyObject * args)
 
 
   khmer::HashIntoType * dist;
-  dist = counting->abundance_distribution(filename, hashbits,
-					  _report_fn, callback_obj);
+  try {
+    dist = counting->abundance_distribution(filename, hashbits,
+					    _report_fn, callback_obj);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  }
   
   PyObject * x = PyList_New(MAX_BIGCOUNT + 1);
   for (int i = 0; i < MAX_BIGCOUNT + 1; i++) {
@@ -1785,6 +2234,28 @@ static PyObject * hash_abundance_distribution(PyObject * self, PyObject * args)
   return x;
 }
 
+static PyObject * hash_bin_abundance_distribution(PyObject * self,
+						  PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  khmer::HashIntoType * dist = counting->bin_abundance_distribution();
+  
+  PyObject * x = PyList_New(MAX_BIGCOUNT + 1);
+  for (int i = 0; i < MAX_BIGCOUNT + 1; i++) {
+    PyList_SET_ITEM(x, i, PyInt_FromLong(dist[i]));
+  }
+
+  delete[] dist;
+
+  return x;
+}
+
 static PyObject * hash_fasta_count_kmers_by_position(PyObject * self, PyObject * args)
 {
   khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
@@ -1904,7 +2375,133 @@ static PyObject * hash_load(PyObject * self, PyObject * args)
     return NULL;
   }
 
-  counting->load(filename);
+  try {
+    counting->load(filename);
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hash_load_mapped(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  char * filename = NULL;
+  PyObject * shared_o = NULL;
+  PyObject * populate_o = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|OO", &filename, &shared_o, &populate_o)) {
+    return NULL;
+  }
+
+  if (khmer::is_gz_filename(filename)) {
+    PyErr_SetString(PyExc_ValueError, "cannot map a gzipped table");
+    return NULL;
+  }
+  if (dynamic_cast<khmer::BlockedCountingHash *>(counting) ||
+      dynamic_cast<khmer::PackedCountingHash *>(counting)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "only 8-bit, unblocked counting hashes can be mapped");
+    return NULL;
+  }
+  if (khmer::get_saved_ht_type(filename) != SAVED_COUNTING_HT) {
+    PyErr_SetString(PyExc_ValueError, "not a saved counting hash");
+    return NULL;
+  }
+
+  bool shared = shared_o && PyObject_IsTrue(shared_o);
+  bool populate = populate_o && PyObject_IsTrue(populate_o);
+
+  try {
+    counting->load_mapped(filename, shared, populate);
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hash_is_mapped(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  if (counting->is_mapped()) {
+    Py_RETURN_TRUE;
+  }
+  Py_RETURN_FALSE;
+}
+
+static PyObject * hash_save_sparse(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  char * filename = NULL;
+
+  if (!PyArg_ParseTuple(args, "s", &filename)) {
+    return NULL;
+  }
+
+  if (dynamic_cast<khmer::BlockedCountingHash *>(counting) ||
+      dynamic_cast<khmer::PackedCountingHash *>(counting)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "only 8-bit, unblocked counting hashes can be saved sparse");
+    return NULL;
+  }
+
+  counting->save_sparse(filename);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hash_merge(PyObject * self, PyObject * args)
+{
+  khmer_KCountingHashObject * me = (khmer_KCountingHashObject *) self;
+  khmer::CountingHash * counting = me->counting;
+
+  PyObject * other_o = NULL;
+
+  if (!PyArg_ParseTuple(args, "O", &other_o)) {
+    return NULL;
+  }
+
+  if (other_o->ob_type != self->ob_type) {
+    PyErr_SetString(PyExc_TypeError, "can only merge a counting hash");
+    return NULL;
+  }
+  khmer::CountingHash * other = ((khmer_KCountingHashObject *) other_o)->counting;
+
+  if (dynamic_cast<khmer::BlockedCountingHash *>(counting) ||
+      dynamic_cast<khmer::PackedCountingHash *>(counting) ||
+      dynamic_cast<khmer::BlockedCountingHash *>(other) ||
+      dynamic_cast<khmer::PackedCountingHash *>(other)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "only 8-bit, unblocked counting hashes can be merged");
+    return NULL;
+  }
+  if (!counting->can_merge(*other)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "counting hashes differ in k, table sizes, seeds or "
+		    "count thresholds");
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  counting->merge(*other);
+  Py_END_ALLOW_THREADS
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -1921,7 +2518,12 @@ static PyObject * hash_save(PyObject * self, PyObject * args)
     return NULL;
   }
 
-  counting->save(filename);
+  try {
+    counting->save(filename);
+  } catch (khmer::TableFileWriteError &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -1969,11 +2571,18 @@ static PyMethodDef khmer_counting_methods[] = {
   { "hashsizes", hash_get_hashsizes, METH_VARARGS, "" },
   { "set_use_bigcount", hash_set_use_bigcount, METH_VARARGS, "" },
   { "get_use_bigcount", hash_get_use_bigcount, METH_VARARGS, "" },
+  { "set_use_conservative", hash_set_use_conservative, METH_VARARGS, "Raise only the minimal counters when counting a k-mer" },
+  { "get_use_conservative", hash_get_use_conservative, METH_VARARGS, "" },
+  { "set_hash_seed", hash_set_hash_seed, METH_VARARGS, "Use an independent seeded hash function per table" },
+  { "table_seeds", hash_get_table_seeds, METH_VARARGS, "Get the per-table hash seeds, if any" },
+  { "reconfigure", hash_reconfigure, METH_VARARGS, "Re-read the count saturation thresholds from the active config" },
   { "n_occupied", hash_n_occupied, METH_VARARGS, "Count the number of occupied bins" },
   { "n_entries", hash_n_entries, METH_VARARGS, "" },
   { "count", hash_count, METH_VARARGS, "Count the given kmer" },
   { "consume", hash_consume, METH_VARARGS, "Count all k-mers in the given string" },
   { "consume_fasta", hash_consume_fasta, METH_VARARGS, "Count all k-mers in a given file" },
+  { "consume_fasta_checkpointed", hash_consume_fasta_checkpointed, METH_VARARGS, "Count all k-mers in a given file, checkpointing the tables every so many reads" },
+  { "resume_consume_fasta", hash_resume_consume_fasta, METH_VARARGS, "Load the last checkpoint under a prefix, and finish counting its file" },
   { "fasta_file_to_minmax", hash_fasta_file_to_minmax, METH_VARARGS, "" },
   { "filter_fasta_file_limit_n", hash_filter_fasta_file_limit_n, METH_VARARGS, "" },
   { "filter_fasta_file_any", hash_filter_fasta_file_any, METH_VARARGS, "" },
@@ -1983,16 +2592,26 @@ static PyMethodDef khmer_counting_methods[] = {
   { "get", hash_get, METH_VARARGS, "Get the count for the given k-mer" },
   { "max_hamming1_count", hash_max_hamming1_count, METH_VARARGS, "Get the count for the given k-mer" },
   { "get_min_count", hash_get_min_count, METH_VARARGS, "Get the smallest count of all the k-mers in the string" },
+  { "get_min_count_many", hash_get_min_count_many, METH_VARARGS, "Get the smallest k-mer count of each string in a list" },
   { "get_max_count", hash_get_max_count, METH_VARARGS, "Get the largest count of all the k-mers in the string" },
   { "get_median_count", hash_get_median_count, METH_VARARGS, "Get the median, average, and stddev of the k-mer counts in the string" },
+  { "get_median_count_many", hash_get_median_count_many, METH_VARARGS, "Get the (median, average, stddev) of the k-mer counts of each string in a list" },
   { "get_kadian_count", hash_get_kadian_count, METH_VARARGS, "Get the kadian (abundance of k-th rank-ordered k-mer) of the k-mer counts in the string" },
+  { "median_exceeds", hash_median_exceeds, METH_VARARGS, "Whether the median of the k-mer counts in the string is above the given cutoff" },
+  { "normalize_by_median", hash_normalize_by_median, METH_VARARGS, "Write the reads of a file whose median k-mer count is below a cutoff, and count them; returns (n_total, n_kept). The callback gets (info, n_total, n_kept) after each batch." },
   { "trim_on_abundance", count_trim_on_abundance, METH_VARARGS, "Trim on >= abundance" },
+  { "trim_on_abundance_many", count_trim_on_abundance_many, METH_VARARGS, "Find the trim_on_abundance positions for a list of sequences" },
   { "trim_below_abundance", count_trim_below_abundance, METH_VARARGS, "Trim on >= abundance" },
   { "abundance_distribution", hash_abundance_distribution, METH_VARARGS, "" },
+  { "bin_abundance_distribution", hash_bin_abundance_distribution, METH_VARARGS, "Estimate the k-mer abundance distribution from the table's bins" },
   { "fasta_count_kmers_by_position", hash_fasta_count_kmers_by_position, METH_VARARGS, "" },
   { "fasta_dump_kmers_by_abundance", hash_fasta_dump_kmers_by_abundance, METH_VARARGS, "" },
   { "load", hash_load, METH_VARARGS, "" },
+  { "load_mapped", hash_load_mapped, METH_VARARGS, "Load an uncompressed saved table by mapping it into memory; optionally shared (writes go to the file) and populated up front" },
+  { "is_mapped", hash_is_mapped, METH_VARARGS, "Whether the tables are mapped from a file" },
   { "save", hash_save, METH_VARARGS, "" },
+  { "save_sparse", hash_save_sparse, METH_VARARGS, "Save the table in the sparse format, which load reads back" },
+  { "merge", hash_merge, METH_VARARGS, "Add the counts of another counting hash of the same shape into this one" },
   { "get_kmer_abund_abs_deviation", hash_get_kmer_abund_abs_deviation, METH_VARARGS, "" },
   { "get_kmer_abund_mean", hash_get_kmer_abund_mean, METH_VARARGS, "" },
   { "collect_high_abundance_kmers", hash_collect_high_abundance_kmers,
@@ -2046,6 +2665,10 @@ static PyObject* new_hashtable(PyObject * self, PyObject * args)
     return NULL;
   }
 
+  if (!_check_ksize(k)) {
+    return NULL;
+  }
+
   khmer_KCountingHashObject * kcounting_obj = (khmer_KCountingHashObject *) \
     PyObject_New(khmer_KCountingHashObject, &khmer_KCountingHashType);
 
@@ -2062,8 +2685,25 @@ static PyObject* _new_counting_hash(PyObject * self, PyObject * args)
 {
   unsigned int k = 0;
   PyObject* sizes_list_o = NULL;
+  int blocked = 0;
+  unsigned int counter_bits = 8;
+
+  if (!PyArg_ParseTuple(args, "IO|iI", &k, &sizes_list_o, &blocked,
+			&counter_bits)) {
+    return NULL;
+  }
+
+  if (!_check_ksize(k)) {
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(args, "IO", &k, &sizes_list_o)) {
+  if (!khmer::PackedCountingHash::is_valid_counter_bits(counter_bits)) {
+    PyErr_SetString(PyExc_ValueError, "counter_bits must be 4, 8 or 16");
+    return NULL;
+  }
+  if (blocked && counter_bits != 8) {
+    PyErr_SetString(PyExc_ValueError,
+		    "blocked counting tables have 8-bit counters");
     return NULL;
   }
 
@@ -2083,7 +2723,14 @@ static PyObject* _new_counting_hash(PyObject * self, PyObject * args)
   khmer_KCountingHashObject * kcounting_obj = (khmer_KCountingHashObject *) \
     PyObject_New(khmer_KCountingHashObject, &khmer_KCountingHashType);
 
-  kcounting_obj->counting = new khmer::CountingHash(k, sizes);
+  if (blocked) {
+    kcounting_obj->counting = new khmer::BlockedCountingHash(k, sizes);
+  } else if (counter_bits != 8) {
+    kcounting_obj->counting = new khmer::PackedCountingHash(k, sizes,
+							    counter_bits);
+  } else {
+    kcounting_obj->counting = new khmer::CountingHash(k, sizes);
+  }
 
   return (PyObject *) kcounting_obj;
 }
@@ -2183,6 +2830,42 @@ static PyObject * hashbits_count_overlap(PyObject * self, PyObject * args)
   return Py_BuildValue("LLO", n, n_overlap,x);
 }
 
+static PyObject * hashbits_set_hash_seed(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  unsigned long long seed = 0;
+
+  if (!PyArg_ParseTuple(args, "K", &seed)) {
+    return NULL;
+  }
+
+  hashbits->set_hash_seed(seed);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hashbits_get_table_seeds(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  std::vector<khmer::HashIntoType> seeds = hashbits->get_table_seeds();
+
+  PyObject * x = PyList_New(seeds.size());
+  for (unsigned int i = 0; i < seeds.size(); i++) {
+    PyList_SET_ITEM(x, i, PyLong_FromUnsignedLongLong(seeds[i]));
+  }
+
+  return x;
+}
+
 static PyObject * hashbits_n_occupied(PyObject * self, PyObject * args)
 {
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
@@ -2204,6 +2887,10 @@ static PyObject * hashbits_n_tags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   if (!PyArg_ParseTuple(args, "")) {
     return NULL;
   }
@@ -2262,6 +2949,10 @@ static PyObject * hashbits_print_stop_tags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
@@ -2279,6 +2970,10 @@ static PyObject * hashbits_print_tagset(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
@@ -2296,6 +2991,10 @@ static PyObject * hashbits_load_stop_tags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
   PyObject * clear_tags_o = NULL;
 
@@ -2318,6 +3017,10 @@ static PyObject * hashbits_save_stop_tags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
@@ -2335,6 +3038,10 @@ static PyObject * hashbits_traverse_from_tags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   PyObject * counting_o = NULL;
   unsigned int distance, threshold, frequency;
 
@@ -2355,6 +3062,10 @@ static PyObject * hashbits_repartition_largest_partition(PyObject * self, PyObje
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   PyObject * counting_o = NULL;
   PyObject * subset_o = NULL;
   unsigned int distance, threshold, frequency;
@@ -2382,6 +3093,10 @@ static PyObject * hashbits_hitraverse_to_stoptags(PyObject * self, PyObject * ar
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   PyObject * counting_o = NULL;
   unsigned int cutoff = 0;
   char * filename = NULL;
@@ -2427,6 +3142,10 @@ static PyObject * hashbits_calc_connected_graph_size(PyObject * self, PyObject *
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * _kmer;
   unsigned int max_size = 0;
   PyObject * break_on_circum_o = NULL;
@@ -2455,6 +3174,10 @@ static PyObject * hashbits_kmer_degree(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer_s = NULL;
   PyObject * callback_obj = NULL;
 
@@ -2470,6 +3193,10 @@ static PyObject * hashbits_trim_on_degree(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * seq = NULL;
   unsigned int max_degree = 0;
 
@@ -2496,6 +3223,10 @@ static PyObject * hashbits_trim_on_sodd(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * seq = NULL;
   unsigned int max_sodd = 0;
 
@@ -2522,6 +3253,10 @@ static PyObject * hashbits_trim_on_stoptags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * seq = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &seq)) {
@@ -2547,6 +3282,10 @@ static PyObject * hashbits_identify_stoptags_by_position(PyObject * self, PyObje
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * seq = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &seq)) {
@@ -2580,6 +3319,10 @@ static PyObject * hashbits_do_subset_partition(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   PyObject * callback_obj = NULL;
   khmer::HashIntoType start_kmer = 0, end_kmer = 0;
   PyObject * break_on_stop_tags_o = NULL;
@@ -2621,6 +3364,10 @@ static PyObject * hashbits_join_partitions_by_path(PyObject * self, PyObject *ar
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * sequence = NULL;
   if (!PyArg_ParseTuple(args, "s", &sequence)) {
     return NULL;
@@ -2637,6 +3384,10 @@ static PyObject * hashbits_merge_subset(PyObject * self, PyObject *args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   PyObject * subset_obj;
   if (!PyArg_ParseTuple(args, "O", &subset_obj)) {
     return NULL;
@@ -2660,6 +3411,10 @@ static PyObject * hashbits_merge_from_disk(PyObject * self, PyObject *args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
   if (!PyArg_ParseTuple(args, "s", &filename)) {
     return NULL;
@@ -2679,9 +3434,10 @@ static PyObject * hashbits_consume_fasta(PyObject * self, PyObject * args)
   char * filename;
   khmer::HashIntoType lower_bound = 0, upper_bound = 0;
   PyObject * callback_obj = NULL;
+  unsigned int number_of_workers = 0;
 
-  if (!PyArg_ParseTuple(args, "s|iiO", &filename, &lower_bound, &upper_bound,
-			&callback_obj)) {
+  if (!PyArg_ParseTuple(args, "s|iiOI", &filename, &lower_bound, &upper_bound,
+			&callback_obj, &number_of_workers)) {
     return NULL;
   }
 
@@ -2693,7 +3449,7 @@ static PyObject * hashbits_consume_fasta(PyObject * self, PyObject * args)
   try {
     hashbits->consume_fasta(filename, total_reads, n_consumed,
 			     lower_bound, upper_bound, 
-			     _report_fn, callback_obj);
+			     _report_fn, callback_obj, number_of_workers);
   } catch (_khmer_signal &e) {
     return NULL;
   }
@@ -2706,6 +3462,10 @@ static PyObject * hashbits_traverse_from_reads(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename;
   unsigned int radius, big_threshold, transfer_threshold;
   PyObject * counting_o = NULL;
@@ -2731,6 +3491,10 @@ static PyObject * hashbits_consume_fasta_and_traverse(PyObject * self, PyObject
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename;
   unsigned int radius, big_threshold, transfer_threshold;
   PyObject * counting_o = NULL;
@@ -2761,6 +3525,10 @@ static PyObject * hashbits_consume_fasta_and_tag(PyObject * self, PyObject * arg
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename;
   PyObject * callback_obj = NULL;
 
@@ -2783,27 +3551,141 @@ static PyObject * hashbits_consume_fasta_and_tag(PyObject * self, PyObject * arg
   return Py_BuildValue("iL", total_reads, n_consumed);
 }
 
-static PyObject * hashbits_consume_fasta_and_tag_with_stoptags(PyObject * self, PyObject * args)
+// consume_fasta_checkpointed, and consume_fasta_and_tag_checkpointed.
+static PyObject * _hashbits_consume_checkpointed(PyObject * self,
+						 PyObject * args, bool tag)
 {
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
   char * filename;
+  char * checkpoint_prefix;
+  unsigned long long checkpoint_interval;
   PyObject * callback_obj = NULL;
 
-  if (!PyArg_ParseTuple(args, "s|O", &filename, &callback_obj)) {
+  if (!PyArg_ParseTuple(args, "ssK|O", &filename, &checkpoint_prefix,
+			&checkpoint_interval, &callback_obj)) {
+    return NULL;
+  }
+
+  if (dynamic_cast<khmer::BlockedHashbits *>(hashbits)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "blocked hashbits tables cannot be checkpointed");
+    return NULL;
+  }
+
+  if (tag && !_check_graph_ksize(hashbits)) {
     return NULL;
   }
 
   // call the C++ function, and trap signals => Python
 
-  unsigned long long n_consumed;
-  unsigned int total_reads;
+  unsigned long long n_consumed = 0;
+  unsigned int total_reads = 0;
 
   try {
-    hashbits->consume_fasta_and_tag_with_stoptags(filename,
-						  total_reads, n_consumed,
-						  _report_fn, callback_obj);
+    if (tag) {
+      hashbits->consume_fasta_and_tag_checkpointed(filename,
+						   checkpoint_prefix,
+						   checkpoint_interval,
+						   total_reads, n_consumed,
+						   _report_fn, callback_obj);
+    } else {
+      hashbits->consume_fasta_checkpointed(filename, checkpoint_prefix,
+					   checkpoint_interval,
+					   total_reads, n_consumed,
+					   _report_fn, callback_obj);
+    }
+  } catch (_khmer_signal &e) {
+    return NULL;
+  } catch (khmer::InvalidCheckpoint &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * hashbits_consume_fasta_checkpointed(PyObject * self,
+						      PyObject * args)
+{
+  return _hashbits_consume_checkpointed(self, args, false);
+}
+
+static PyObject * hashbits_consume_fasta_and_tag_checkpointed(PyObject * self,
+							      PyObject * args)
+{
+  return _hashbits_consume_checkpointed(self, args, true);
+}
+
+static PyObject * hashbits_resume_consume_fasta(PyObject * self,
+						PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  char * checkpoint_prefix;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|O", &checkpoint_prefix, &callback_obj)) {
+    return NULL;
+  }
+
+  if (dynamic_cast<khmer::BlockedHashbits *>(hashbits)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "blocked hashbits tables cannot be checkpointed");
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+
+  unsigned long long n_consumed = 0;
+  unsigned int total_reads = 0;
+
+  try {
+    hashbits->resume_consume_fasta(checkpoint_prefix, total_reads, n_consumed,
+				   _report_fn, callback_obj);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  } catch (khmer::InvalidCheckpoint &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * hashbits_consume_fasta_and_tag_with_stoptags(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
+  char * filename;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|O", &filename, &callback_obj)) {
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+
+  unsigned long long n_consumed;
+  unsigned int total_reads;
+
+  try {
+    hashbits->consume_fasta_and_tag_with_stoptags(filename,
+						  total_reads, n_consumed,
+						  _report_fn, callback_obj);
   } catch (_khmer_signal &e) {
     return NULL;
   }
@@ -2816,6 +3698,10 @@ static PyObject * hashbits_consume_partitioned_fasta(PyObject * self, PyObject *
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename;
   PyObject * callback_obj = NULL;
 
@@ -2849,6 +3735,10 @@ static PyObject * hashbits_find_all_tags(PyObject * self, PyObject *args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer_s = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &kmer_s)) {
@@ -2881,6 +3771,10 @@ static PyObject * hashbits_assign_partition_id(PyObject * self, PyObject *args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   PyObject * ppi_obj;
   if (!PyArg_ParseTuple(args, "O", &ppi_obj)) {
     return NULL;
@@ -2905,6 +3799,10 @@ static PyObject * hashbits_add_tag(PyObject * self, PyObject *args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer_s = NULL;
   if (!PyArg_ParseTuple(args, "s", &kmer_s)) {
     return NULL;
@@ -2922,6 +3820,10 @@ static PyObject * hashbits_add_stop_tag(PyObject * self, PyObject *args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer_s = NULL;
   if (!PyArg_ParseTuple(args, "s", &kmer_s)) {
     return NULL;
@@ -2939,6 +3841,10 @@ static PyObject * hashbits_get_stop_tags(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   if (!PyArg_ParseTuple(args, "")) {
     return NULL;
   }
@@ -2963,6 +3869,10 @@ static PyObject * hashbits_get_tagset(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   if (!PyArg_ParseTuple(args, "")) {
     return NULL;
   }
@@ -2986,6 +3896,10 @@ static PyObject * hashbits_output_partitions(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
   char * output = NULL;
   PyObject * callback_obj = NULL;
@@ -3023,6 +3937,10 @@ static PyObject * hashbits_find_unpart(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
   PyObject * traverse_o = NULL;
   PyObject * stop_big_traversals_o = NULL;
@@ -3080,6 +3998,10 @@ static PyObject * hashbits_save_partitionmap(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
@@ -3097,6 +4019,10 @@ static PyObject * hashbits_load_partitionmap(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
@@ -3114,6 +4040,10 @@ static PyObject * hashbits__validate_partitionmap(PyObject * self, PyObject * ar
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   if (!PyArg_ParseTuple(args, "")) {
     return NULL;
   }
@@ -3129,6 +4059,10 @@ static PyObject * hashbits_count_partitions(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   if (!PyArg_ParseTuple(args, "")) {
     return NULL;
   }
@@ -3197,7 +4131,127 @@ static PyObject * hashbits_load(PyObject * self, PyObject * args)
     return NULL;
   }
 
-  hashbits->load(filename);
+  try {
+    hashbits->load(filename);
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hashbits_load_mapped(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  char * filename = NULL;
+  PyObject * shared_o = NULL;
+  PyObject * populate_o = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|OO", &filename, &shared_o, &populate_o)) {
+    return NULL;
+  }
+
+  if (khmer::is_gz_filename(filename)) {
+    PyErr_SetString(PyExc_ValueError, "cannot map a gzipped table");
+    return NULL;
+  }
+  if (dynamic_cast<khmer::BlockedHashbits *>(hashbits)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "blocked hashbits tables cannot be mapped");
+    return NULL;
+  }
+  if (khmer::get_saved_ht_type(filename) != SAVED_HASHBITS) {
+    PyErr_SetString(PyExc_ValueError, "not a saved hashbits table");
+    return NULL;
+  }
+
+  bool shared = shared_o && PyObject_IsTrue(shared_o);
+  bool populate = populate_o && PyObject_IsTrue(populate_o);
+
+  try {
+    hashbits->load_mapped(filename, shared, populate);
+  } catch (khmer::InvalidTableFile &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hashbits_is_mapped(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  if (hashbits->is_mapped()) {
+    Py_RETURN_TRUE;
+  }
+  Py_RETURN_FALSE;
+}
+
+static PyObject * hashbits_save_sparse(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  char * filename = NULL;
+
+  if (!PyArg_ParseTuple(args, "s", &filename)) {
+    return NULL;
+  }
+
+  if (dynamic_cast<khmer::BlockedHashbits *>(hashbits)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "blocked hashbits cannot be saved sparse");
+    return NULL;
+  }
+
+  hashbits->save_sparse(filename);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hashbits_merge(PyObject * self, PyObject * args)
+{
+  khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
+  khmer::Hashbits * hashbits = me->hashbits;
+
+  PyObject * other_o = NULL;
+
+  if (!PyArg_ParseTuple(args, "O", &other_o)) {
+    return NULL;
+  }
+
+  if (!is_hashbits_obj(other_o)) {
+    PyErr_SetString(PyExc_TypeError, "can only merge a hashbits table");
+    return NULL;
+  }
+  khmer::Hashbits * other = ((khmer_KHashbitsObject *) other_o)->hashbits;
+
+  if (dynamic_cast<khmer::BlockedHashbits *>(hashbits) ||
+      dynamic_cast<khmer::BlockedHashbits *>(other)) {
+    PyErr_SetString(PyExc_ValueError, "blocked hashbits cannot be merged");
+    return NULL;
+  }
+  if (!hashbits->can_merge(*other)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "hashbits tables differ in k, table sizes or seeds");
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  hashbits->merge(*other);
+  Py_END_ALLOW_THREADS
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -3214,7 +4268,12 @@ static PyObject * hashbits_save(PyObject * self, PyObject * args)
     return NULL;
   }
 
-  hashbits->save(filename);
+  try {
+    hashbits->save(filename);
+  } catch (khmer::TableFileWriteError &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -3225,6 +4284,10 @@ static PyObject * hashbits_load_tagset(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
   PyObject * clear_tags_o = NULL;
 
@@ -3247,13 +4310,22 @@ static PyObject * hashbits_save_tagset(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
     return NULL;
   }
 
-  hashbits->save_tagset(filename);
+  try {
+    hashbits->save_tagset(filename);
+  } catch (khmer::TableFileWriteError &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return NULL;
+  }
 
   Py_INCREF(Py_None);
   return Py_None;
@@ -3286,6 +4358,10 @@ static PyObject * hashbits_load_subset_partitionmap(PyObject * self, PyObject *
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * filename = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) {
@@ -3309,6 +4385,10 @@ static PyObject * hashbits__set_tag_density(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   unsigned int d;
   if (!PyArg_ParseTuple(args, "i", &d)) {
     return NULL;
@@ -3325,6 +4405,10 @@ static PyObject * hashbits__get_tag_density(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   if (!PyArg_ParseTuple(args, "")) {
     return NULL;
   }
@@ -3406,6 +4490,10 @@ static PyObject * hashbits_set_partition_id(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer = NULL;
   khmer::PartitionID p = 0;
 
@@ -3424,6 +4512,10 @@ static PyObject * hashbits_join_partitions(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   khmer::PartitionID p1 = 0, p2 = 0;
 
   if (!PyArg_ParseTuple(args, "ii", &p1, &p2)) {
@@ -3440,6 +4532,10 @@ static PyObject * hashbits_get_partition_id(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &kmer)) {
@@ -3457,6 +4553,10 @@ static PyObject * hashbits_is_single_partition(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * seq = NULL;
 
   if (!PyArg_ParseTuple(args, "s", &seq)) {
@@ -3481,6 +4581,10 @@ static PyObject * hashbits_divide_tags_into_subsets(PyObject * self, PyObject *
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   unsigned int subset_size = 0;
 
   if (!PyArg_ParseTuple(args, "i", &subset_size)) {
@@ -3505,6 +4609,10 @@ static PyObject * hashbits_count_kmers_within_radius(PyObject * self, PyObject *
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer = NULL;
   unsigned long radius = 0;
   unsigned long max_count = 0;
@@ -3532,6 +4640,10 @@ static PyObject * hashbits_count_kmers_on_radius(PyObject * self, PyObject * arg
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer = NULL;
   unsigned long radius = 0;
   unsigned long max_volume = 0;
@@ -3558,6 +4670,10 @@ static PyObject * hashbits_trim_on_density_explosion(PyObject * self, PyObject *
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * seq = NULL;
   unsigned long radius = 0;
   unsigned long max_volume = 0;
@@ -3585,6 +4701,10 @@ static PyObject * hashbits_find_radius_for_volume(PyObject * self, PyObject * ar
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * kmer = NULL;
   unsigned long max_count = 0;
   unsigned long max_radius = 0;
@@ -3646,6 +4766,10 @@ static PyObject * hashbits_extract_unique_paths(PyObject * self, PyObject * args
   khmer_KHashbitsObject * me = (khmer_KHashbitsObject *) self;
   khmer::Hashbits * hashbits = me->hashbits;
 
+  if (!_check_graph_ksize(hashbits)) {
+    return NULL;
+  }
+
   char * sequence = NULL;
   unsigned int min_length = 0;
   float min_unique_f = 0;
@@ -3669,6 +4793,8 @@ static PyMethodDef khmer_hashbits_methods[] = {
   { "ksize", hashbits_get_ksize, METH_VARARGS, "" },
   { "hashsizes", hashbits_get_hashsizes, METH_VARARGS, "" },
   { "n_occupied", hashbits_n_occupied, METH_VARARGS, "Count the number of occupied bins" },
+  { "set_hash_seed", hashbits_set_hash_seed, METH_VARARGS, "Use an independent seeded hash function per table" },
+  { "table_seeds", hashbits_get_table_seeds, METH_VARARGS, "Get the per-table hash seeds, if any" },
   { "n_unique_kmers", hashbits_n_unique_kmers,  METH_VARARGS, "Count the number of unique kmers" },
   { "count", hashbits_count, METH_VARARGS, "Count the given kmer" },
   { "count_overlap", hashbits_count_overlap,METH_VARARGS,"Count overlap kmers in two datasets" },
@@ -3696,7 +4822,11 @@ static PyMethodDef khmer_hashbits_methods[] = {
   { "get_stop_tags", hashbits_get_stop_tags, METH_VARARGS, "" },
   { "get_tagset", hashbits_get_tagset, METH_VARARGS, "" },
   { "load", hashbits_load, METH_VARARGS, "" },
+  { "load_mapped", hashbits_load_mapped, METH_VARARGS, "Load an uncompressed saved table by mapping it into memory; optionally shared (writes go to the file) and populated up front" },
+  { "is_mapped", hashbits_is_mapped, METH_VARARGS, "Whether the tables are mapped from a file" },
   { "save", hashbits_save, METH_VARARGS, "" },
+  { "save_sparse", hashbits_save_sparse, METH_VARARGS, "Save the table in the sparse format, which load reads back" },
+  { "merge", hashbits_merge, METH_VARARGS, "OR the bits, and add the tags, of another hashbits table of the same shape into this one" },
   { "load_tagset", hashbits_load_tagset, METH_VARARGS, "" },
   { "save_tagset", hashbits_save_tagset, METH_VARARGS, "" },
   { "n_tags", hashbits_n_tags, METH_VARARGS, "" },
@@ -3708,6 +4838,9 @@ static PyMethodDef khmer_hashbits_methods[] = {
   { "_set_tag_density", hashbits__set_tag_density, METH_VARARGS, "" },
   { "consume_fasta", hashbits_consume_fasta, METH_VARARGS, "Count all k-mers in a given file" },
   { "consume_fasta_and_tag", hashbits_consume_fasta_and_tag, METH_VARARGS, "Count all k-mers in a given file" },
+  { "consume_fasta_checkpointed", hashbits_consume_fasta_checkpointed, METH_VARARGS, "Count all k-mers in a given file, checkpointing the tables every so many reads" },
+  { "consume_fasta_and_tag_checkpointed", hashbits_consume_fasta_and_tag_checkpointed, METH_VARARGS, "Count and tag all k-mers in a given file, checkpointing the tables and tags every so many reads" },
+  { "resume_consume_fasta", hashbits_resume_consume_fasta, METH_VARARGS, "Load the last checkpoint under a prefix, and finish consuming its file" },
   { "traverse_from_reads", hashbits_traverse_from_reads, METH_VARARGS, "" },
   { "consume_fasta_and_traverse", hashbits_consume_fasta_and_traverse, METH_VARARGS, "" },
   { "consume_fasta_and_tag_with_stoptags", hashbits_consume_fasta_and_tag_with_stoptags, METH_VARARGS, "Count all k-mers in a given file" },
@@ -3751,8 +4884,13 @@ static PyObject* _new_hashbits(PyObject * self, PyObject * args)
 {
   unsigned int k = 0;
   PyObject* sizes_list_o = NULL;
+  int blocked = 0;
+
+  if (!PyArg_ParseTuple(args, "IO|i", &k, &sizes_list_o, &blocked)) {
+    return NULL;
+  }
 
-  if (!PyArg_ParseTuple(args, "IO", &k, &sizes_list_o)) {
+  if (!_check_ksize(k)) {
     return NULL;
   }
 
@@ -3765,7 +4903,11 @@ static PyObject* _new_hashbits(PyObject * self, PyObject * args)
   khmer_KHashbitsObject * khashbits_obj = (khmer_KHashbitsObject *) \
     PyObject_New(khmer_KHashbitsObject, &khmer_KHashbitsType);
 
-  khashbits_obj->hashbits = new khmer::Hashbits(k, sizes);
+  if (blocked) {
+    khashbits_obj->hashbits = new khmer::BlockedHashbits(k, sizes);
+  } else {
+    khashbits_obj->hashbits = new khmer::Hashbits(k, sizes);
+  }
 
   return (PyObject *) khashbits_obj;
 }
@@ -3782,6 +4924,11 @@ static PyObject * hash_collect_high_abundance_kmers(PyObject * self, PyObject *
     return NULL;
   }
 
+  // the k-mers are collected as stop tags.
+  if (!_check_graph_ksize(counting)) {
+    return NULL;
+  }
+
   khmer::SeenSet found_kmers;
   counting->collect_high_abundance_kmers(filename, lower_count, upper_count,
 					 found_kmers);
@@ -4268,13 +5415,732 @@ static void khmer_minmax_dealloc(PyObject* self)
 }
 
 
-//////////////////////////////
-// standalone functions
-
-static PyObject * forward_hash(PyObject * self, PyObject * args)
-{
-  char * kmer;
-  int ksize;
+//
+// ShardedCountingHash object
+//
+
+typedef struct {
+  PyObject_HEAD
+  khmer::ShardedCountingHash * sharded;
+} khmer_ShardedCountingHashObject;
+
+static void khmer_sharded_dealloc(PyObject* self);
+static PyObject * khmer_sharded_getattr(PyObject *, char *);
+
+static PyTypeObject khmer_ShardedCountingHashType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "ShardedCountingHash", sizeof(khmer_ShardedCountingHashObject),
+    0,
+    khmer_sharded_dealloc,	/*tp_dealloc*/
+    0,				/*tp_print*/
+    khmer_sharded_getattr,	/*tp_getattr*/
+    0,				/*tp_setattr*/
+    0,				/*tp_compare*/
+    0,				/*tp_repr*/
+    0,				/*tp_as_number*/
+    0,				/*tp_as_sequence*/
+    0,				/*tp_as_mapping*/
+    0,				/*tp_hash */
+    0,				/*tp_call*/
+    0,				/*tp_str*/
+    0,				/*tp_getattro*/
+    0,				/*tp_setattro*/
+    0,				/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,		/*tp_flags*/
+    "sharded counting hash object",           /* tp_doc */
+};
+
+// set a ValueError, and return false, unless i is a shard.
+static bool _check_shard_index(khmer::ShardedCountingHash * sharded,
+			       unsigned int i)
+{
+  if (i >= sharded->n_shards()) {
+    PyErr_SetString(PyExc_ValueError, "no such shard");
+    return false;
+  }
+  return true;
+}
+
+// set a ValueError, and return false, unless every shard is there to query.
+static bool _check_all_shards(khmer::ShardedCountingHash * sharded)
+{
+  if (!sharded->has_all_shards()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "every shard must be consumed or loaded to query counts");
+    return false;
+  }
+  return true;
+}
+
+static PyObject * sharded_ksize(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  return PyInt_FromLong(me->sharded->ksize());
+}
+
+static PyObject * sharded_n_shards(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  return PyInt_FromLong(me->sharded->n_shards());
+}
+
+static PyObject * sharded_get_shard_bounds(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  unsigned int i;
+
+  if (!PyArg_ParseTuple(args, "I", &i)) {
+    return NULL;
+  }
+  if (!_check_shard_index(sharded, i)) {
+    return NULL;
+  }
+
+  khmer::HashIntoType lower, upper;
+  sharded->get_shard_bounds(i, lower, upper);
+
+  return Py_BuildValue("KK", (unsigned long long) lower,
+		       (unsigned long long) upper);
+}
+
+static PyObject * sharded_has_shard(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  unsigned int i;
+
+  if (!PyArg_ParseTuple(args, "I", &i)) {
+    return NULL;
+  }
+  if (!_check_shard_index(sharded, i)) {
+    return NULL;
+  }
+
+  return PyBool_FromLong(sharded->has_shard(i));
+}
+
+static PyObject * sharded_drop_shard(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  unsigned int i;
+
+  if (!PyArg_ParseTuple(args, "I", &i)) {
+    return NULL;
+  }
+  if (!_check_shard_index(sharded, i)) {
+    return NULL;
+  }
+
+  sharded->drop_shard(i);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * sharded_save_shard(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  unsigned int i;
+  char * filename;
+
+  if (!PyArg_ParseTuple(args, "Is", &i, &filename)) {
+    return NULL;
+  }
+  if (!_check_shard_index(sharded, i)) {
+    return NULL;
+  }
+
+  bool write_error = false;
+
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    sharded->save_shard(i, filename);
+  } catch (khmer::TableFileWriteError &e) {
+    write_error = true;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (write_error) {
+    PyErr_SetString(PyExc_IOError, "could not write the table file");
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * sharded_load_shard(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  unsigned int i;
+  char * filename;
+  PyObject * mapped_o = NULL;
+
+  if (!PyArg_ParseTuple(args, "Is|O", &i, &filename, &mapped_o)) {
+    return NULL;
+  }
+  if (!_check_shard_index(sharded, i)) {
+    return NULL;
+  }
+
+  bool mapped = mapped_o && PyObject_IsTrue(mapped_o);
+  bool invalid_table_file = false;
+
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    sharded->load_shard(i, filename, mapped);
+  } catch (khmer::InvalidTableFile &e) {
+    invalid_table_file = true;
+  }
+  Py_END_ALLOW_THREADS
+
+  if (invalid_table_file) {
+    PyErr_SetString(PyExc_IOError, "could not read the table file");
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * sharded_consume_fasta_shard(PyObject * self,
+					      PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  unsigned int i;
+  char * filename;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "Is|O", &i, &filename, &callback_obj)) {
+    return NULL;
+  }
+  if (!_check_shard_index(sharded, i)) {
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+  unsigned long long  n_consumed    = 0;
+  unsigned int	      total_reads   = 0;
+  try {
+    sharded->consume_fasta_shard(i, filename, total_reads, n_consumed,
+				 _report_fn, callback_obj);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * sharded_consume_fasta(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  char * filename;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|O", &filename, &callback_obj)) {
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+  unsigned long long  n_consumed    = 0;
+  unsigned int	      total_reads   = 0;
+  try {
+    sharded->consume_fasta(filename, total_reads, n_consumed,
+			   _report_fn, callback_obj);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * sharded_consume(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  char * long_str;
+
+  if (!PyArg_ParseTuple(args, "s", &long_str)) {
+    return NULL;
+  }
+
+  if (strlen(long_str) < sharded->ksize()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "string length must >= the hashtable k-mer size");
+    return NULL;
+  }
+
+  return PyInt_FromLong(sharded->consume_string(long_str));
+}
+
+static PyObject * sharded_get(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  PyObject * arg;
+
+  if (!PyArg_ParseTuple(args, "O", &arg)) {
+    return NULL;
+  }
+  if (!_check_all_shards(sharded)) {
+    return NULL;
+  }
+
+  unsigned long count = 0;
+
+  if (PyInt_Check(arg) || PyLong_Check(arg)) {
+    count = sharded->get_count(
+      (khmer::HashIntoType) PyLong_AsUnsignedLongLongMask(arg));
+  } else if (PyString_Check(arg)) {
+    std::string s = PyString_AsString(arg);
+    if (s.length() != sharded->ksize()) {
+      PyErr_SetString(PyExc_ValueError,
+		      "k-mer length must equal the hashtable k-mer size");
+      return NULL;
+    }
+    count = sharded->get_count(s.c_str());
+  }
+
+  return PyInt_FromLong(count);
+}
+
+static PyObject * sharded_get_median_count(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  char * long_str;
+
+  if (!PyArg_ParseTuple(args, "s", &long_str)) {
+    return NULL;
+  }
+
+  if (strlen(long_str) < sharded->ksize()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "string length must >= the hashtable k-mer size");
+    return NULL;
+  }
+  if (!_check_all_shards(sharded)) {
+    return NULL;
+  }
+
+  khmer::BoundedCounterType med = 0;
+  float average = 0, stddev = 0;
+
+  sharded->get_median_count(long_str, med, average, stddev);
+
+  return Py_BuildValue("iff", med, average, stddev);
+}
+
+static PyObject * sharded_get_min_count(PyObject * self, PyObject * args)
+{
+  khmer_ShardedCountingHashObject * me =
+    (khmer_ShardedCountingHashObject *) self;
+  khmer::ShardedCountingHash * sharded = me->sharded;
+
+  char * long_str;
+
+  if (!PyArg_ParseTuple(args, "s", &long_str)) {
+    return NULL;
+  }
+
+  if (strlen(long_str) < sharded->ksize()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "string length must >= the hashtable k-mer size");
+    return NULL;
+  }
+  if (!_check_all_shards(sharded)) {
+    return NULL;
+  }
+
+  return PyInt_FromLong(sharded->get_min_count(long_str));
+}
+
+static PyMethodDef khmer_sharded_methods[] = {
+  { "ksize", sharded_ksize, METH_VARARGS, "" },
+  { "n_shards", sharded_n_shards, METH_VARARGS, "" },
+  { "get_shard_bounds", sharded_get_shard_bounds, METH_VARARGS,
+    "Get the [lower, upper) range of k-mer hashes of a shard; an upper bound of 0 is the top of the hash space" },
+  { "has_shard", sharded_has_shard, METH_VARARGS, "" },
+  { "drop_shard", sharded_drop_shard, METH_VARARGS,
+    "Free the counts of a shard" },
+  { "save_shard", sharded_save_shard, METH_VARARGS, "" },
+  { "load_shard", sharded_load_shard, METH_VARARGS,
+    "Load the counts of a shard, or map them, if 'mapped' is true" },
+  { "consume_fasta_shard", sharded_consume_fasta_shard, METH_VARARGS,
+    "Count the k-mers of one shard, in a pass over a FASTA/FASTQ file" },
+  { "consume_fasta", sharded_consume_fasta, METH_VARARGS,
+    "Count the k-mers of every shard, in one pass over a FASTA/FASTQ file" },
+  { "consume", sharded_consume, METH_VARARGS, "" },
+  { "get", sharded_get, METH_VARARGS, "" },
+  { "get_median_count", sharded_get_median_count, METH_VARARGS, "" },
+  { "get_min_count", sharded_get_min_count, METH_VARARGS, "" },
+  {NULL, NULL, 0, NULL}           /* sentinel */
+};
+
+static PyObject *
+khmer_sharded_getattr(PyObject * obj, char * name)
+{
+  return Py_FindMethod(khmer_sharded_methods, obj, name);
+}
+
+//
+// _new_sharded_counting_hash
+//
+
+static PyObject* _new_sharded_counting_hash(PyObject * self, PyObject * args)
+{
+  unsigned int k = 0;
+  PyObject* sizes_list_o = NULL;
+  unsigned int n_shards = 0;
+
+  if (!PyArg_ParseTuple(args, "IOI", &k, &sizes_list_o, &n_shards)) {
+    return NULL;
+  }
+
+  if (!_check_ksize(k)) {
+    return NULL;
+  }
+
+  if (!n_shards) {
+    PyErr_SetString(PyExc_ValueError, "n_shards must be at least 1");
+    return NULL;
+  }
+
+  std::vector<khmer::HashIntoType> sizes;
+  for (int i = 0; i < PyObject_Length(sizes_list_o); i++) {
+    PyObject * size_o = PyList_GET_ITEM(sizes_list_o, i);
+    sizes.push_back(PyLong_AsLongLong(size_o));
+  }
+
+  khmer_ShardedCountingHashObject * sharded_obj =
+    (khmer_ShardedCountingHashObject *)
+    PyObject_New(khmer_ShardedCountingHashObject,
+		 &khmer_ShardedCountingHashType);
+
+  sharded_obj->sharded = new khmer::ShardedCountingHash(k, sizes, n_shards);
+
+  return (PyObject *) sharded_obj;
+}
+
+//
+// khmer_sharded_dealloc -- clean up a sharded counting hash object.
+//
+
+static void khmer_sharded_dealloc(PyObject* self)
+{
+  khmer_ShardedCountingHashObject * obj =
+    (khmer_ShardedCountingHashObject *) self;
+  delete obj->sharded;
+  obj->sharded = NULL;
+
+  PyObject_Del((PyObject *) obj);
+}
+
+//
+// HLLCounter object
+//
+
+typedef struct {
+  PyObject_HEAD
+  khmer::HLLCounter * hll;
+} khmer_HLLCounterObject;
+
+static void khmer_hllcounter_dealloc(PyObject* self);
+static PyObject * khmer_hllcounter_getattr(PyObject *, char *);
+
+static PyTypeObject khmer_HLLCounterType = {
+    PyObject_HEAD_INIT(NULL)
+    0,
+    "HLLCounter", sizeof(khmer_HLLCounterObject),
+    0,
+    khmer_hllcounter_dealloc,	/*tp_dealloc*/
+    0,				/*tp_print*/
+    khmer_hllcounter_getattr,	/*tp_getattr*/
+    0,				/*tp_setattr*/
+    0,				/*tp_compare*/
+    0,				/*tp_repr*/
+    0,				/*tp_as_number*/
+    0,				/*tp_as_sequence*/
+    0,				/*tp_as_mapping*/
+    0,				/*tp_hash */
+    0,				/*tp_call*/
+    0,				/*tp_str*/
+    0,				/*tp_getattro*/
+    0,				/*tp_setattro*/
+    0,				/*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,		/*tp_flags*/
+    "HyperLogLog k-mer cardinality estimator",           /* tp_doc */
+};
+
+#define is_hllcounter_obj(v)  ((v)->ob_type == &khmer_HLLCounterType)
+
+static PyObject * hllcounter_ksize(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  return PyInt_FromLong(me->hll->ksize());
+}
+
+static PyObject * hllcounter_error_rate(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  return PyFloat_FromDouble(me->hll->error_rate());
+}
+
+static PyObject * hllcounter_add(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+  khmer::HLLCounter * hll = me->hll;
+
+  char * kmer;
+
+  if (!PyArg_ParseTuple(args, "s", &kmer)) {
+    return NULL;
+  }
+
+  if (strlen(kmer) != hll->ksize()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "k-mer length must equal the counter's k-mer size");
+    return NULL;
+  }
+
+  hll->add(khmer::_hash(kmer, hll->ksize()));
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hllcounter_consume(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+  khmer::HLLCounter * hll = me->hll;
+
+  char * long_str;
+
+  if (!PyArg_ParseTuple(args, "s", &long_str)) {
+    return NULL;
+  }
+
+  if (strlen(long_str) < hll->ksize()) {
+    PyErr_SetString(PyExc_ValueError,
+		    "string length must >= the counter's k-mer size");
+    return NULL;
+  }
+
+  return PyInt_FromLong(hll->consume_string(long_str));
+}
+
+static PyObject * hllcounter_consume_fasta(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+  khmer::HLLCounter * hll = me->hll;
+
+  char * filename;
+  PyObject * callback_obj = NULL;
+
+  if (!PyArg_ParseTuple(args, "s|O", &filename, &callback_obj)) {
+    return NULL;
+  }
+
+  // call the C++ function, and trap signals => Python
+  unsigned long long  n_consumed    = 0;
+  unsigned int	      total_reads   = 0;
+  try {
+    hll->consume_fasta(filename, total_reads, n_consumed,
+		       _report_fn, callback_obj);
+  } catch (_khmer_signal &e) {
+    return NULL;
+  }
+
+  return Py_BuildValue("iL", total_reads, n_consumed);
+}
+
+static PyObject * hllcounter_estimate_cardinality(PyObject * self,
+						  PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+
+  if (!PyArg_ParseTuple(args, "")) {
+    return NULL;
+  }
+
+  return PyLong_FromUnsignedLongLong(me->hll->estimate_cardinality());
+}
+
+static PyObject * hllcounter_merge(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+  khmer::HLLCounter * hll = me->hll;
+
+  PyObject * other_o;
+
+  if (!PyArg_ParseTuple(args, "O", &other_o)) {
+    return NULL;
+  }
+
+  if (!is_hllcounter_obj(other_o)) {
+    PyErr_SetString(PyExc_TypeError, "argument must be an HLLCounter");
+    return NULL;
+  }
+
+  khmer::HLLCounter * other = ((khmer_HLLCounterObject *) other_o)->hll;
+  if (!hll->can_merge(*other)) {
+    PyErr_SetString(PyExc_ValueError,
+		    "counters must have the same k and number of registers");
+    return NULL;
+  }
+
+  hll->merge(*other);
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+static PyObject * hllcounter_optimal_size(PyObject * self, PyObject * args)
+{
+  khmer_HLLCounterObject * me = (khmer_HLLCounterObject *) self;
+  khmer::HLLCounter * hll = me->hll;
+
+  double fp_rate;
+  unsigned int n_tables = 0;
+
+  if (!PyArg_ParseTuple(args, "d|I", &fp_rate, &n_tables)) {
+    return NULL;
+  }
+
+  if (!(fp_rate > 0 && fp_rate < 1)) {
+    PyErr_SetString(PyExc_ValueError, "fp_rate must be between 0 and 1");
+    return NULL;
+  }
+
+  khmer::HashIntoType tablesize;
+  hll->optimal_size(fp_rate, n_tables, tablesize);
+
+  return Py_BuildValue("IK", n_tables, (unsigned long long) tablesize);
+}
+
+static PyMethodDef khmer_hllcounter_methods[] = {
+  { "ksize", hllcounter_ksize, METH_VARARGS, "" },
+  { "error_rate", hllcounter_error_rate, METH_VARARGS,
+    "Get the relative standard error of the estimate" },
+  { "add", hllcounter_add, METH_VARARGS, "Add a k-mer" },
+  { "consume", hllcounter_consume, METH_VARARGS,
+    "Add every k-mer in a string" },
+  { "consume_fasta", hllcounter_consume_fasta, METH_VARARGS,
+    "Add every k-mer in a FASTA/FASTQ file" },
+  { "estimate_cardinality", hllcounter_estimate_cardinality, METH_VARARGS,
+    "Estimate the number of distinct k-mers added" },
+  { "merge", hllcounter_merge, METH_VARARGS,
+    "Add every k-mer added to another counter" },
+  { "optimal_size", hllcounter_optimal_size, METH_VARARGS,
+    "Get the (n_tables, tablesize) that hold the k-mers at the given false positive rate, for the given number of tables if it is not 0" },
+  {NULL, NULL, 0, NULL}           /* sentinel */
+};
+
+static PyObject *
+khmer_hllcounter_getattr(PyObject * obj, char * name)
+{
+  return Py_FindMethod(khmer_hllcounter_methods, obj, name);
+}
+
+//
+// new_hllcounter
+//
+
+static PyObject* new_hllcounter(PyObject * self, PyObject * args)
+{
+  unsigned int k = 0;
+  unsigned int p = HLL_DEFAULT_P;
+
+  if (!PyArg_ParseTuple(args, "I|I", &k, &p)) {
+    return NULL;
+  }
+
+  if (!_check_ksize(k)) {
+    return NULL;
+  }
+
+  if (p < HLL_MIN_P || p > HLL_MAX_P) {
+    PyErr_SetString(PyExc_ValueError, "p must be from 4 to 18");
+    return NULL;
+  }
+
+  khmer_HLLCounterObject * hll_obj = (khmer_HLLCounterObject *) \
+    PyObject_New(khmer_HLLCounterObject, &khmer_HLLCounterType);
+
+  hll_obj->hll = new khmer::HLLCounter(k, p);
+
+  return (PyObject *) hll_obj;
+}
+
+//
+// khmer_hllcounter_dealloc -- clean up an HLLCounter object.
+//
+
+static void khmer_hllcounter_dealloc(PyObject* self)
+{
+  khmer_HLLCounterObject * obj = (khmer_HLLCounterObject *) self;
+  delete obj->hll;
+  obj->hll = NULL;
+
+  PyObject_Del((PyObject *) obj);
+}
+
+//////////////////////////////
+// standalone functions
+
+static PyObject * forward_hash(PyObject * self, PyObject * args)
+{
+  char * kmer;
+  int ksize;
 
   if (!PyArg_ParseTuple(args, "si", &kmer, &ksize)) {
     return NULL;
@@ -4285,6 +6151,10 @@ static PyObject * forward_hash(PyObject * self, PyObject * args)
     return NULL;
   }
 
+  if (!_check_narrow_ksize(ksize)) {
+    return NULL;
+  }
+
   return PyLong_FromUnsignedLongLong(khmer::_hash(kmer, ksize));
 }
 
@@ -4308,6 +6178,10 @@ static PyObject * forward_hash_no_rc(PyObject * self, PyObject * args)
     return NULL;
   }
 
+  if (!_check_narrow_ksize(ksize)) {
+    return NULL;
+  }
+
   return PyLong_FromUnsignedLongLong(khmer::_hash_forward(kmer, ksize));
 }
 
@@ -4325,9 +6199,24 @@ static PyObject * reverse_hash(PyObject * self, PyObject * args)
     return NULL;
   }
 
+  if (!_check_narrow_ksize(ksize)) {
+    return NULL;
+  }
+
   return PyString_FromString(khmer::_revhash(val, ksize).c_str());
 }
 
+static PyObject * get_saved_ht_type(PyObject * self, PyObject * args)
+{
+  char * filename = NULL;
+
+  if (!PyArg_ParseTuple(args, "s", &filename)) {
+    return NULL;
+  }
+
+  return PyInt_FromLong(khmer::get_saved_ht_type(filename));
+}
+
 static PyObject * set_reporting_callback(PyObject * self, PyObject * args)
 {
   PyObject * o;
@@ -4357,13 +6246,16 @@ static PyMethodDef KhmerMethods[] = {
   { "new_hashtable", new_hashtable, METH_VARARGS, "Create an empty single-table counting hash" },
   { "_new_counting_hash", _new_counting_hash, METH_VARARGS, "Create an empty counting hash" },
   { "_new_hashbits", _new_hashbits, METH_VARARGS, "Create an empty hashbits table" },
+  { "_new_sharded_counting_hash", _new_sharded_counting_hash, METH_VARARGS, "Create an empty counting hash, sharded by k-mer hash" },
   { "new_readmask", new_readmask, METH_VARARGS, "Create a new read mask table" },
   { "new_minmax", new_minmax, METH_VARARGS, "Create a new min/max value table" },
+  { "new_hllcounter", new_hllcounter, METH_VARARGS, "Create a new HyperLogLog k-mer cardinality estimator" },
   { "consume_genome", consume_genome, METH_VARARGS, "Create a new ktable from a genome" },
   { "forward_hash", forward_hash, METH_VARARGS, "", },
   { "forward_hash_no_rc", forward_hash_no_rc, METH_VARARGS, "", },
   { "reverse_hash", reverse_hash, METH_VARARGS, "", },
   { "set_reporting_callback", set_reporting_callback, METH_VARARGS, "" },
+  { "get_saved_ht_type", get_saved_ht_type, METH_VARARGS, "Get the type of a saved table" },
   { NULL, NULL, 0, NULL }
 };
 
@@ -4374,6 +6266,8 @@ DL_EXPORT(void) init_khmer(void)
   khmer_ReadParserType.ob_type	  = &PyType_Type;
   khmer_KTableType.ob_type	  = &PyType_Type;
   khmer_KCountingHashType.ob_type = &PyType_Type;
+  khmer_ShardedCountingHashType.ob_type = &PyType_Type;
+  khmer_HLLCounterType.ob_type = &PyType_Type;
 
   PyObject * m;
   m = Py_InitModule("_khmer", KhmerMethods);
@@ -4382,6 +6276,20 @@ DL_EXPORT(void) init_khmer(void)
   Py_INCREF(KhmerError);
 
   PyModule_AddObject(m, "error", KhmerError);
+
+  Py_INCREF(&khmer_HLLCounterType);
+  PyModule_AddObject(m, "HLLCounter", (PyObject *) &khmer_HLLCounterType);
+
+  PyModule_AddIntConstant(m, "SAVED_COUNTING_HT", SAVED_COUNTING_HT);
+  PyModule_AddIntConstant(m, "SAVED_HASHBITS", SAVED_HASHBITS);
+  PyModule_AddIntConstant(m, "SAVED_BLOCKED_HASHBITS", SAVED_BLOCKED_HASHBITS);
+  PyModule_AddIntConstant(m, "SAVED_BLOCKED_COUNTING_HT",
+			  SAVED_BLOCKED_COUNTING_HT);
+  PyModule_AddIntConstant(m, "SAVED_PACKED_COUNTING_HT",
+			  SAVED_PACKED_COUNTING_HT);
+  PyModule_AddIntConstant(m, "SAVED_SPARSE_COUNTING_HT",
+			  SAVED_SPARSE_COUNTING_HT);
+  PyModule_AddIntConstant(m, "SAVED_SPARSE_HASHBITS", SAVED_SPARSE_HASHBITS);
 }
 
 // vim: set sts=2 sw=2:
@@ -15,8 +15,10 @@ except ImportError: # Cython
     from _khmer import _new_counting_hash as new_hashtable
 from _khmer import _new_counting_hash
 from _khmer import _new_hashbits
+from _khmer import _new_sharded_counting_hash
 from _khmer import new_readmask
 from _khmer import new_minmax
+from _khmer import new_hllcounter, HLLCounter
 #from _khmer import consume_genome
 from _khmer import forward_hash, forward_hash_no_rc, reverse_hash
 from _khmer import set_reporting_callback
@@ -25,25 +27,112 @@ from filter_utils import filter_fasta_file_any, filter_fasta_file_all, filter_fa
 
 ###
 
-def new_hashbits(k, starting_size, n_tables=2):
+# the false positive rate new_hashbits and new_counting_hash size tables
+# for, when they are given an HLLCounter.
+DEFAULT_FP_RATE = 0.05
+
+def _table_shape(starting_size, n_tables, fp_rate):
+    """
+    The (starting_size, n_tables) to build a table of: as given, or, if
+    starting_size is an HLLCounter which has seen the k-mers to be loaded,
+    as it recommends for fp_rate, with n_tables tables if that is given.
+    """
+    if isinstance(starting_size, HLLCounter):
+        n_tables, starting_size = starting_size.optimal_size(fp_rate,
+                                                             n_tables or 0)
+    elif n_tables is None:
+        n_tables = 2
+
+    return starting_size, n_tables
+
+def hllcounter_from_fasta(k, filenames, p=14):
+    """
+    An HLLCounter which has seen every k-mer in the given FASTA/FASTQ
+    files, to size tables for them.
+    """
+    hll = new_hllcounter(k, p)
+    for filename in filenames:
+        hll.consume_fasta(filename)
+
+    return hll
+
+def new_hashbits(k, starting_size, n_tables=None, hash_seed=0, blocked=False,
+                 fp_rate=DEFAULT_FP_RATE):
+    starting_size, n_tables = _table_shape(starting_size, n_tables, fp_rate)
     primes = get_n_primes_above_x(n_tables, starting_size)
     
-    return _new_hashbits(k, primes)
+    ht = _new_hashbits(k, primes, blocked)
+    if hash_seed:
+        ht.set_hash_seed(hash_seed)
+
+    return ht
 
-def new_counting_hash(k, starting_size, n_tables=2):
+def new_counting_hash(k, starting_size, n_tables=None, hash_seed=0,
+                      blocked=False, counter_bits=8, fp_rate=DEFAULT_FP_RATE):
+    starting_size, n_tables = _table_shape(starting_size, n_tables, fp_rate)
     primes = get_n_primes_above_x(n_tables, starting_size)
     
-    return _new_counting_hash(k, primes)
+    ht = _new_counting_hash(k, primes, blocked, counter_bits)
+    if hash_seed:
+        ht.set_hash_seed(hash_seed)
 
-def load_hashbits(filename):
-    ht = _new_hashbits(1, [1])
-    ht.load(filename)
+    return ht
+
+def new_sharded_counting_hash(k, starting_size, n_tables=None, n_shards=4,
+                              fp_rate=DEFAULT_FP_RATE):
+    """
+    Create a counting hash split by k-mer hash into n_shards shards, each
+    of n_tables tables of about starting_size bins, for its share of the
+    k-mers. Count them in one pass with consume_fasta, or a shard at a
+    time with consume_fasta_shard, saving and dropping each to make room
+    for the next; load (or map) them all back to query counts.
+
+    Given an HLLCounter for starting_size, each shard is sized for its
+    share of the k-mers it has seen.
+    """
+    if isinstance(starting_size, HLLCounter):
+        starting_size, n_tables = _table_shape(starting_size, n_tables,
+                                               fp_rate)
+        starting_size = starting_size // n_shards + 1
+    elif n_tables is None:
+        n_tables = 2
+    primes = get_n_primes_above_x(n_tables, starting_size)
+
+    return _new_sharded_counting_hash(k, primes, n_shards)
+
+def load_hashbits(filename, mapped=False, shared=False, populate=False):
+    """
+    Load a saved hashbits table. If mapped, an uncompressed, unblocked
+    table is memory-mapped instead of read in: copy-on-write, or shared
+    with the file and other processes if shared; pages are read in as
+    they are used, or all up front if populate.
+    """
+    blocked = _khmer.get_saved_ht_type(filename) == _khmer.SAVED_BLOCKED_HASHBITS
+    ht = _new_hashbits(1, [1], blocked)
+    if mapped:
+        ht.load_mapped(filename, shared, populate)
+    else:
+        ht.load(filename)
 
     return ht
 
-def load_counting_hash(filename):
-    ht = _new_counting_hash(1, [1])
-    ht.load(filename)
+def load_counting_hash(filename, mapped=False, shared=False, populate=False):
+    """
+    Load a saved counting hash. mapped, shared and populate are as for
+    load_hashbits; only uncompressed tables of 8-bit, unblocked counters
+    can be mapped.
+    """
+    ht_type = _khmer.get_saved_ht_type(filename)
+    if ht_type == _khmer.SAVED_PACKED_COUNTING_HT:
+        # any width will do; load takes the saved one.
+        ht = _new_counting_hash(1, [1], False, 4)
+    else:
+        blocked = ht_type == _khmer.SAVED_BLOCKED_COUNTING_HT
+        ht = _new_counting_hash(1, [1], blocked)
+    if mapped:
+        ht.load_mapped(filename, shared, populate)
+    else:
+        ht.load(filename)
     
     return ht
 
@@ -4,6 +4,7 @@ import argparse
 DEFAULT_K=32
 DEFAULT_N_HT=4
 DEFAULT_MIN_HASHSIZE=1e6
+DEFAULT_FP_RATE=0.05
 
 def build_construct_args():
 
@@ -25,6 +26,19 @@ def build_construct_args():
     parser.add_argument('--hashsize', '-x', type=float, dest='min_hashsize',
                         default=env_hashsize,
                         help='lower bound on hashsize to use')
+    parser.add_argument('--auto-size', '-A', dest='auto_size',
+                        default=False, action='store_true',
+                        help='estimate the number of distinct k-mers in '
+                        'a first pass over the input, and size the '
+                        'tables for it, instead of by --hashsize')
+    parser.add_argument('--fp-rate', type=float, dest='fp_rate',
+                        default=DEFAULT_FP_RATE,
+                        help='false positive rate to size the tables '
+                        'for, with --auto-size')
+    parser.add_argument('--conservative', dest='conservative',
+                        default=False, action='store_true',
+                        help='count with conservative update, which '
+                        'overestimates less for the same hashsize')
 
     return parser
 
@@ -4,6 +4,7 @@ import argparse
 DEFAULT_K=32
 DEFAULT_N_HT=4
 DEFAULT_MIN_HASHSIZE=1e6
+DEFAULT_FP_RATE=0.05
 
 def build_construct_args():
 
@@ -18,12 +19,23 @@ def build_construct_args():
                         action='store_true')
     parser.add_argument('--ksize', '-k', type=int, dest='ksize',
                         default=env_ksize,
-                        help='k-mer size to use')
+                        help='k-mer size to use; up to 64 for counting, '
+                        'but graph, tag and partition operations need '
+                        'k <= 32')
     parser.add_argument('--n_hashes', '-N', type=int, dest='n_hashes',
                         default=env_n_hashes,
                         help='number of hash tables to use')
     parser.add_argument('--hashsize', '-x', type=float, dest='min_hashsize',
                         default=env_hashsize,
                         help='lower bound on hashsize to use')
+    parser.add_argument('--auto-size', '-A', dest='auto_size',
+                        default=False, action='store_true',
+                        help='estimate the number of distinct k-mers in '
+                        'a first pass over the input, and size the '
+                        'tables for it, instead of by --hashsize')
+    parser.add_argument('--fp-rate', type=float, dest='fp_rate',
+                        default=DEFAULT_FP_RATE,
+                        help='false positive rate to size the tables '
+                        'for, with --auto-size')
 
     return parser
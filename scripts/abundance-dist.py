@@ -23,6 +23,11 @@ def main():
     parser.add_argument('-s', '--squash', dest='squash_output', default=False,
                         action='store_true',
                         help='Overwrite output file if it exists')
+    parser.add_argument('-b', '--bins', dest='from_bins', default=False,
+                        action='store_true',
+                        help='Estimate the distribution from the hashtable '
+                        'bins instead of reading datafile; faster, but '
+                        'approximate')
 
     args = parser.parse_args()
     hashfile = args.hashname
@@ -34,7 +39,8 @@ def main():
 
     K = ht.ksize()
     sizes = ht.hashsizes()
-    tracking = khmer._new_hashbits(K, sizes)
+    if not args.from_bins:
+        tracking = khmer._new_hashbits(K, sizes)
 
     print 'K:', K
     print 'HT sizes:', sizes
@@ -48,7 +54,10 @@ def main():
         print '** squashing existing file %s' % histout
 
     print 'preparing hist...'
-    z = ht.abundance_distribution(datafile, tracking)
+    if args.from_bins:
+        z = ht.bin_abundance_distribution()
+    else:
+        z = ht.abundance_distribution(datafile, tracking)
     total = sum(z)
         
     fp = open(histout, 'w')
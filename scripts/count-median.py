@@ -16,6 +16,9 @@ import sys, screed, os
 import khmer
 import argparse
 
+# the number of sequences to look up in each call into the counting hash.
+BATCH_SIZE=10000
+
 ###
 
 def main():
@@ -38,14 +41,26 @@ def main():
     print 'writing to', output_filename
     output = open(output_filename, 'w')
     
+    def write_batch(names, seqs):
+        for name, seq, (a, b, c) in zip(names, seqs,
+                                        ht.get_median_count_many(seqs)):
+            print >>output, name, a, b, c, len(seq)
+
+    names, seqs = [], []
     for record in screed.open(input_filename):
        seq = record.sequence.upper()
        if 'N' in seq:
            seq = seq.replace('N', 'G')
 
        if K <= len(seq):
-           a, b, c = ht.get_median_count(seq)
-           print >>output, record.name, a, b, c, len(seq)
+           names.append(record.name)
+           seqs.append(seq)
+
+       if len(seqs) >= BATCH_SIZE:
+           write_batch(names, seqs)
+           names, seqs = [], []
+
+    write_batch(names, seqs)
 
 if __name__ == '__main__':
     main()
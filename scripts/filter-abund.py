@@ -9,7 +9,7 @@ Use '-h' for parameter help.
 """
 import sys, screed.fasta, os
 import khmer
-from khmer.thread_utils import ThreadedSequenceProcessor, verbose_loader
+from khmer.thread_utils import verbose_loader
 
 from khmer.counting_args import build_counting_multifile_args
 
@@ -17,6 +17,9 @@ from khmer.counting_args import build_counting_multifile_args
 
 DEFAULT_CUTOFF=2
 
+# the number of reads to trim in each call into the counting hash.
+BATCH_SIZE=10000
+
 def main():
     parser = build_counting_multifile_args()
     parser.add_argument('--cutoff', '-C', dest='cutoff',
@@ -35,20 +38,15 @@ def main():
 
     print "K:", K
 
-    ### the filtering function.
-    def process_fn(record):
-        name = record['name']
-        seq = record['sequence']
-        if 'N' in seq:
-            return None, None
-
-        trim_seq, trim_at = ht.trim_on_abundance(seq, args.cutoff)
-
-        if trim_at >= K:
-            return name, trim_seq
-
-        return None, None
-
+    ### trim a batch of reads, keeping those left with at least one k-mer.
+    def filter_batch(records, outfp):
+        seqs = [ record['sequence'] for record in records ]
+        for record, seq, trim_at in zip(records, seqs,
+                                        ht.trim_on_abundance_many(seqs,
+                                                                  args.cutoff)):
+            # reads with Ns trim to nothing.
+            if trim_at >= K:
+                outfp.write('>%s\n%s\n' % (record['name'], seq[:trim_at]))
 
     ### the filtering loop
     for infile in infiles:
@@ -56,8 +54,14 @@ def main():
        outfile = os.path.basename(infile) + '.abundfilt'
        outfp = open(outfile, 'w')
 
-       tsp = ThreadedSequenceProcessor(process_fn)
-       tsp.start(verbose_loader(infile), outfp)
+       batch = []
+       for record in verbose_loader(infile):
+           batch.append(record)
+           if len(batch) >= BATCH_SIZE:
+               filter_batch(batch, outfp)
+               batch = []
+       filter_batch(batch, outfp)
+       outfp.close()
 
        print 'output in', outfile
 
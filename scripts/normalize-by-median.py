@@ -24,12 +24,21 @@ def main():
                         default='')
     parser.add_argument('-R', '--report-to-file', dest='report_file',
                         type=argparse.FileType('w'))
+    parser.add_argument('-p', '--paired', dest='paired', default=False,
+                        action='store_true',
+                        help='Keep or discard the mates of a pair together')
     parser.add_argument('input_filenames', nargs='+')
 
     args = parser.parse_args()
 
+    if args.auto_size and not args.loadhash:
+        hll = khmer.hllcounter_from_fasta(int(args.ksize),
+                                          args.input_filenames)
+        args.min_hashsize = hll.optimal_size(args.fp_rate,
+                                             int(args.n_hashes))[1]
+
     if not args.quiet:
-        if args.min_hashsize == DEFAULT_MIN_HASHSIZE:
+        if args.min_hashsize == DEFAULT_MIN_HASHSIZE and not args.auto_size:
             print>>sys.stderr, "** WARNING: hashsize is default!  You absodefly want to increase this!\n** Please read the docs!"
 
         print>>sys.stderr, '\nPARAMETERS:'
@@ -54,40 +63,40 @@ def main():
     else:
         print 'making hashtable'
         ht = khmer.new_counting_hash(K, HT_SIZE, N_HT)
+    ht.set_use_conservative(args.conservative)
 
     total = 0
     discarded = 0
     for input_filename in filenames:
         output_name = os.path.basename(input_filename) + '.keep'
-        outfp = open(output_name, 'w')
-
-        for n, record in enumerate(screed.open(input_filename)):
-            if n > 0 and n % 100000 == 0:
-                print '... kept', total - discarded, 'of', total, ', or', \
-                    int(100. - discarded / float(total) * 100.), '%'
-                print '... in file', input_filename
-
-                if report_fp:
-                    print>>report_fp, total, total - discarded, \
-                        1. - (discarded / float(total))
-                    report_fp.flush()
-
-            total += 1
-
-            if len(record.sequence) < K:
-                continue
-
-            seq = record.sequence.replace('N', 'A')
-            med, _, _ = ht.get_median_count(seq)
-
-            if med < DESIRED_COVERAGE:
-                ht.consume(seq)
-                outfp.write('>%s\n%s\n' % (record.name, record.sequence))
-            else:
-                discarded += 1
-
-        print 'DONE with', input_filename, '; kept', total - discarded, 'of',\
-            total, 'or', int(100. - discarded / float(total) * 100.), '%'
+        last = [0]
+
+        # called after each batch of reads in this file.
+        def progress(info, n_total, n_kept):
+            if n_total // 100000 == last[0]:
+                return
+            last[0] = n_total // 100000
+
+            so_far = total + n_total
+            so_far_discarded = discarded + n_total - n_kept
+            print '... kept', so_far - so_far_discarded, 'of', so_far, \
+                ', or', int(100. - so_far_discarded / float(so_far) * 100.), \
+                '%'
+            print '... in file', input_filename
+
+            if report_fp:
+                print>>report_fp, so_far, so_far - so_far_discarded, \
+                    1. - (so_far_discarded / float(so_far))
+                report_fp.flush()
+
+        n_total, n_kept = ht.normalize_by_median(input_filename, output_name,
+                                                 DESIRED_COVERAGE, args.paired,
+                                                 progress)
+        total += n_total
+        discarded += n_total - n_kept
+
+        print 'DONE with', input_filename, '; kept', n_kept, 'of',\
+            n_total, 'or', int(100. * n_kept / float(max(n_total, 1))), '%'
         print 'output in', output_name
 
     if args.savehash:
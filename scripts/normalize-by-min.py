@@ -25,8 +25,14 @@ def main():
 
     args = parser.parse_args()
 
+    if args.auto_size and not args.loadhash:
+        hll = khmer.hllcounter_from_fasta(int(args.ksize),
+                                          args.input_filenames)
+        args.min_hashsize = hll.optimal_size(args.fp_rate,
+                                             int(args.n_hashes))[1]
+
     if not args.quiet:
-        if args.min_hashsize == DEFAULT_MIN_HASHSIZE:
+        if args.min_hashsize == DEFAULT_MIN_HASHSIZE and not args.auto_size:
             print>>sys.stderr, "** WARNING: hashsize is default!  You absodefly want to increase this!\n** Please read the docs!"
 
         print>>sys.stderr, '\nPARAMETERS:'
@@ -50,6 +56,7 @@ def main():
     else:
         print 'making hashtable'
         ht = khmer.new_counting_hash(K, HT_SIZE, N_HT)
+    ht.set_use_conservative(args.conservative)
 
     total = 0
     discarded = 0
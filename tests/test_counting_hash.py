@@ -3,6 +3,7 @@ import gzip
 
 import khmer
 import khmer_tst_utils as utils
+import screed
 
 MAX_COUNT=255
 MAX_BIGCOUNT=65535
@@ -161,6 +162,62 @@ def test_simple_median():
     assert average == 2.5
     assert int(stddev*100) == 50        # .5
 
+def test_median_exceeds():
+    # median_exceeds agrees with get_median_count, on every read.
+    inpath = utils.get_test_data('test-reads.fa')
+
+    hi = khmer.new_counting_hash(12, 1e5, 4)
+    hi.consume_fasta(inpath)
+
+    for n, record in enumerate(screed.open(inpath)):
+        if n % 10:
+            continue
+        seq = record.sequence
+        median, _, _ = hi.get_median_count(seq)
+        for cutoff in (0, median - 1, median, median + 1, 255):
+            if cutoff < 0:
+                continue
+            assert hi.median_exceeds(seq, cutoff) == (median > cutoff), \
+                (n, median, cutoff)
+
+    try:
+        hi.median_exceeds('ACGT', 1)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_query_many():
+    # the _many queries agree with the one-read queries, read for read.
+    inpath = utils.get_test_data('test-reads.fa')
+
+    hi = khmer.new_counting_hash(12, 1e5, 4)
+    hi.consume_fasta(inpath)
+
+    seqs = [ record.sequence for record in screed.open(inpath) ]
+    seqs.append('ACGT')                 # shorter than K
+
+    medians = hi.get_median_count_many(seqs)
+    mins = hi.get_min_count_many(seqs)
+    trims = hi.trim_on_abundance_many(seqs, 2)
+    assert len(medians) == len(mins) == len(trims) == len(seqs)
+
+    for i, seq in enumerate(seqs[:-1]):
+        assert medians[i] == hi.get_median_count(seq), i
+        assert mins[i] == hi.get_min_count(seq), i
+        assert trims[i] == hi.trim_on_abundance(seq, 2)[1], i
+
+    assert medians[-1] == (0, 0.0, 0.0)
+    assert mins[-1] == 0
+    assert trims[-1] == 0
+
+    assert hi.get_median_count_many([]) == []
+
+    try:
+        hi.get_min_count_many([ 'ACGTACGTACGTACGT', 5 ])
+        assert 0, "should fail"
+    except TypeError:
+        pass
+
 def test_simple_kadian():
     hi = khmer.new_counting_hash(6, 1e6, 2)
     hi.consume("ACTGCTATCTCTAGAGCTATG")
@@ -332,6 +389,264 @@ def test_save_load_gz():
     assert sum(x) == 3966, sum(x)
     assert x == y, (x,y)
 
+def test_load_mapped():
+    inpath = utils.get_test_data('random-20-a.fa')
+    savepath = utils.get_temp_filename('tempcountingsave4.ht')
+
+    hi = khmer.new_counting_hash(12, 1e5, 4, hash_seed=7)
+    hi.set_use_bigcount(True)
+    hi.consume_fasta(inpath)
+    for i in range(300):
+        hi.count('A' * 12)
+    hi.save(savepath)
+
+    for populate in (False, True):
+        ht = khmer.load_counting_hash(savepath, mapped=True,
+                                      populate=populate)
+        assert ht.is_mapped()
+        assert ht.hashsizes() == hi.hashsizes()
+        assert ht.get('A' * 12) == 300
+
+        for record in screed.open(inpath):
+            seq = record.sequence
+            assert ht.get(seq[:12]) == hi.get(seq[:12])
+            assert ht.get(seq[-12:]) == hi.get(seq[-12:])
+
+    # copy-on-write: counting into the mapping leaves the file alone.
+    kmer = 'ACGTACGTACGT'
+    ht = khmer.load_counting_hash(savepath, mapped=True)
+    ht.count(kmer)
+    assert ht.get(kmer) == hi.get(kmer) + 1
+    assert khmer.load_counting_hash(savepath).get(kmer) == hi.get(kmer)
+
+    # shared: it goes to the file.
+    ht = khmer.load_counting_hash(savepath, mapped=True, shared=True)
+    ht.count(kmer)
+    del ht
+    assert khmer.load_counting_hash(savepath).get(kmer) == hi.get(kmer) + 1
+
+def test_load_mapped_bad():
+    savepath = utils.get_temp_filename('tempcountingsave5.ht.gz')
+    khmer.new_counting_hash(12, 1e5, 4).save(savepath)
+
+    try:
+        khmer.load_counting_hash(savepath, mapped=True)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+    savepath = utils.get_temp_filename('tempcountingsave5.ht')
+    khmer.new_counting_hash(12, 1e5, 4, blocked=True).save(savepath)
+
+    try:
+        khmer.load_counting_hash(savepath, mapped=True)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+    # nor can a plain table be mapped into a blocked or packed one.
+    khmer.new_counting_hash(12, 1e5, 4).save(savepath)
+    for ht in (khmer.new_counting_hash(12, 1e5, 4, blocked=True),
+               khmer.new_counting_hash(12, 1e5, 4, counter_bits=4)):
+        try:
+            ht.load_mapped(savepath)
+            assert 0, "should fail"
+        except ValueError:
+            pass
+
+def test_save_load_gz_blocks():
+    # .gz tables are saved in independently compressed blocks, which any
+    # gzip reader reads as one stream, and loaded in parallel.
+    inpath = utils.get_test_data('random-20-a.fa')
+    savepath = utils.get_temp_filename('tempcountingsave6.ht')
+    gzpath = utils.get_temp_filename('tempcountingsave6.ht.gz')
+
+    config = khmer.get_config()
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(4)
+    try:
+        # more than one batch of blocks.
+        hi = khmer.new_counting_hash(12, 9e6, 2)
+        hi.consume_fasta(inpath)
+        hi.save(savepath)
+        hi.save(gzpath)
+
+        ht = khmer.load_counting_hash(gzpath)
+    finally:
+        config.set_number_of_threads(old_n_threads)
+
+    assert gzip.open(gzpath).read() == open(savepath, 'rb').read()
+
+    for record in screed.open(inpath):
+        seq = record.sequence
+        assert ht.get(seq[:12]) == hi.get(seq[:12])
+        assert ht.get(seq[-12:]) == hi.get(seq[-12:])
+
+def test_load_gz_blocks_bad():
+    # a block-compressed table cut short, or with a damaged block, fails
+    # to load.
+    gzpath = utils.get_temp_filename('tempcountingsave9.ht.gz')
+    badpath = utils.get_temp_filename('tempcountingsave9bad.ht.gz')
+
+    hi = khmer.new_counting_hash(12, 1e6, 2)
+    hi.consume_fasta(utils.get_test_data('random-20-a.fa'))
+    hi.save(gzpath)
+    data = open(gzpath, 'rb').read()
+
+    # cut short, a damaged block, and a block claiming to hold 4GB.
+    middle = len(data) // 2
+    for bad in (data[:middle],
+                data[:middle] + chr(ord(data[middle]) ^ 0xff) +
+                data[middle + 1:],
+                data[:-4] + '\xff' * 4):
+        open(badpath, 'wb').write(bad)
+        try:
+            khmer.new_counting_hash(12, 1, 1).load(badpath)
+            assert 0, "should fail"
+        except IOError:
+            pass
+
+def test_load_gz_stream():
+    # .gz tables compressed as one stream still load.
+    inpath = utils.get_test_data('random-20-a.fa')
+    savepath = utils.get_temp_filename('tempcountingsave7.ht')
+    gzpath = utils.get_temp_filename('tempcountingsave7.ht.gz')
+
+    hi = khmer.new_counting_hash(12, 1e5, 4)
+    hi.consume_fasta(inpath)
+    hi.save(savepath)
+
+    fp = gzip.open(gzpath, 'wb')
+    fp.write(open(savepath, 'rb').read())
+    fp.close()
+
+    ht = khmer.load_counting_hash(gzpath)
+    for record in screed.open(inpath):
+        seq = record.sequence
+        assert ht.get(seq[:12]) == hi.get(seq[:12])
+
+def test_load_truncated():
+    # a table file cut short fails to load, rather than loading garbage.
+    savepath = utils.get_temp_filename('tempcountingsave8.ht')
+    gzpath = utils.get_temp_filename('tempcountingsave8.ht.gz')
+
+    khmer.new_counting_hash(12, 1e5, 4).save(savepath)
+    data = open(savepath, 'rb').read()
+    open(savepath, 'wb').write(data[:len(data) // 2])
+
+    fp = gzip.open(gzpath, 'wb')
+    fp.write(data[:len(data) // 2])
+    fp.close()
+
+    for path, mapped in ((gzpath, False), (savepath, True)):
+        try:
+            ht = khmer.new_counting_hash(12, 1, 1)
+            if mapped:
+                ht.load_mapped(path)
+            else:
+                ht.load(path)
+            assert 0, "should fail"
+        except IOError:
+            pass
+
+def test_save_load_sparse():
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    hi = khmer.new_counting_hash(12, 1e6, 4, hash_seed=7)
+    hi.set_use_bigcount(True)
+    hi.consume_fasta(inpath)
+    for i in range(300):
+        hi.count('A' * 12)
+
+    rawpath = utils.get_temp_filename('tempcountingsave8.ht')
+    tempdir = os.path.dirname(rawpath)
+    hi.save(rawpath)
+
+    for name in ('tempcountingsave8.sparse.ht', 'tempcountingsave8.sparse.gz'):
+        savepath = utils.get_temp_filename(name, tempdir=tempdir)
+        hi.save_sparse(savepath)
+        assert khmer._khmer.get_saved_ht_type(savepath) == \
+            khmer._khmer.SAVED_SPARSE_COUNTING_HT
+
+        ht = khmer.load_counting_hash(savepath)
+        assert ht.hashsizes() == hi.hashsizes()
+        assert ht.get('A' * 12) == 300
+
+        for record in screed.open(inpath):
+            seq = record.sequence
+            assert ht.get(seq[:12]) == hi.get(seq[:12])
+            assert ht.get(seq[-12:]) == hi.get(seq[-12:])
+
+    # most of the bins are empty.
+    savepath = utils.get_temp_filename('tempcountingsave8.sparse.ht',
+                                       tempdir=tempdir)
+    assert os.path.getsize(savepath) * 20 < os.path.getsize(rawpath)
+
+    try:
+        ht = khmer.new_counting_hash(12, 1e5, 4, counter_bits=4)
+        ht.save_sparse(savepath)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_load_sparse_bad():
+    # a sparse table whose encoding does not decode fails to load.
+    import struct
+
+    savepath = utils.get_temp_filename('tempcountingsave10.sparse.ht')
+    hi = khmer.new_counting_hash(12, 1e5, 1)
+    hi.consume_fasta(utils.get_test_data('random-20-a.fa'))
+    hi.save_sparse(savepath)
+    data = open(savepath, 'rb').read()
+
+    # the encoded size of the only segment, after the header and the
+    # table size; claim a byte less, and drop the last byte.
+    offset = 1 + 1 + 1 + 4 + 1 + 1 + 8
+    encoded_size, = struct.unpack('<Q', data[offset:offset + 8])
+    bad = data[:offset] + struct.pack('<Q', encoded_size - 1) + \
+        data[offset + 8:offset + 8 + encoded_size - 1] + \
+        data[offset + 8 + encoded_size:]
+    open(savepath, 'wb').write(bad)
+
+    try:
+        khmer.new_counting_hash(12, 1, 1).load(savepath)
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+def test_save_load_seeded():
+    inpath = utils.get_test_data('random-20-a.fa')
+    savepath = utils.get_temp_filename('tempcountingsave3.ht')
+
+    sizes = list(PRIMES_1m)
+    sizes.append(1000005)
+
+    hi = khmer._new_counting_hash(12, sizes)
+    hi.set_hash_seed(42)
+    hi.consume_fasta(inpath)
+    hi.save(savepath)
+
+    ht = khmer._new_counting_hash(12, sizes)
+    ht.load(savepath)
+    assert ht.table_seeds() == hi.table_seeds()
+    assert len(set(ht.table_seeds())) == len(sizes)
+
+    tracking = khmer._new_hashbits(12, sizes)
+    x = hi.abundance_distribution(inpath, tracking)
+
+    tracking = khmer._new_hashbits(12, sizes)
+    y = ht.abundance_distribution(inpath, tracking)
+
+    assert sum(x) == 3966, sum(x)
+    assert x == y, (x,y)
+
+def test_hash_seed_clear():
+    hi = khmer.new_counting_hash(12, 1e4, 4, hash_seed=1)
+    assert len(hi.table_seeds()) == 4
+
+    hi.set_hash_seed(0)
+    assert hi.table_seeds() == []
+
 def test_trim_full():
     hi = khmer.new_counting_hash(6, 1e6, 2)
 
@@ -450,6 +765,31 @@ def test_nobigcount_save():
 
     assert kh.get('AAAA') == MAX_COUNT
 
+def test_bigcount_many_save():
+    # tiny tables saturate at once, so every k-mer goes to the bigcounts.
+    import itertools
+    kmers = [ ''.join(x) for x in itertools.product('ACGT', repeat=6) ]
+
+    kh = khmer.new_counting_hash(6, 1, 1)
+    kh.set_use_bigcount(True)
+    for kmer in kmers[:16]:
+        for i in range(0, MAX_COUNT):
+            kh.count(kmer)
+    for kmer in kmers[16:]:
+        kh.count(kmer)
+        kh.count(kmer)
+
+    for kmer in kmers[16:]:
+        assert kh.get(kmer) >= MAX_COUNT + 2, (kmer, kh.get(kmer))
+
+    for name in ('tempbigcountsave.ht', 'tempbigcountsave.ht.gz'):
+        savepath = utils.get_temp_filename(name)
+        kh.save(savepath)
+
+        ht = khmer.load_counting_hash(savepath)
+        for kmer in kmers:
+            assert ht.get(kmer) == kh.get(kmer), kmer
+
 def test_bigcount_abund_dist():
     kh = khmer.new_counting_hash(18, 1e7, 4)
     tracking = khmer.new_hashbits(18, 1e7, 4)
@@ -482,6 +822,80 @@ def test_bigcount_abund_dist_2():
     pdist = [ (i, dist[i]) for i in range(len(dist)) if dist[i] ]
     assert dist[1001] == 1, pdist
 
+def test_abund_dist_threaded():
+    config = khmer.get_config()
+    if not config.is_threaded():
+        return
+
+    seqpath = utils.get_test_data('test-reads.fa')
+
+    kh = khmer.new_counting_hash(12, 1e6, 4)
+    kh.consume_fasta(seqpath)
+
+    tracking = khmer.new_hashbits(12, 1e6, 4)
+    single = kh.abundance_distribution(seqpath, tracking)
+
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(4)
+    try:
+        tracking = khmer.new_hashbits(12, 1e6, 4)
+        threaded = kh.abundance_distribution(seqpath, tracking)
+    finally:
+        config.set_number_of_threads(old_n_threads)
+
+    assert threaded == single
+
+def test_abund_dist_threaded_repeats():
+    # each read comes up several times in a row, so that the threads race
+    # to be the first to see its k-mers; each k-mer is still counted once.
+    config = khmer.get_config()
+    if not config.is_threaded():
+        return
+
+    import random
+    rng = random.Random(1)
+    seqpath = utils.get_temp_filename('repeats.fa')
+    fp = open(seqpath, 'w')
+    for i in range(2000):
+        seq = ''.join([ rng.choice('ACGT') for j in range(50) ])
+        for j in range(8):
+            fp.write('>%d.%d\n%s\n' % (i, j, seq))
+    fp.close()
+
+    kh = khmer.new_counting_hash(20, 2e6, 4)
+    kh.consume_fasta(seqpath)
+
+    tracking = khmer.new_hashbits(20, 2e6, 4)
+    single = kh.abundance_distribution(seqpath, tracking)
+    assert single[8] > 2000 * 30, single[8]
+
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(8)
+    try:
+        for i in range(3):
+            tracking = khmer.new_hashbits(20, 2e6, 4)
+            threaded = kh.abundance_distribution(seqpath, tracking)
+            assert threaded == single, (i, threaded[8])
+    finally:
+        config.set_number_of_threads(old_n_threads)
+
+def test_bin_abund_dist():
+    # with tables this large, each k-mer has a bin to itself.
+    kh = khmer.new_counting_hash(18, 1e7, 4)
+    tracking = khmer.new_hashbits(18, 1e7, 4)
+    kh.set_use_bigcount(True)
+
+    seqpath = utils.get_test_data('test-abund-read-2.fa')
+    kh.consume_fasta(seqpath)
+
+    dist = kh.abundance_distribution(seqpath, tracking)
+    bin_dist = kh.bin_abundance_distribution()
+
+    assert bin_dist[0] == 0
+    assert bin_dist[1:] == dist[1:], \
+        [ (i, bin_dist[i], dist[i]) for i in range(len(dist))
+          if bin_dist[i] != dist[i] ]
+
 def test_bigcount_overflow():
     kh = khmer.new_counting_hash(18, 1e7, 4)
     kh.set_use_bigcount(True)
@@ -504,3 +918,780 @@ def test_get_hashsizes():
 #
 #    kh = khmer.new_counting_hash(18, 1e6, 4)
 #    hb = kh.collect_high_abundance_kmers(seqpath, 2, 4)
+
+def test_maxcount_reconfigure():
+    # saturation threshold is captured at construction, and re-read on
+    # an explicit reconfigure.
+    config = khmer.get_config()
+    if not config.is_threaded():
+        return
+
+    kh = khmer.new_counting_hash(4, 4**4, 4)
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(4)
+    try:
+        for i in range(0, 300):
+            kh.count('AAAA')
+        assert kh.get('AAAA') == MAX_COUNT, kh.get('AAAA')
+
+        kh.reconfigure()
+        assert kh.get('AAAA') == config.get_hash_count_threshold()
+    finally:
+        config.set_number_of_threads(old_n_threads)
+        kh.reconfigure()
+
+def test_consume_fasta_threaded():
+    config = khmer.get_config()
+    if not config.is_threaded():
+        return
+
+    inpath = utils.get_test_data('test-reads.fa')
+
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    single = ht.consume_fasta(inpath, 0, 0, None, 1)
+
+    hi = khmer.new_counting_hash(12, 1e5, 4)
+    threaded = hi.consume_fasta(inpath, 0, 0, None, 4)
+
+    assert threaded == single, (threaded, single)
+
+    for n, record in enumerate(screed.open(inpath)):
+        if n % 100 == 0:
+            seq = record.sequence
+            assert hi.get(seq[:12]) == ht.get(seq[:12])
+            assert hi.get(seq[-12:]) == ht.get(seq[-12:])
+
+def test_consume_fasta_threaded_saturates():
+    # the workers of consume_fasta leave the configured number of threads,
+    # and so the saturation thresholds, alone; and never count past them.
+    config = khmer.get_config()
+    assert config.get_number_of_threads() == 1
+    assert config.get_hash_count_threshold() == MAX_COUNT
+
+    inpath = utils.get_temp_filename('reads.fa')
+    fp = open(inpath, 'w')
+    for i in range(2000):
+        fp.write('>%d\nAAAAAAAAAAAAAAAAAAAA\n' % i)
+    fp.close()
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    kh.consume_fasta(inpath, 0, 0, None, 4)
+    assert kh.get('AAAAAAAAAAAA') == MAX_COUNT
+    assert config.get_number_of_threads() == 1
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    kh.set_use_bigcount(True)
+    kh.consume_fasta(inpath, 0, 0, None, 4)
+    assert kh.get('AAAAAAAAAAAA') == 2000 * (20 - 12 + 1)
+
+def test_blocked_count():
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    hi = khmer.new_counting_hash(12, 1e5, 4, blocked=True)
+    hi.consume_fasta(inpath)
+    hi.consume_fasta(inpath)
+
+    for record in screed.open(inpath):
+        seq = record.sequence
+        assert hi.get(seq[:12]) >= 2
+        assert hi.get(seq[-12:]) >= 2
+
+    assert hi.get('A' * 12) == 0
+
+def test_blocked_maxcount_with_bigcount():
+    kh = khmer.new_counting_hash(4, 4**4, 4, blocked=True)
+    kh.set_use_bigcount(True)
+
+    for i in range(0, 1000):
+        kh.count('AAAA')
+
+    assert kh.get('AAAA') == 1000, kh.get('AAAA')
+
+    kh.set_use_bigcount(False)
+    assert kh.get('AAAA') == MAX_COUNT, kh.get('AAAA')
+
+def test_blocked_save_load():
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    for name in ('tempblockedsave0.ht', 'tempblockedsave1.ht.gz'):
+        savepath = utils.get_temp_filename(name)
+
+        hi = khmer.new_counting_hash(12, 1e5, 4, blocked=True)
+        hi.set_use_bigcount(True)
+        hi.consume_fasta(inpath)
+        for i in range(0, 300):
+            hi.count('A' * 12)
+        hi.save(savepath)
+
+        ht = khmer.load_counting_hash(savepath)
+        assert ht.hashsizes() == hi.hashsizes()
+        assert ht.get('A' * 12) == 300, ht.get('A' * 12)
+
+        for record in screed.open(inpath):
+            seq = record.sequence
+            assert ht.get(seq[:12]) == hi.get(seq[:12])
+
+def test_blocked_load_truncated():
+    savepath = utils.get_temp_filename('tempblockedsave2.ht')
+
+    khmer.new_counting_hash(12, 1e5, 4, blocked=True).save(savepath)
+    data = open(savepath, 'rb').read()
+    open(savepath, 'wb').write(data[:len(data) // 2])
+
+    try:
+        khmer.load_counting_hash(savepath)
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+def test_packed_load_bad():
+    savepath = utils.get_temp_filename('temppackedsave0.ht')
+    khmer.new_counting_hash(12, 1e5, 4, counter_bits=4).save(savepath)
+    data = open(savepath, 'rb').read()
+
+    # a bad counter width, then a file cut short.
+    for bad in (data[:8] + chr(3) + data[9:], data[:len(data) // 2]):
+        open(savepath, 'wb').write(bad)
+        try:
+            khmer.load_counting_hash(savepath)
+            assert 0, "should fail"
+        except IOError:
+            pass
+
+def test_packed_4bit_maxcount():
+    kh = khmer.new_counting_hash(4, 4**4, 4, counter_bits=4)
+
+    for i in range(0, 100):
+        kh.count('AAAA')
+
+    assert kh.get('AAAA') == 15, kh.get('AAAA')
+    assert kh.get('CCCC') == 0
+
+    kh.set_use_bigcount(True)
+    for i in range(0, 100):
+        kh.count('AAAA')
+
+    assert kh.get('AAAA') == 15 + 100, kh.get('AAAA')
+
+def test_packed_16bit_count():
+    kh = khmer.new_counting_hash(4, 4**4, 4, counter_bits=16)
+
+    for i in range(0, 1000):
+        kh.count('AAAA')
+
+    assert kh.get('AAAA') == 1000, kh.get('AAAA')
+    assert kh.n_occupied() == 1, kh.n_occupied()
+
+def test_packed_bad_counter_bits():
+    for bits in (0, 2, 12, 32):
+        try:
+            khmer.new_counting_hash(4, 4**4, 4, counter_bits=bits)
+            assert 0, "counter_bits=%d should fail" % bits
+        except ValueError:
+            pass
+
+    try:
+        khmer.new_counting_hash(4, 4**4, 4, blocked=True, counter_bits=4)
+        assert 0, "blocked tables should not take counter_bits"
+    except ValueError:
+        pass
+
+def test_packed_save_load():
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    for bits in (4, 16):
+        for name in ('temppackedsave0.ht', 'temppackedsave1.ht.gz'):
+            savepath = utils.get_temp_filename(name)
+
+            hi = khmer.new_counting_hash(12, 1e5, 4, counter_bits=bits)
+            hi.set_use_bigcount(True)
+            hi.consume_fasta(inpath)
+            for i in range(0, 300):
+                hi.count('A' * 12)
+            hi.save(savepath)
+
+            ht = khmer.load_counting_hash(savepath)
+            assert ht.hashsizes() == hi.hashsizes()
+            assert ht.get('A' * 12) == 300, ht.get('A' * 12)
+            assert ht.n_occupied() == hi.n_occupied()
+
+            for record in screed.open(inpath):
+                seq = record.sequence
+                assert ht.get(seq[:12]) == hi.get(seq[:12])
+
+def test_conservative_count():
+    for kwargs in ({}, { 'blocked': True }, { 'counter_bits': 4 }):
+        kh = khmer.new_counting_hash(4, 4**4, 4, **kwargs)
+        kh.set_use_conservative(True)
+        assert kh.get_use_conservative()
+
+        for i in range(0, 10):
+            kh.count('AAAA')
+        assert kh.get('AAAA') == 10, (kwargs, kh.get('AAAA'))
+
+        kh.set_use_bigcount(True)
+        for i in range(0, 1000):
+            kh.count('CCCC')
+        assert kh.get('CCCC') == 1000, (kwargs, kh.get('CCCC'))
+
+def test_conservative_overestimates_less():
+    # with small tables, conservative update is never further off.
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    exact = khmer.new_counting_hash(12, 1e6, 4)
+    exact.consume_fasta(inpath)
+
+    standard = khmer.new_counting_hash(12, 1000, 4)
+    standard.consume_fasta(inpath)
+
+    conservative = khmer.new_counting_hash(12, 1000, 4)
+    conservative.set_use_conservative(True)
+    conservative.consume_fasta(inpath)
+
+    standard_err = conservative_err = 0
+    for record in screed.open(inpath):
+        seq = record.sequence
+        for i in range(0, len(seq) - 12 + 1):
+            kmer = seq[i:i+12]
+            assert conservative.get(kmer) >= exact.get(kmer)
+            assert conservative.get(kmer) <= standard.get(kmer)
+            standard_err += standard.get(kmer) - exact.get(kmer)
+            conservative_err += conservative.get(kmer) - exact.get(kmer)
+
+    assert conservative_err < standard_err, (conservative_err, standard_err)
+
+def test_conservative_count_threaded():
+    # each read comes up several times in a row, so that the threads race
+    # to count its k-mers; no count is lost to the race.
+    config = khmer.get_config()
+    if not config.is_threaded():
+        return
+
+    import random
+    rng = random.Random(1)
+    seqpath = utils.get_temp_filename('repeats.fa')
+    reads = []
+    fp = open(seqpath, 'w')
+    for i in range(2000):
+        seq = ''.join([ rng.choice('ACGT') for j in range(50) ])
+        reads.append(seq)
+        for j in range(8):
+            fp.write('>%d.%d\n%s\n' % (i, j, seq))
+    fp.close()
+
+    single = khmer.new_counting_hash(20, 2e6, 4)
+    single.set_use_conservative(True)
+    single.consume_fasta(seqpath)
+
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(8)
+    try:
+        for kwargs in ({}, { 'blocked': True }, { 'counter_bits': 4 }):
+            kh = khmer.new_counting_hash(20, 2e6, 4, **kwargs)
+            kh.set_use_conservative(True)
+            kh.consume_fasta(seqpath)
+
+            for seq in reads:
+                for i in range(0, len(seq) - 20 + 1):
+                    kmer = seq[i:i+20]
+                    assert kh.get(kmer) >= single.get(kmer), (kwargs, kmer)
+    finally:
+        config.set_number_of_threads(old_n_threads)
+
+def test_wide_k():
+    # k > 32 is rolled in a 128-bit word, and reduced into the tables.
+    K = 41
+    seq = DNA
+    rc = ''.join({ 'A': 'T', 'C': 'G', 'G': 'C', 'T': 'A' }[ch]
+                 for ch in reversed(seq))
+
+    hi = khmer.new_counting_hash(K, 1e5, 4)
+    hi.consume(seq)
+    hi.consume(rc)
+
+    assert hi.get(seq[:K]) == 2, hi.get(seq[:K])
+    assert hi.get(rc[-K:]) == 2, hi.get(rc[-K:])
+    assert hi.get('A' * K) == 0
+
+def test_bad_ksize():
+    for K in (0, 65, 70):
+        try:
+            khmer.new_counting_hash(K, 1e3, 2)
+            assert 0, "should fail"
+        except ValueError:
+            pass
+
+    try:
+        khmer.new_hashbits(70, 1e3, 2)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_wide_k_hash_functions():
+    # wide k-mers hash one-way, so there is no k-mer hash to give back.
+    kmer = DNA[:41]
+    for fn, args in ((khmer.forward_hash, (kmer, 41)),
+                     (khmer.forward_hash_no_rc, (kmer, 41)),
+                     (khmer.reverse_hash, (5, 41))):
+        try:
+            fn(*args)
+            assert 0, "should fail"
+        except ValueError:
+            pass
+
+def test_wide_k_no_stoptags():
+    # stop tags need the k-mers themselves, which wide tables do not keep.
+    hi = khmer.new_counting_hash(41, 1e5, 4)
+    try:
+        hi.collect_high_abundance_kmers(utils.get_test_data('random-20-a.fa'),
+                                        2, 10)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_wide_k_consume_fasta():
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    for K in (33, 63, 64):
+        hi = khmer.new_counting_hash(K, 1e5, 4)
+        hi.consume_fasta(inpath)
+
+        ht = khmer.new_counting_hash(K, 1e5, 4)
+        for record in screed.open(inpath):
+            if len(record.sequence) >= K:
+                ht.consume(record.sequence)
+
+        for record in screed.open(inpath):
+            seq = record.sequence
+            for i in range(0, len(seq) - K + 1, 7):
+                kmer = seq[i:i+K]
+                assert hi.get(kmer) == ht.get(kmer)
+                assert hi.get(kmer) >= 1
+
+def test_specialized_k():
+    # k-mer kernels are specialized for some k; all should agree with
+    # counting the k-mers one at a time.
+    inpath = utils.get_test_data('random-20-a.fa')
+
+    for K in (19, 20, 25, 31, 32):
+        hi = khmer.new_counting_hash(K, 1e5, 4)
+        hi.consume_fasta(inpath)
+
+        hj = khmer.new_counting_hash(K, 1e5, 4)
+        ht = khmer.new_counting_hash(K, 1e5, 4)
+        for record in screed.open(inpath):
+            seq = record.sequence
+            if len(seq) < K:
+                continue
+            hj.consume(seq)
+            for i in range(0, len(seq) - K + 1):
+                ht.count(seq[i:i+K])
+
+        for record in screed.open(inpath):
+            seq = record.sequence
+            for i in range(0, len(seq) - K + 1, 5):
+                kmer = seq[i:i+K]
+                assert hi.get(kmer) == ht.get(kmer), (K, i)
+                assert hj.get(kmer) == ht.get(kmer), (K, i)
+
+def test_normalize_by_median():
+    # the native engine keeps the same reads as checking the median and
+    # consuming each read in turn, when the reads are checked one at a
+    # time.
+    config = khmer.get_config()
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(1)
+
+    inpath = utils.get_test_data('test-reads.fa')
+    outpath = utils.get_temp_filename('test-reads.fa.keep')
+
+    reports = []
+    def callback(info, n_total, n_kept):
+        reports.append((n_total, n_kept))
+
+    try:
+        kh = khmer.new_counting_hash(12, 1e5, 4)
+        n_total, n_kept = kh.normalize_by_median(inpath, outpath, 5, False,
+                                                 callback)
+    finally:
+        config.set_number_of_threads(old_n_threads)
+
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    kept = []
+    for record in screed.open(inpath):
+        seq = record.sequence
+        if len(seq) < 12:
+            continue
+        med, _, _ = ht.get_median_count(seq)
+        if med < 5:
+            ht.consume(seq)
+            kept.append(record.name)
+
+    assert n_kept == len(kept), (n_kept, len(kept))
+    assert n_kept < n_total
+    assert [ r.name for r in screed.open(outpath) ] == kept
+
+    # once per batch of reads, ending with the totals.
+    assert reports[-1] == (n_total, n_kept), reports
+    assert reports == sorted(reports), reports
+
+def test_normalize_by_median_with_n():
+    # a read with an N is checked and counted as if it were an A there,
+    # and written out as it was.
+    inpath = utils.get_temp_filename('with-n.fa')
+    outpath = utils.get_temp_filename('with-n.fa.keep')
+
+    seq = 'ACGTTGCAAGGCTTAACCGGTAGCATGCAT'        # an A at 15
+    other = 'TTGGCCAATTCGCGATATCGGCCTAGCAAC'
+    with_n = seq[:15] + 'N' + seq[16:]
+    fp = open(inpath, 'w')
+    fp.write('>a\n%s\n>b\n%s\n>c\n%s\n' % (with_n, seq, other))
+    fp.close()
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    n_total, n_kept = kh.normalize_by_median(inpath, outpath, 1)
+
+    # b has been seen, as a.
+    assert (n_total, n_kept) == (3, 2), (n_total, n_kept)
+    records = [ (r.name, r.sequence) for r in screed.open(outpath) ]
+    assert records == [('a', with_n), ('c', other)], records
+    assert kh.get(seq[4:16]) == 1
+
+def test_normalize_by_median_paired():
+    # the mates of a pair are kept or discarded together.
+    inpath = utils.get_temp_filename('paired.fa')
+    outpath = utils.get_temp_filename('paired.fa.keep')
+
+    seq = 'ACGTTGCAAGGCTTAACCGGTAGCATGCAT'
+    other = 'TTGGCCAATTCGCGATATCGGCCTAGCAAC'
+    fp = open(inpath, 'w')
+    fp.write('>a/1\n%s\n>a/2\n%s\n' % (seq, other))
+    fp.write('>b/1\n%s\n>b/2\n%s\n' % (seq, other[::-1]))
+    fp.write('>c/1\n%s\n>c/2\n%s\n' % (seq, other))
+    fp.close()
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    n_total, n_kept = kh.normalize_by_median(inpath, outpath, 1, True)
+
+    # b/2 is novel, so b/1 comes along with it; all of c has been seen.
+    assert (n_total, n_kept) == (6, 4), (n_total, n_kept)
+    names = [ r.name for r in screed.open(outpath) ]
+    assert names == ['a/1', 'a/2', 'b/1', 'b/2'], names
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    n_total, n_kept = kh.normalize_by_median(inpath, outpath, 1)
+    names = [ r.name for r in screed.open(outpath) ]
+    assert names == ['a/1', 'a/2', 'b/2'], names
+
+def _write_random_reads(filename, n, seed=1):
+    import random
+    rng = random.Random(seed)
+    fp = open(filename, 'w')
+    for i in range(n):
+        seq = ''.join([ rng.choice('ACGT') for j in range(40) ])
+        fp.write('>%d\n%s\n' % (i, seq))
+    fp.close()
+
+def test_consume_fasta_checkpointed():
+    inpath = utils.get_temp_filename('reads.fa')
+    prefix = os.path.join(os.path.dirname(inpath), 'ckpt')
+
+    # checkpoint the first batch of reads, as if the run had died there.
+    _write_random_reads(inpath, 10000)
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    total_reads, n_consumed = kh.consume_fasta_checkpointed(inpath, prefix, 1)
+    assert total_reads == 10000
+    assert os.path.exists(prefix + '.checkpoint')
+    assert os.path.exists(prefix + '.1.ht')
+
+    # then the file turns out to go on.
+    _write_random_reads(inpath, 15000)
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    total_reads2, n_consumed2 = ht.consume_fasta(inpath)
+
+    kh = khmer.new_counting_hash(12, 1e3, 4)
+    total_reads, n_consumed = kh.resume_consume_fasta(prefix)
+    assert total_reads == total_reads2 == 15000
+    assert n_consumed == n_consumed2
+    assert kh.hashsizes() == ht.hashsizes()
+
+    for record in screed.open(inpath):
+        seq = record.sequence
+        assert kh.get(seq[:12]) == ht.get(seq[:12])
+        assert kh.get(seq[-12:]) == ht.get(seq[-12:])
+
+    # the newer checkpoint replaces the one resumed from.
+    assert os.path.exists(prefix + '.2.ht')
+    assert not os.path.exists(prefix + '.1.ht')
+
+def test_resume_consume_fasta_bad():
+    inpath = utils.get_temp_filename('reads.fa')
+    prefix = os.path.join(os.path.dirname(inpath), 'ckpt')
+
+    # no checkpoint at all.
+    kh = khmer.new_counting_hash(12, 1e3, 4)
+    try:
+        kh.resume_consume_fasta(prefix)
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+    # a record which is not one.
+    fp = open(prefix + '.checkpoint', 'w')
+    fp.write('not a checkpoint\n')
+    fp.close()
+    try:
+        kh.resume_consume_fasta(prefix)
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+    # a record whose tables are gone.
+    _write_random_reads(inpath, 10000)
+    kh.consume_fasta_checkpointed(inpath, prefix, 1)
+    os.remove(prefix + '.1.ht')
+    kh = khmer.new_counting_hash(12, 1e3, 4)
+    try:
+        kh.resume_consume_fasta(prefix)
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+def test_consume_fasta_checkpointed_unwritable():
+    # the tables cannot be written, so there is no checkpoint, and the
+    # run fails rather than carrying on without one.
+    inpath = utils.get_temp_filename('reads.fa')
+    prefix = os.path.join(os.path.dirname(inpath), 'missing', 'ckpt')
+    _write_random_reads(inpath, 10000)
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    try:
+        kh.consume_fasta_checkpointed(inpath, prefix, 1)
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+    try:
+        kh.save(prefix + '.ht')
+        assert 0, "should fail"
+    except IOError:
+        pass
+
+def test_consume_fasta_checkpointed_keeps_last():
+    # a checkpoint whose tables cannot be written leaves the one before
+    # in place, to resume from.
+    inpath = utils.get_temp_filename('reads.fa')
+    prefix = os.path.join(os.path.dirname(inpath), 'ckpt')
+
+    _write_random_reads(inpath, 10000)
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    kh.consume_fasta_checkpointed(inpath, prefix, 1)
+
+    _write_random_reads(inpath, 15000)
+    os.mkdir(prefix + '.2.ht')
+    kh = khmer.new_counting_hash(12, 1e3, 4)
+    try:
+        kh.resume_consume_fasta(prefix)
+        assert 0, "should fail"
+    except IOError:
+        pass
+    assert os.path.exists(prefix + '.1.ht')
+
+    kh = khmer.new_counting_hash(12, 1e3, 4)
+    total_reads, _ = kh.resume_consume_fasta(prefix)
+    assert total_reads == 15000
+
+def test_consume_fasta_checkpointed_blocked():
+    inpath = utils.get_test_data('random-20-a.fa')
+    prefix = utils.get_temp_filename('ckpt')
+
+    kh = khmer.new_counting_hash(12, 1e5, 4, blocked=True)
+    try:
+        kh.consume_fasta_checkpointed(inpath, prefix, 1)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_merge():
+    reads = [ record.sequence for record in
+              screed.open(utils.get_test_data('test-reads.fa')) ]
+    half = len(reads) // 2
+
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    ht2 = khmer.new_counting_hash(12, 1e5, 4)
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    for seq in reads[:half]:
+        ht.consume(seq)
+        kh.consume(seq)
+    for seq in reads[half:]:
+        ht2.consume(seq)
+        kh.consume(seq)
+
+    ht.merge(ht2)
+    for seq in reads:
+        assert ht.get(seq[:12]) == kh.get(seq[:12])
+        assert ht.get(seq[-12:]) == kh.get(seq[-12:])
+
+    try:
+        ht.merge(khmer.new_counting_hash(12, 1e4, 4))
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+    try:
+        ht.merge(khmer.new_hashbits(12, 1e5, 4))
+        assert 0, "should fail"
+    except TypeError:
+        pass
+
+def test_merge_bigcount():
+    kmer = 'ACGTACGTACGT'
+
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    ht.set_use_bigcount(True)
+    ht2 = khmer.new_counting_hash(12, 1e5, 4)
+    ht2.set_use_bigcount(True)
+
+    for i in range(400):
+        ht.count(kmer)
+    for i in range(200):
+        ht2.count(kmer)
+    ht2.count('TTTTACGTACGA')
+
+    ht.merge(ht2)
+    assert ht.get(kmer) == 600
+    assert ht.get('TTTTACGTACGA') == 1
+
+    # a count which only saturates in the merge is capped.
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    ht.set_use_bigcount(True)
+    for i in range(200):
+        ht.count(kmer)
+    ht.merge(ht)
+    assert ht.get(kmer) == 255
+
+def test_merge_thresholds():
+    # tables made with different numbers of threads saturate at different
+    # counts, so their counts cannot be added.
+    config = khmer.get_config()
+    old_n_threads = config.get_number_of_threads()
+    config.set_number_of_threads(4)
+    try:
+        ht2 = khmer.new_counting_hash(12, 1e5, 4)
+    finally:
+        config.set_number_of_threads(old_n_threads)
+
+    ht = khmer.new_counting_hash(12, 1e5, 4)
+    try:
+        ht.merge(ht2)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def _kmers_of(reads, k):
+    kmers = set()
+    for seq in reads:
+        for i in range(len(seq) - k + 1):
+            kmers.add(seq[i:i + k])
+    return kmers
+
+def test_sharded_consume_fasta():
+    inpath = utils.get_temp_filename('reads.fa')
+    _write_random_reads(inpath, 2000)
+    reads = [ record.sequence for record in screed.open(inpath) ]
+
+    kh = khmer.new_counting_hash(12, 1e5, 4)
+    kh.consume_fasta(inpath)
+
+    # one pass, fanned out to every shard...
+    sh = khmer.new_sharded_counting_hash(12, 1e5, 4, 4)
+    total_reads, n_consumed = sh.consume_fasta(inpath)
+    assert total_reads == 2000
+    assert n_consumed == 2000 * (40 - 12 + 1)
+
+    # ...and one pass per shard count the same.
+    sh2 = khmer.new_sharded_counting_hash(12, 1e5, 4, 4)
+    n = 0
+    for i in range(sh2.n_shards()):
+        total_reads, n_shard = sh2.consume_fasta_shard(i, inpath)
+        assert total_reads == 2000
+        n += n_shard
+    assert n == n_consumed
+
+    # a shard only ever sees its own k-mers, so it can't overcount them.
+    for kmer in _kmers_of(reads, 12):
+        assert sh.get(kmer) == sh2.get(kmer)
+        assert 1 <= sh.get(kmer) <= kh.get(kmer)
+
+    for seq in reads[:100]:
+        assert sh.get_median_count(seq) == sh2.get_median_count(seq)
+        assert sh.get_min_count(seq) >= 1
+
+def test_sharded_save_load():
+    inpath = utils.get_temp_filename('reads.fa')
+    tempdir = os.path.dirname(inpath)
+    _write_random_reads(inpath, 1000)
+    reads = [ record.sequence for record in screed.open(inpath) ]
+
+    sh = khmer.new_sharded_counting_hash(12, 1e5, 4, 3)
+    sh.consume_fasta(inpath)
+
+    # build each shard out of core: count it, save it, drop it.
+    sh2 = khmer.new_sharded_counting_hash(12, 1e5, 4, 3)
+    for i in range(sh2.n_shards()):
+        sh2.consume_fasta_shard(i, inpath)
+        sh2.save_shard(i, os.path.join(tempdir, 'shard%d.kh' % i))
+        sh2.drop_shard(i)
+        assert not sh2.has_shard(i)
+
+    try:
+        sh2.get(reads[0][:12])
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+    for i in range(sh2.n_shards()):
+        sh2.load_shard(i, os.path.join(tempdir, 'shard%d.kh' % i), True)
+
+    for kmer in _kmers_of(reads, 12):
+        assert sh.get(kmer) == sh2.get(kmer)
+
+    try:
+        sh2.load_shard(3, os.path.join(tempdir, 'shard0.kh'))
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+    # a table of some other k is not a shard of this one.
+    otherpath = os.path.join(tempdir, 'other.kh')
+    khmer.new_counting_hash(13, 1e3, 4).save(otherpath)
+    try:
+        sh2.load_shard(0, otherpath)
+        assert 0, "should fail"
+    except IOError:
+        pass
+    assert not sh2.has_shard(0)
+
+def test_sharded_bounds():
+    sh = khmer.new_sharded_counting_hash(12, 1e3, 2, 4)
+
+    lower, upper = sh.get_shard_bounds(0)
+    assert lower == 0
+    for i in range(1, sh.n_shards()):
+        assert sh.get_shard_bounds(i)[0] == upper
+        lower, upper = sh.get_shard_bounds(i)
+        assert lower < upper or upper == 0
+    assert upper == 0
+
+    # random k-mers fall about evenly between the shards, even though
+    # their canonical hashes do not fall evenly over the hash space.
+    import random
+    rng = random.Random(1)
+    bounds = [ sh.get_shard_bounds(i)[0] for i in range(sh.n_shards()) ]
+    n = [ 0 ] * sh.n_shards()
+    for j in range(4000):
+        kmer = ''.join([ rng.choice('ACGT') for i in range(12) ])
+        h = khmer.forward_hash(kmer, 12)
+        n[len([ b for b in bounds if b <= h ]) - 1] += 1
+    for x in n:
+        assert 700 < x < 1300, n
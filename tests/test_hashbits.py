@@ -1,3 +1,4 @@
+import os
 import khmer
 
 import screed
@@ -479,3 +480,233 @@ def test_find_unpart_fail():
    ht.find_unpart(filename2, True, False)
    n, _ = ht.count_partitions()
    assert n == 49, n                    # only 49 sequences worth of tags
+
+def test_save_load_seeded():
+   inpath = utils.get_test_data('random-20-a.fa')
+   savepath = utils.get_temp_filename('temphashbitssave0.ht')
+
+   hi = khmer.new_hashbits(12, 1e5, 4, hash_seed=7)
+   hi.consume_fasta(inpath)
+   hi.save(savepath)
+
+   ht = khmer.new_hashbits(12, 1e5, 4)
+   ht.load(savepath)
+
+   assert ht.table_seeds() == hi.table_seeds()
+
+   for record in screed.open(inpath):
+      seq = record.sequence
+      assert ht.get(seq[:12]) == 1
+
+def test_load_mapped():
+   inpath = utils.get_test_data('random-20-a.fa')
+   savepath = utils.get_temp_filename('temphashbitssave1.ht')
+
+   hi = khmer.new_hashbits(12, 1e5, 4, hash_seed=7)
+   hi.consume_fasta(inpath)
+   hi.save(savepath)
+
+   ht = khmer.load_hashbits(savepath, mapped=True)
+   assert ht.is_mapped()
+   assert ht.table_seeds() == hi.table_seeds()
+
+   for record in screed.open(inpath):
+      seq = record.sequence
+      assert ht.get(seq[:12]) == 1
+      assert ht.get(seq[-12:]) == 1
+
+   # copy-on-write by default.
+   kmer = 'ACGTACGTACGT'
+   assert ht.get(kmer) == 0
+   ht.count(kmer)
+   assert ht.get(kmer) == 1
+   assert khmer.load_hashbits(savepath).get(kmer) == 0
+
+def test_load_mapped_blocked():
+   savepath = utils.get_temp_filename('temphashbitssave3.ht')
+   khmer.new_hashbits(12, 1e5, 4).save(savepath)
+
+   ht = khmer.new_hashbits(12, 1e5, 4, blocked=True)
+   try:
+      ht.load_mapped(savepath)
+      assert 0, "should fail"
+   except ValueError:
+      pass
+
+def test_save_load_sparse():
+   inpath = utils.get_test_data('random-20-a.fa')
+   rawpath = utils.get_temp_filename('temphashbitssave2.ht')
+   savepath = utils.get_temp_filename('temphashbitssave2.sparse.ht',
+                                      tempdir=os.path.dirname(rawpath))
+
+   hi = khmer.new_hashbits(12, 1e6, 4)
+   hi.consume_fasta(inpath)
+   hi.save(rawpath)
+   hi.save_sparse(savepath)
+   assert os.path.getsize(savepath) < os.path.getsize(rawpath)
+
+   ht = khmer.load_hashbits(savepath)
+   assert ht.hashsizes() == hi.hashsizes()
+
+   for record in screed.open(inpath):
+      seq = record.sequence
+      assert ht.get(seq[:12]) == 1
+      assert ht.get(seq[-12:]) == 1
+
+def test_blocked_bloom():
+   filename = utils.get_test_data('random-20-a.fa')
+
+   ht = khmer.new_hashbits(20, 100000, 4, blocked=True)
+   ht.consume_fasta(filename)
+
+   for record in screed.open(filename):
+      seq = record.sequence
+      for i in range(0, len(seq) - 20 + 1):
+         assert ht.get(seq[i:i+20]) == 1
+
+   assert ht.n_unique_kmers() <= 3960
+   assert ht.n_unique_kmers() >= 3950, ht.n_unique_kmers()
+   assert ht.get('A' * 20) == 0
+
+def test_blocked_bloom_save_load():
+   inpath = utils.get_test_data('random-20-a.fa')
+   savepath = utils.get_temp_filename('tempblockedsave0.ht')
+
+   hi = khmer.new_hashbits(20, 100000, 4, blocked=True)
+   hi.consume_fasta(inpath)
+   hi.save(savepath)
+
+   ht = khmer.load_hashbits(savepath)
+   assert ht.hashsizes() == hi.hashsizes()
+
+   for record in screed.open(inpath):
+      seq = record.sequence
+      assert ht.get(seq[:20]) == 1
+      assert ht.get(seq[-20:]) == 1
+
+def test_blocked_bloom_load_truncated():
+   inpath = utils.get_test_data('random-20-a.fa')
+   savepath = utils.get_temp_filename('tempblockedsave1.ht')
+
+   hi = khmer.new_hashbits(20, 100000, 4, blocked=True)
+   hi.consume_fasta(inpath)
+   hi.save(savepath)
+
+   data = open(savepath, 'rb').read()
+   fp = open(savepath, 'wb')
+   fp.write(data[:len(data) // 2])
+   fp.close()
+
+   try:
+      khmer.load_hashbits(savepath)
+      assert 0, "should fail"
+   except IOError:
+      pass
+
+def test_blocked_bloom_partition():
+   ht = khmer.new_hashbits(20, 4**13+1, blocked=True)
+   filename = utils.get_test_data('random-20-a.fa')
+   outfile = utils.get_temp_filename('out')
+
+   total_reads, _ = ht.consume_fasta_and_tag(filename)
+
+   subset_size = total_reads / 2 + total_reads % 2;
+   divvy = ht.divide_tags_into_subsets(subset_size)
+   assert len(divvy) == 4
+
+   x = ht.do_subset_partition(divvy[0], divvy[2])
+   ht.merge_subset(x)
+   y = ht.do_subset_partition(divvy[2], 0)
+   ht.merge_subset(y)
+
+   n_partitions = ht.output_partitions(filename, outfile)
+   assert n_partitions == 1, n_partitions
+
+def test_consume_fasta_and_tag_checkpointed():
+   import random
+   rng = random.Random(1)
+   reads = [ ''.join([ rng.choice('ACGT') for j in range(40) ])
+             for i in range(15000) ]
+
+   inpath = utils.get_temp_filename('reads.fa')
+   prefix = os.path.join(os.path.dirname(inpath), 'ckpt')
+
+   # checkpoint the first batch of reads, as if the run had died there.
+   fp = open(inpath, 'w')
+   for i, seq in enumerate(reads[:10000]):
+      fp.write('>%d\n%s\n' % (i, seq))
+   fp.close()
+
+   ht = khmer.new_hashbits(20, 1e5, 4)
+   total_reads, _ = ht.consume_fasta_and_tag_checkpointed(inpath, prefix, 1)
+   assert total_reads == 10000
+   assert os.path.exists(prefix + '.1.tagset')
+
+   fp = open(inpath, 'w')
+   for i, seq in enumerate(reads):
+      fp.write('>%d\n%s\n' % (i, seq))
+   fp.close()
+
+   ht = khmer.new_hashbits(20, 1e3, 4)
+   total_reads, _ = ht.resume_consume_fasta(prefix)
+   assert total_reads == 15000
+   assert ht.n_tags() > 0
+
+   for seq in reads:
+      assert ht.get(seq[:20]) == 1
+      assert ht.get(seq[-20:]) == 1
+
+def test_merge():
+   inpath = utils.get_test_data('random-20-a.fa')
+   reads = [ record.sequence for record in screed.open(inpath) ]
+   half = len(reads) // 2
+
+   ht = khmer.new_hashbits(12, 1e5, 4)
+   ht2 = khmer.new_hashbits(12, 1e5, 4)
+   hb = khmer.new_hashbits(12, 1e5, 4)
+   for seq in reads[:half]:
+      ht.consume(seq)
+      hb.consume(seq)
+   for seq in reads[half:]:
+      ht2.consume(seq)
+      hb.consume(seq)
+
+   ht2.add_tag(reads[-1][:12])
+   n_unique = ht.n_unique_kmers() + ht2.n_unique_kmers()
+   ht.merge(ht2)
+   assert ht.n_occupied() == hb.n_occupied()
+   assert ht.n_tags() == 1
+   assert ht.n_unique_kmers() == n_unique
+   assert n_unique >= hb.n_unique_kmers() > 0
+
+   for seq in reads:
+      assert ht.get(seq[:12]) == 1
+      assert ht.get(seq[-12:]) == 1
+
+   try:
+      ht.merge(khmer.new_hashbits(12, 1e4, 4))
+      assert 0, "should fail"
+   except ValueError:
+      pass
+
+def test_wide_k_no_graph():
+   # the k-mers of a wide table are kept only as hashes, which cannot be
+   # walked or tagged; the table itself still counts presence.
+   K = 41
+   seq = 'ACGTTGCAAGTCCAGGTTAACCGGTATACGGCATTAGCGATCAAGT'
+
+   ht = khmer.new_hashbits(K, 1e5, 4)
+   ht.consume(seq)
+   assert ht.get(seq[:K]) == 1
+
+   for fn, args in ((ht.add_tag, (seq[:K],)),
+                    (ht.n_tags, ()),
+                    (ht.do_subset_partition, (0, 0)),
+                    (ht.consume_fasta_and_tag,
+                     (utils.get_test_data('random-20-a.fa'),)),
+                    (ht.kmer_degree, (seq[:K],))):
+      try:
+         fn(*args)
+         assert 0, "should fail"
+      except ValueError:
+         pass
@@ -0,0 +1,146 @@
+import random
+
+import khmer
+import khmer_tst_utils as utils
+import screed
+
+def teardown():
+    utils.cleanup()
+
+def _random_reads(n, length=50, seed=1):
+    rng = random.Random(seed)
+    return [ ''.join([ rng.choice('ACGT') for j in range(length) ])
+             for i in range(n) ]
+
+def _distinct_kmers(reads, k):
+    kmers = set()
+    for seq in reads:
+        for i in range(len(seq) - k + 1):
+            kmer = seq[i:i + k]
+            kmers.add(khmer.forward_hash(kmer, k))
+    return len(kmers)
+
+def test_estimate_cardinality():
+    reads = _random_reads(2000)
+    n = _distinct_kmers(reads, 20)
+
+    hll = khmer.new_hllcounter(20)
+    assert hll.estimate_cardinality() == 0
+    for seq in reads:
+        assert hll.consume(seq) == 50 - 20 + 1
+
+    # within three standard errors.
+    estimate = hll.estimate_cardinality()
+    assert abs(estimate - n) < 3 * hll.error_rate() * n, (estimate, n)
+
+    # seeing the same k-mers again, or their reverse complements, adds
+    # nothing.
+    for seq in reads[:100]:
+        hll.consume(seq)
+        hll.add(seq[:20])
+    assert hll.estimate_cardinality() == estimate
+
+def test_consume_fasta():
+    infile = utils.get_test_data('test-reads.fa')
+
+    hll = khmer.new_hllcounter(20)
+    total_reads, n_consumed = hll.consume_fasta(infile)
+
+    # the same reads and k-mers as are counted.
+    kh = khmer.new_counting_hash(20, 1e5, 2)
+    assert (total_reads, n_consumed) == kh.consume_fasta(infile)
+
+    reads = [ record.sequence for record in screed.open(infile) ]
+    n = _distinct_kmers(reads, 20)
+    estimate = hll.estimate_cardinality()
+    assert abs(estimate - n) < 3 * hll.error_rate() * n, (estimate, n)
+
+def test_consume_bad_read():
+    hll = khmer.new_hllcounter(20)
+    assert hll.consume('ACGTACGTACGTACGTACGTNNACGT') == 0
+
+    try:
+        hll.consume('ACGT')
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_merge():
+    reads = _random_reads(2000)
+    half = len(reads) // 2
+
+    hll = khmer.new_hllcounter(20)
+    hll2 = khmer.new_hllcounter(20)
+    both = khmer.new_hllcounter(20)
+    for seq in reads[:half]:
+        hll.consume(seq)
+        both.consume(seq)
+    for seq in reads[half:]:
+        hll2.consume(seq)
+        both.consume(seq)
+
+    hll.merge(hll2)
+    assert hll.estimate_cardinality() == both.estimate_cardinality()
+
+    try:
+        hll.merge(khmer.new_hllcounter(20, 10))
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+    try:
+        hll.merge(khmer.new_counting_hash(20, 1e3, 2))
+        assert 0, "should fail"
+    except TypeError:
+        pass
+
+def test_bad_p():
+    try:
+        khmer.new_hllcounter(20, 3)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_optimal_size():
+    hll = khmer.new_hllcounter(20)
+    for seq in _random_reads(2000):
+        hll.consume(seq)
+    n = hll.estimate_cardinality() * (1 + 3 * hll.error_rate())
+
+    # the fewest bins in all come with half of each table's bins taken.
+    n_tables, tablesize = hll.optimal_size(0.05)
+    assert n_tables == 4
+    assert 0.45 < 1 - 2.71828 ** (-n / tablesize) < 0.5
+
+    # the rate holds, for the number of tables asked for.
+    n_tables, tablesize = hll.optimal_size(0.01, 2)
+    assert n_tables == 2
+    assert (1 - 2.71828 ** (-n / tablesize)) ** 2 <= 0.0101
+
+    try:
+        hll.optimal_size(1.5)
+        assert 0, "should fail"
+    except ValueError:
+        pass
+
+def test_auto_size():
+    reads = _random_reads(2000)
+    hll = khmer.new_hllcounter(20)
+    for seq in reads:
+        hll.consume(seq)
+
+    n_tables, tablesize = hll.optimal_size(0.01)
+
+    ht = khmer.new_counting_hash(20, hll, fp_rate=0.01)
+    assert len(ht.hashsizes()) == n_tables
+    assert min(ht.hashsizes()) > tablesize
+
+    ht = khmer.new_hashbits(20, hll, 3, fp_rate=0.01)
+    assert len(ht.hashsizes()) == 3
+    for seq in reads:
+        ht.consume(seq)
+    assert khmer.calc_expected_collisions(ht) < 0.011
+
+    sh = khmer.new_sharded_counting_hash(20, hll, n_shards=4,
+                                         fp_rate=0.01)
+    assert sh.n_shards() == 4
@@ -66,6 +66,23 @@ def test_load_into_counting():
     assert status == 0
     assert os.path.exists(outfile)
 
+def test_load_into_counting_auto_size():
+    script = scriptpath('load-into-counting.py')
+    args = ['-A', '--fp-rate', '0.01', '-N', '2', '-k', '20']
+
+    outfile = utils.get_temp_filename('out.kh')
+    infile = utils.get_test_data('test-abund-read-2.fa')
+
+    args.extend([outfile, infile])
+
+    (status, out, err) = runscript(script, args)
+    assert status == 0
+    assert "WARNING" not in err
+
+    ht = khmer.load_counting_hash(outfile)
+    assert len(ht.hashsizes()) == 2
+    assert khmer.calc_expected_collisions(ht) < 0.011
+
 def test_load_into_counting_fail():
     script = scriptpath('load-into-counting.py')
     args = ['-x', '1e2', '-N', '2', '-k', '20'] # use small HT
@@ -571,6 +588,27 @@ def test_abundance_dist():
     assert line == '1001 2 98 1.0', line
 
 
+def test_abundance_dist_bins():
+    infile = utils.get_temp_filename('test.fa')
+    outfile = utils.get_temp_filename('test.dist')
+    in_dir = os.path.dirname(infile)
+
+    shutil.copyfile(utils.get_test_data('test-abund-read-2.fa'), infile)
+
+    htfile = _make_counting(infile, K=17)
+
+    script = scriptpath('abundance-dist.py')
+    args = ['-z', '-b', htfile, infile, outfile]
+    (status, out, err) = runscript(script, args, in_dir)
+    assert status == 0
+
+    fp = iter(open(outfile))
+    line = fp.next().strip()
+    assert line == '1 96 96 0.98', line
+    line = fp.next().strip()
+    assert line == '1001 2 98 1.0', line
+
+
 def test_count_overlap():
     seqfile1 = utils.get_temp_filename('test-overlap1.fa')
     in_dir = os.path.dirname(seqfile1)